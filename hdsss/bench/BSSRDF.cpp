@@ -0,0 +1,208 @@
+#include "BSSRDF.hpp"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <vector>
+using namespace std;
+using namespace glm;
+
+static BSSRDFParams benchmarkParams() {
+    BSSRDFParams params;
+    params.sigmaT = dvec3(2.0, 4.0, 8.0);
+    params.albedo = dvec3(0.9, 0.6, 0.3);
+    params.sigmaA = params.sigmaT - params.sigmaT * params.albedo;
+    return params;
+}
+
+static const char* simdLevelName(SIMDLevel level) {
+    switch (level) {
+        case SIMDLevel::Scalar:
+            return "Scalar";
+        case SIMDLevel::SSE2:
+            return "SSE2";
+        case SIMDLevel::AVX2:
+            return "AVX2";
+        default:
+            return "Best";
+    }
+}
+
+// arg: eta * 100
+static void BM_QC1x2(benchmark::State& state) {
+    double eta = state.range(0) / 100.0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(eta);
+        benchmark::DoNotOptimize(QC1x2(eta));
+    }
+}
+BENCHMARK(BM_QC1x2)->ArgName("eta100")->Arg(130)->Arg(150);
+
+// arg: eta * 100
+static void BM_QC2x3(benchmark::State& state) {
+    double eta = state.range(0) / 100.0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(eta);
+        benchmark::DoNotOptimize(QC2x3(eta));
+    }
+}
+BENCHMARK(BM_QC2x3)->ArgName("eta100")->Arg(130)->Arg(150);
+
+// args: log10 of the radius, log10 of the sigma_t scale. The cost of the
+// profile depends on how many terms the sigma_t * r products keep alive
+static void BM_PBDProfile(benchmark::State& state) {
+    double r = pow(10.0, double(state.range(0)));
+    auto params = benchmarkParams();
+    double scale = pow(10.0, double(state.range(1)));
+    dvec3 sigmaA = params.sigmaA * scale, sigmaT = params.sigmaT * scale;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r);
+        benchmark::DoNotOptimize(PBDProfile(sigmaA, sigmaT, params.eta, r));
+    }
+}
+BENCHMARK(BM_PBDProfile)
+    ->ArgNames({"log10r", "log10sigma"})
+    ->ArgsProduct({{-3, -2, -1, 0, 1}, {-1, 0, 1, 2}});
+
+// arg: log10 of the radius, the integrand samples the quadrature needed are
+// reported per call
+static void BM_PBDProfileAdaptive(benchmark::State& state) {
+    double r = pow(10.0, double(state.range(0)));
+    auto params = benchmarkParams();
+    int samples = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r);
+        benchmark::DoNotOptimize(
+            PBDProfileAdaptive(params.sigmaA, params.sigmaT, params.eta, r,
+                               BSSRDF_PROFILE_TOLERANCE, &samples));
+    }
+    state.counters["samples"] = samples;
+}
+BENCHMARK(BM_PBDProfileAdaptive)->ArgName("log10r")->DenseRange(-3, 1);
+
+// args: SIMDLevel, 1 for the float variant. Radii sweep the range the
+// tabulator samples
+template <typename Real>
+static void profileBatch(benchmark::State& state) {
+    using Vec3 = glm::vec<3, Real>;
+    constexpr size_t count = 4096;
+    auto params = benchmarkParams();
+    SIMDLevel level = SIMDLevel(state.range(0));
+    vector<Real> r(count);
+    vector<Vec3> out(count);
+    for (size_t i = 0; i < count; i++) {
+        r[i] = Real(10.0 * i / count);
+    }
+    for (auto _ : state) {
+        PBDProfileBatch(Vec3(params.sigmaA), Vec3(params.sigmaT),
+                        Real(params.eta), r.data(), out.data(), count, level);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * count);
+    state.SetLabel(simdLevelName(level));
+}
+static void BM_PBDProfileBatch(benchmark::State& state) {
+    if (state.range(1))
+        profileBatch<float>(state);
+    else
+        profileBatch<double>(state);
+}
+BENCHMARK(BM_PBDProfileBatch)
+    ->ArgNames({"simd", "float"})
+    ->ArgsProduct({{int(SIMDLevel::Scalar), int(SIMDLevel::SSE2),
+                    int(SIMDLevel::AVX2)},
+                   {0, 1}});
+
+// args: table size, BSSRDFIntegration, BSSRDFProfileQuadrature
+static void BM_Tabulate(benchmark::State& state) {
+    BSSRDFTabulateOptions options;
+    options.tableSize = state.range(0);
+    options.integration = BSSRDFIntegration(state.range(1));
+    options.profileQuadrature = BSSRDFProfileQuadrature(state.range(2));
+    auto params = benchmarkParams();
+    for (auto _ : state) {
+        BSSRDFTabulator tabulator(options);
+        tabulator.tabulate(params);
+        benchmark::DoNotOptimize(tabulator.getTableData());
+    }
+    string label = options.integration == BSSRDFIntegration::March
+                       ? "March"
+                       : "BandQuadrature";
+    label += options.profileQuadrature == BSSRDFProfileQuadrature::Fixed
+                 ? "/Fixed"
+                 : "/Adaptive";
+    state.SetLabel(label);
+    state.counters["cells"] = benchmark::Counter(
+        double(options.tableSize) * options.tableSize,
+        benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_Tabulate)
+    ->ArgNames({"size", "integration", "profile"})
+    ->ArgsProduct({{64, 128, 256, 512, 1024},
+                   {int(BSSRDFIntegration::March),
+                    int(BSSRDFIntegration::BandQuadrature)},
+                   {int(BSSRDFProfileQuadrature::Fixed),
+                    int(BSSRDFProfileQuadrature::Adaptive)}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->Iterations(1);
+
+// contents don't matter for I/O, a coarse table upsampled is much cheaper
+// to set up than tabulating at the full size
+static BSSRDFTabulator benchmarkTable(int tableSize) {
+    BSSRDFTabulateOptions options;
+    options.tableSize = 64;
+    BSSRDFTabulator tabulator(options);
+    tabulator.tabulate(benchmarkParams());
+    return tabulator.resampled(tableSize);
+}
+
+static filesystem::path benchmarkTablePath(int tableSize) {
+    return filesystem::temp_directory_path() /
+           ("hdsss_bench_" + to_string(tableSize) + ".bin");
+}
+
+// arg: table size
+static void BM_Save(benchmark::State& state) {
+    int N = state.range(0);
+    auto tabulator = benchmarkTable(N);
+    auto path = benchmarkTablePath(N);
+    for (auto _ : state) {
+        if (!tabulator.save(path.string())) {
+            state.SkipWithError("failed to save the table");
+            break;
+        }
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * N * N *
+                            sizeof(vec3));
+    filesystem::remove(path);
+}
+BENCHMARK(BM_Save)->ArgName("size")->Arg(128)->Arg(512)->Arg(1024);
+
+// arg: table size. Reading maps the file, every cell is touched once so the
+// page faults are part of the measurement
+static void BM_Read(benchmark::State& state) {
+    int N = state.range(0);
+    auto path = benchmarkTablePath(N);
+    if (!benchmarkTable(N).save(path.string())) {
+        state.SkipWithError("failed to save the table");
+        return;
+    }
+    for (auto _ : state) {
+        BSSRDFTabulator tabulator;
+        if (!tabulator.read(path.string())) {
+            state.SkipWithError("failed to read the table");
+            break;
+        }
+        const vec3* table = tabulator.getTableData();
+        vec3 sum(0.0f);
+        for (int i = 0; i < N * N; i++) {
+            sum += table[i];
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * N * N *
+                            sizeof(vec3));
+    filesystem::remove(path);
+}
+BENCHMARK(BM_Read)->ArgName("size")->Arg(128)->Arg(512)->Arg(1024);
@@ -0,0 +1,22 @@
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include <string>
+#include "BSSRDF.hpp"
+int main(int argc, char** argv) {
+    // tabulation progress would drown the benchmark report
+    FLAGS_minloglevel = google::GLOG_WARNING;
+    benchmark::Initialize(&argc, argv);
+    // versions that change the tabulation cost, so JSON reports of
+    // different builds can be told apart
+    benchmark::AddCustomContext("bssrdf_tabulator_version",
+                                std::to_string(BSSRDF_TABULATOR_VERSION));
+    benchmark::AddCustomContext("bssrdf_table_format_version",
+                                std::to_string(BSSRDF_TABLE_FORMAT_VERSION));
+    benchmark::AddCustomContext("best_simd_level",
+                                std::to_string(int(bestSIMDLevel())));
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
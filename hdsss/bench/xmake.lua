@@ -0,0 +1,10 @@
+add_requires("benchmark 1.7.1")
+
+
+target("HDSSSbench")
+    set_kind("binary")
+    add_deps("HDSSSlib")
+    set_languages("c11", "cxx17")
+    add_packages("benchmark")
+
+    add_files("*.cpp")
@@ -0,0 +1,47 @@
+#ifndef HDSSS_INCLUDE_BSSRDF_ANALYTIC_PROFILE_HPP
+#define HDSSS_INCLUDE_BSSRDF_ANALYTIC_PROFILE_HPP
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "BSSRDF.hpp"
+#include "BSSRDFEncoding.hpp"
+
+// the tables keep the scale of the March sum of the tabulator, which adds
+// both trapezoid ends at full weight: a cell is twice the mean of Rd over
+// its disk. Mirrored by RD_ANALYTIC_TABLE_SCALE in subsurface.glsl
+constexpr double BSSRDF_TABLE_SCALE = 2.0;
+// radial samples of the profile the pair is fitted to
+constexpr int BSSRDF_ANALYTIC_FIT_SAMPLES = 1024;
+
+// Rd(r) ~ sum_j weights[j] * rates[j] * exp(-rates[j] * r) / (2 pi r) per
+// channel, the exponential pair of diffusion.glsl that generalizes Burley's
+// normalized diffusion. Both rates of every channel are searched for, the
+// weights of every candidate are the non-negative least squares fit of
+// r * Rd(r). The shaders evaluate the Rd' of a table cell from it with
+// exponentialPairDiskAverage(), without the table
+struct BSSRDFAnalyticProfile {
+    // the sharper term first
+    glm::dvec3 weights[2]{glm::dvec3(0.0), glm::dvec3(0.0)};
+    glm::dvec3 rates[2]{glm::dvec3(0.0), glm::dvec3(0.0)};
+
+    // fits the profile the table was tabulated from, sampled over
+    // [0, table.maxDistance] with the table's profile quadrature
+    static BSSRDFAnalyticProfile fit(const BSSRDFTabulator& table,
+                                     unsigned int nThreads = 0);
+    // fits profile[i] = Rd(spacing * i)
+    static BSSRDFAnalyticProfile fit(const std::vector<glm::dvec3>& profile,
+                                     double spacing);
+    glm::dvec3 evaluate(double r) const;
+    // Rd' of a disk of the given area at distance from the profile center,
+    // what the shaders compute in place of a table lookup
+    glm::dvec3 diskAverage(double distance, double area) const;
+    // every cell of the table, row-major like it, in float as the shaders
+    // evaluate it
+    std::vector<glm::vec3> decode(const BSSRDFTabulator& table) const;
+    // error of the decoded cells against the table from its second row on.
+    // The first row holds disks of the clamped zero area, which the March
+    // does not resolve and the 1 / r terms of the pair diverge for
+    BSSRDFEncodingError measureError(const BSSRDFTabulator& table) const;
+};
+
+#endif /* HDSSS_INCLUDE_BSSRDF_ANALYTIC_PROFILE_HPP */
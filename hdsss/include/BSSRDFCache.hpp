@@ -0,0 +1,46 @@
+#ifndef HDSSS_INCLUDE_BSSRDF_CACHE_HPP
+#define HDSSS_INCLUDE_BSSRDF_CACHE_HPP
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "BSSRDF.hpp"
+
+// directory of tabulated Rd tables keyed by a SHA-256 of every tabulate()
+// input, shared between processes: entries are published by renaming a
+// finished temp file, least recently used entries are evicted once the
+// directory grows beyond maxBytes
+class BSSRDFCache {
+   public:
+    explicit BSSRDFCache(std::filesystem::path directory,
+                         uintmax_t maxBytes = 512ull << 20);
+
+    static std::string key(const BSSRDFParams& params,
+                           const BSSRDFTabulateOptions& options);
+    std::filesystem::path entryPath(const BSSRDFParams& params,
+                                    const BSSRDFTabulateOptions& options) const;
+
+    // looks up the table for params at tabulator.options, true on hit and
+    // the entry is then marked as most recently used
+    bool load(const BSSRDFParams& params, BSSRDFTabulator& tabulator) const;
+    // load or tabulate and store on miss
+    void fetch(const BSSRDFParams& params, BSSRDFTabulator& tabulator,
+               unsigned int nThreads = 0) const;
+    // fetch for several materials at once, the misses are tabulated as one
+    // batch sharing the nThreads workers. Entry i belongs to params[i]
+    std::vector<BSSRDFTabulator> fetch(const std::vector<BSSRDFParams>& params,
+                                       const BSSRDFTabulateOptions& options,
+                                       unsigned int nThreads = 0) const;
+    bool store(const BSSRDFTabulator& tabulator) const;
+    void evict() const;
+
+    const std::filesystem::path& getDirectory() const { return m_directory; }
+    uintmax_t getMaxBytes() const { return m_maxBytes; }
+
+   private:
+    std::filesystem::path m_directory;
+    uintmax_t m_maxBytes;
+};
+
+#endif /* HDSSS_INCLUDE_BSSRDF_CACHE_HPP */
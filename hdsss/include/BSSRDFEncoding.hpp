@@ -0,0 +1,83 @@
+#ifndef HDSSS_INCLUDE_BSSRDF_ENCODING_HPP
+#define HDSSS_INCLUDE_BSSRDF_ENCODING_HPP
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "BSSRDF.hpp"
+
+// how RdProfileAtlas stores the Rd tables on the GPU, the tables themselves
+// and the cache always stay in float
+enum class BSSRDFTableEncoding : uint32_t {
+    // GL_RGB32F, 12 bytes per cell
+    Float32 = 0,
+    // GL_RGB16F, 6 bytes per cell
+    Half = 1,
+    // GL_RGB9_E5, 4 bytes per cell, the channels share one exponent so the
+    // smaller ones lose precision next to the largest
+    SharedExponent = 2,
+    // truncated SVD of every channel, 2 * rank curves of tableSize RGB32F
+    // texels, see BSSRDFLowRankTable
+    LowRank = 3,
+    // no table at all, the exponential pair fitted to every profile is
+    // evaluated in the shaders, see BSSRDFAnalyticProfile
+    Analytic = 4,
+};
+
+// default number of separable terms of the LowRank encoding, every term
+// costs the shaders two fetches
+constexpr int BSSRDF_LOW_RANK_DEFAULT = 8;
+constexpr int BSSRDF_LOW_RANK_MAX = 32;
+
+struct BSSRDFEncodingOptions {
+    BSSRDFTableEncoding encoding{BSSRDFTableEncoding::Float32};
+    // only used by LowRank
+    int rank{BSSRDF_LOW_RANK_DEFAULT};
+    bool operator==(const BSSRDFEncodingOptions& other) const {
+        return encoding == other.encoding && rank == other.rank;
+    }
+};
+const char* encodingName(BSSRDFTableEncoding encoding);
+// GPU memory of a single table, the fitted terms for Analytic
+size_t encodedTableSize(int tableSize, const BSSRDFEncodingOptions& options);
+
+// Rd(x, y) ~ sum_k areaCurves[k](y) * distanceCurves[k](x) per channel, the
+// best rank approximation of each channel's table in the least squares
+// sense. Computed by subspace iteration, which converges fast since the
+// singular values of the smooth tables fall off quickly
+struct BSSRDFLowRankTable {
+    int tableSize{0}, rank{0};
+    // rank * tableSize texels each, term k at [k * tableSize, (k + 1) *
+    // tableSize), one channel per component. The singular values are folded
+    // into the distance curves
+    std::vector<glm::vec3> distanceCurves, areaCurves;
+
+    static BSSRDFLowRankTable factorize(const BSSRDFTabulator& table,
+                                        int rank);
+    // reconstructed cell, clamped to zero like the shader does
+    glm::vec3 cell(int x, int y) const;
+    // every cell, row-major like the table
+    std::vector<glm::vec3> decode() const;
+};
+
+// every cell as the shaders will read it back, row-major like the table
+std::vector<glm::vec3> decodeTable(const BSSRDFTabulator& table,
+                                   const BSSRDFEncodingOptions& options);
+
+// errors of an encoding relative to the float table, max and rms are
+// relative to the peak of each channel, the mean relative error only
+// counts cells above BSSRDF_ENCODING_ERROR_FLOOR of the peak
+constexpr double BSSRDF_ENCODING_ERROR_FLOOR = 1e-3;
+struct BSSRDFEncodingError {
+    double maxError{0}, rmsError{0}, meanRelativeError{0};
+};
+BSSRDFEncodingError measureEncodingError(const BSSRDFTabulator& table,
+                                         const BSSRDFEncodingOptions& options);
+// against cells already decoded by decodeTable() or the low rank table,
+// the rows below firstRow are left out
+BSSRDFEncodingError measureEncodingError(const BSSRDFTabulator& table,
+                                         const std::vector<glm::vec3>& decoded,
+                                         int firstRow = 0);
+
+#endif /* HDSSS_INCLUDE_BSSRDF_ENCODING_HPP */
@@ -0,0 +1,58 @@
+#ifndef HDSSS_INCLUDE_BSSRDF_GAUSSIAN_FIT_HPP
+#define HDSSS_INCLUDE_BSSRDF_GAUSSIAN_FIT_HPP
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "BSSRDF.hpp"
+
+// default number of terms of a fit, every term costs the separable SSS pass
+// a horizontal and a vertical blur
+constexpr int BSSRDF_GAUSSIAN_TERMS_DEFAULT = 4;
+// must match SSSS_GAUSSIAN_TERMS_MAX in separablesss.frag
+constexpr int BSSRDF_GAUSSIAN_TERMS_MAX = 6;
+// radial samples of the profile the fit is computed from
+constexpr int BSSRDF_GAUSSIAN_FIT_SAMPLES = 1024;
+
+// errors of a fit against the profile it was fitted to. max and rms are
+// errors of r * Rd(r), where the profile carries its energy, relative to the
+// peak of each channel
+struct BSSRDFGaussianFitError {
+    double maxError{0}, rmsError{0};
+    // largest relative error of a channel's integrated profile, the diffuse
+    // reflectance the blur spreads around
+    double energyError{0};
+};
+
+// Rd(r) ~ sum_k weights[k] * G(variances[k], r) with the normalized 2D
+// gaussian G(v, r) = exp(-r^2 / 2v) / (2 pi v). A gaussian is separable in
+// x and y, so the profile becomes a ladder of separable screen space blurs.
+// The variances are shared by the channels and spaced geometrically, the
+// ends of the ladder are searched for while the weights of every candidate
+// are the non-negative least squares fit of r * Rd(r). The narrow spike of
+// the profile at r = 0 is left to the smallest term
+struct BSSRDFGaussianFit {
+    // ascending, in squared table(world) units
+    std::vector<double> variances;
+    // integral of every term per channel
+    std::vector<glm::dvec3> weights;
+    // against the samples the fit was computed from
+    BSSRDFGaussianFitError error;
+
+    // fits the profile the table was tabulated from, sampled over
+    // [0, table.maxDistance] with the table's profile quadrature
+    static BSSRDFGaussianFit fit(const BSSRDFTabulator& table,
+                                 int terms = BSSRDF_GAUSSIAN_TERMS_DEFAULT,
+                                 unsigned int nThreads = 0);
+    // fits profile[i] = Rd(spacing * i)
+    static BSSRDFGaussianFit fit(const std::vector<glm::dvec3>& profile,
+                                 double spacing, int terms);
+    int terms() const { return int(variances.size()); }
+    glm::dvec3 evaluate(double r) const;
+};
+
+// same measures as BSSRDFGaussianFit::error for any profile samples
+BSSRDFGaussianFitError measureGaussianFitError(
+    const BSSRDFGaussianFit& fit, const std::vector<glm::dvec3>& profile,
+    double spacing);
+
+#endif /* HDSSS_INCLUDE_BSSRDF_GAUSSIAN_FIT_HPP */
@@ -0,0 +1,63 @@
+#ifndef HDSSS_INCLUDE_CONFIG_HPP
+#define HDSSS_INCLUDE_CONFIG_HPP
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <loo/Mesh.hpp>
+#include <string>
+
+#include "BSSRDF.hpp"
+#include "BSSRDFEncoding.hpp"
+#include "glm/ext/matrix_transform.hpp"
+#include "glm/trigonometric.hpp"
+
+struct HDSSSConfig {
+    struct CameraConfig {
+        glm::vec3 position{glm::vec3(0.0f, 0.0f, 0.0f)};
+        glm::vec3 lookat{glm::vec3(0.0f, 0.0f, -1.0f)};
+        float fov{glm::radians(60.0f)};
+        float zNear{0.01f};
+        float zFar{50.0f};
+    } camera;
+    struct LightConfig {
+        glm::vec3 direction{glm::vec3(-1.0f, -1.0f, 0.0f)};
+        glm::vec3 color{glm::vec3(1.0f)};
+        float intensity{1.0f};
+    } light;
+    struct ModelConfig {
+        glm::mat4 transform{glm::identity<glm::mat4>()};
+        // meshoptimizer stages run on every mesh at load time
+        loo::MeshOptimizeOptions optimize{};
+        // layout of the uploaded vertices
+        loo::VertexFormat vertexFormat{loo::VertexFormat::Float};
+        // error in pixels a level of detail may show, 0 draws the full meshes
+        float lodPixelError{1.0f};
+    } model;
+    struct BSSRDFConfig {
+        glm::vec3 sigma_t{glm::vec3(4.0f)};
+        glm::vec3 albedo{glm::vec3(0, 1, 0)};
+        // resolution and column spacing of the tabulated Rd profile
+        BSSRDFTabulateOptions table{};
+        // tables missing from the cache are first shown at this size while
+        // the full one is tabulated in the background, 0 blocks instead
+        int progressiveTableSize{64};
+        // GPU representation of the tables
+        BSSRDFEncodingOptions encoding{};
+    } bssrdf;
+    struct CacheConfig {
+        std::string directory{"bssrdf_cache"};
+        uintmax_t maxSizeMB{512};
+        // imported models as .loomesh entries, empty disables the cache
+        std::string meshDirectory{"mesh_cache"};
+    } cache;
+    struct Animation {
+        float cameraRotationY{0.0f};
+        float modelRotationY{0.0f};
+    } animation;
+};
+
+// reads the JSON config, modelPath and skyboxPath are only overwritten when
+// the file names them. Missing keys keep their defaults
+HDSSSConfig parseJSONConfig(const char* filename, std::string& modelPath,
+                            std::string& skyboxPath);
+
+#endif /* HDSSS_INCLUDE_CONFIG_HPP */
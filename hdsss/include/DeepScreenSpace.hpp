@@ -14,6 +14,8 @@
 
 struct DSSOptions {
     float surfelScale{1.0f};
+    // every surfel is a triangle, coarser levels of detail emit fewer
+    float surfelizeLodBias{2.0f};
     float splattingStrength{15.0f};
     float minimalEffect{0.001f};
     float maxDistance{0.01f};
@@ -65,6 +67,7 @@ class DeepScreenSpace {
     std::shared_ptr<loo::Texture2D> m_sumuptex;
 
     int m_surfelcount{0};
+    loo::DrawStatistics m_surfelizestatistics;
 
     void copyFromUnshuffleToBlur();
 
@@ -95,6 +98,9 @@ class DeepScreenSpace {
     void sumUpPass();
 
     int getSurfelCount() const { return m_surfelcount; }
+    const loo::DrawStatistics& getSurfelizeStatistics() const {
+        return m_surfelizestatistics;
+    }
     auto getSplattingResult() const { return m_splattingresult; }
     auto getPartitionedPosition() const { return m_partitionedposition; }
     auto getPartitionedNormal() const { return m_partitionednormal; }
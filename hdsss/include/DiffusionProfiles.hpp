@@ -0,0 +1,43 @@
+#ifndef HDSSS_INCLUDE_DIFFUSION_PROFILES_HPP
+#define HDSSS_INCLUDE_DIFFUSION_PROFILES_HPP
+// CPU side of shaders/include/diffusion.glsl. The shader source is included
+// as is with every function turned into a template over its scalar type, so
+// diffusion::QC1x2<float> is what the shaders compute and
+// diffusion::QC1x2<double> the reference the tabulator uses. Besides float
+// and double the scalar may be a SIMD lane type providing the arithmetic
+// operators plus sqrt/exp through ADL, see pbd::Lane
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+namespace diffusion {
+
+// scalar built-ins, the vector ones are found through ADL in glm
+using glm::clamp;
+using std::abs;
+using std::acos;
+using std::cos;
+using std::exp;
+using std::log;
+using std::sin;
+using std::sqrt;
+
+// double has the precision to skip the series of the shader version
+inline double oneMinusExp(double x) {
+    return 1.0 - exp(-x);
+}
+
+#define DIFFUSION_FN template <typename T> inline
+#define DIFFUSION_T T
+#define DIFFUSION_VEC3 glm::vec<3, T>
+#include "../shaders/include/diffusion.glsl"
+#undef DIFFUSION_FN
+#undef DIFFUSION_T
+#undef DIFFUSION_VEC3
+#undef DIFFUSION_PI
+#undef DIFFUSION_SERIES_THRESHOLD
+#undef DIFFUSION_DISK_BAND_NODES
+
+}  // namespace diffusion
+
+#endif /* HDSSS_INCLUDE_DIFFUSION_PROFILES_HPP */
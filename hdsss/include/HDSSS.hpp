@@ -1,19 +1,27 @@
 #ifndef HDSSS_INCLUDE_HDSSS_HPP
 #define HDSSS_INCLUDE_HDSSS_HPP
 #include <loo/Framebuffer.hpp>
+#include <loo/GPUTimer.hpp>
 #include <loo/Light.hpp>
 #include <loo/Scene.hpp>
 #include <loo/Shader.hpp>
+#include "RdProfileAtlas.hpp"
 #include "Transforms.hpp"
 struct HDSSSOptions {
     float minimalEffect{0.0001f};
     float maxDistance{0.0015f};
     float surfelizeScale{0.00085f};
+    // every surfel is a triangle, coarser levels of detail emit fewer
+    float surfelizeLodBias{2.0f};
     float splattingStrength{1.0f};
     float ssssPixelAreaScale{1e-4f};
     bool ssssSamplingMarker{false};
     glm::ivec2 ssssSamplingMarkerCenter{0, 0};
 };
+// GPU time of the passes in milliseconds, averaged over the last frames
+struct HDSSSTimings {
+    double surfelize{0}, splatting{0}, ssss{0};
+};
 class HDSSS {
 
     void initTranslucencyPass();
@@ -28,6 +36,7 @@ class HDSSS {
     void splattingPass(const loo::ShaderLight& mainLight,
                        const loo::Texture2D& GBufferPosition,
                        const loo::Texture2D& GBufferNormal,
+                       const loo::Texture2D& GBuffer5,
                        const loo::Texture2D& mainLightShadowMap);
 
     // translucent pass
@@ -35,6 +44,7 @@ class HDSSS {
 
     loo::ShaderProgram m_surfelizeshader;
     int m_surfelcount{0};
+    loo::DrawStatistics m_surfelizestatistics;
 
     GLuint m_surfelizetf, m_surfelizequery;
     struct SurfelBuffer {
@@ -57,6 +67,8 @@ class HDSSS {
     loo::Framebuffer m_ssssfb;
     std::unique_ptr<loo::Texture2D> m_sssstex;
 
+    loo::GPUTimer m_surfelizetimer, m_splattingtimer, m_sssstimer;
+
    public:
     HDSSS();
     void init();
@@ -66,6 +78,7 @@ class HDSSS {
                           const loo::ShaderLight& mainLight,
                           const loo::Texture2D& GBufferPosition,
                           const loo::Texture2D& GBufferNormal,
+                          const loo::Texture2D& GBuffer5,
                           const loo::Texture2D& mainLightShadowMap);
 
     // fifth pass: upscale transluency effect
@@ -74,14 +87,20 @@ class HDSSS {
     void SSSSPass(loo::Texture2D& GBufferPosition,
                   loo::Texture2D& GBufferNormal, const loo::Texture2D& GBuffer3,
                   const loo::Texture2D& GBuffer4,
+                  const loo::Texture2D& GBuffer5,
                   loo::Texture2D& transmittedIrradiance);
     int getSurfelCount() const { return m_surfelcount; }
+    const loo::DrawStatistics& getSurfelizeStatistics() const {
+        return m_surfelizestatistics;
+    }
+    HDSSSTimings getTimings() const {
+        return {m_surfelizetimer.getElapsedMs(),
+                m_splattingtimer.getElapsedMs(), m_sssstimer.getElapsedMs()};
+    }
     const auto& getUpscaleResult() { return *m_upscaletex; }
     const auto& getSSSSResult() { return *m_sssstex; }
     HDSSSOptions options;
-    struct RdProfile {
-        std::unique_ptr<loo::Texture2D> texture;
-        float maxDistance, maxArea;
-    } rdProfile;
+    // Rd tables of all subsurface materials in the scene
+    RdProfileAtlas rdProfiles;
 };
 #endif /* HDSSS_INCLUDE_HDSSS_HPP */
@@ -2,6 +2,7 @@
 #define HDSSS_INCLUDE_HDSSSAPPLICATION_HPP
 
 #include <filesystem>
+#include <future>
 #include <glm/glm.hpp>
 #include <loo/Application.hpp>
 #include <loo/Camera.hpp>
@@ -16,8 +17,11 @@
 #include <string>
 #include <vector>
 #include "BSSRDF.hpp"
+#include "BSSRDFCache.hpp"
+#include "Config.hpp"
 #include "DeepScreenSpace.hpp"
 #include "HDSSS.hpp"
+#include "SeparableSSS.hpp"
 #include "Transforms.hpp"
 
 #include "FinalProcess.hpp"
@@ -26,32 +30,6 @@
 #include "glm/fwd.hpp"
 #include "glm/trigonometric.hpp"
 
-struct HDSSSConfig {
-    struct CameraConfig {
-        glm::vec3 position{glm::vec3(0.0f, 0.0f, 0.0f)};
-        glm::vec3 lookat{glm::vec3(0.0f, 0.0f, -1.0f)};
-        float fov{glm::radians(60.0f)};
-        float zNear{0.01f};
-        float zFar{50.0f};
-    } camera;
-    struct LightConfig {
-        glm::vec3 direction{glm::vec3(-1.0f, -1.0f, 0.0f)};
-        glm::vec3 color{glm::vec3(1.0f)};
-        float intensity{1.0f};
-    } light;
-    struct ModelConfig {
-        glm::mat4 transform{glm::identity<glm::mat4>()};
-    } model;
-    struct BSSRDFConfig {
-        glm::vec3 sigma_t{glm::vec3(4.0f)};
-        glm::vec3 albedo{glm::vec3(0, 1, 0)};
-    } bssrdf;
-    struct Animation {
-        float cameraRotationY{0.0f};
-        float modelRotationY{0.0f};
-    } animation;
-};
-
 class HDSSSApplication : public loo::Application {
    public:
     HDSSSApplication(int width, int height, const HDSSSConfig& config,
@@ -68,6 +46,13 @@ class HDSSSApplication : public loo::Application {
     void initGBuffers();
     void initShadowMap();
     void initDeferredPass();
+    // fill the Rd profile atlas, layer i with profiles[i]. Tables missing
+    // from the cache are tabulated in one batch, in the background behind a
+    // coarse stand-in when progressive tabulation is enabled
+    void loadRdProfiles(const std::vector<BSSRDFParams>& profiles);
+    // swaps the refined tables into the atlas once the background job is
+    // done, called at the start of a frame
+    void swapRefinedRdProfiles();
 
     void loop() override;
     void gui();
@@ -114,7 +99,7 @@ class HDSSSApplication : public loo::Application {
         // pbr: sigma_a(3) + roughness(1)
         std::unique_ptr<loo::Texture2D> buffer4;
         // simple material: unused
-        // pbr: occlusion(1) + unused(3)
+        // pbr: occlusion(1) + Rd profile layer(1) + unused(2)
         std::unique_ptr<loo::Texture2D> buffer5;
         loo::Renderbuffer depthrb;
     } m_gbuffers;
@@ -131,16 +116,42 @@ class HDSSSApplication : public loo::Application {
     // skybox
     std::unique_ptr<loo::Texture2D> m_skyboxresult;
 
-    enum class SubsurfaceMethod { HDSSS, DSS };
+    // Separable is the cheap mode, a gaussian blur ladder of the
+    // transmitted irradiance without any surfels
+    enum class SubsurfaceMethod { HDSSS, DSS, Separable };
     SubsurfaceMethod m_method{SubsurfaceMethod::HDSSS};
 
     HDSSS m_hdsss;
 
     DeepScreenSpace m_dss;
 
+    SeparableSSS m_separablesss;
+
     // process
     FinalProcess m_finalprocess;
 
+    loo::MeshOptimizeOptions m_meshoptimize;
+    std::string m_meshcachedirectory;
+    loo::VertexFormat m_vertexformat;
+    float m_lodpixelerror;
+    bool m_frustumculling{true};
+    // skips meshlets facing away in the G-buffer and shadow passes. Off by
+    // default: no pass culls back faces (loop() disables GL_CULL_FACE), so
+    // it drops visible back faces of open or two-sided meshes
+    bool m_coneculling{false};
+    // the scene in one glMultiDrawElementsIndirect per material and pass
+    bool m_indirectdraw{true};
+    loo::DrawStatistics m_gbufferstatistics, m_shadowstatistics;
+
+    BSSRDFCache m_bssrdfcache;
+    BSSRDFTabulateOptions m_tableoptions;
+    int m_progressivetablesize;
+    // every atlas layer, the coarse stand-ins are replaced in place
+    std::vector<BSSRDFTabulator> m_rdtables;
+    // full resolution tables of the m_rdrefinementlayers
+    std::future<std::vector<BSSRDFTabulator>> m_rdrefinement;
+    std::vector<size_t> m_rdrefinementlayers;
+
     bool m_wireframe{false};
     bool m_enablenormal{true};
     bool m_enableparallax{true};
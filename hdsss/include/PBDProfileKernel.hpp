@@ -0,0 +1,239 @@
+#ifndef HDSSS_INCLUDE_PBD_PROFILE_KERNEL_HPP
+#define HDSSS_INCLUDE_PBD_PROFILE_KERNEL_HPP
+// SIMD kernel behind PBDProfileBatch, written once against a small
+// vector-ops interface and instantiated for SSE2 and AVX2 in float and
+// double. Ops provides V(vector), Scalar, width, set1/load/store, the
+// arithmetic, sqrt/min/max, lt/ge(all-ones masks), select(mask & value) and
+// pow2, which turns the magic-rounded exponent of exp() into 2^n. The
+// integrand itself comes from DiffusionProfiles.hpp.
+// PBDProfileBatchAVX2.cpp is built with AVX2 code generation, so the
+// templates here must not instantiate anything shared with the other
+// translation units: the lanes only go through Ops, no std::min or glm calls
+#include <cstddef>
+#include <glm/glm.hpp>
+
+#include "DiffusionProfiles.hpp"
+
+namespace pbd {
+
+constexpr int EQUI_SAMPLES = 5, EXP_SAMPLES = 5;
+constexpr double PI = 3.14159265358979323846;
+
+// everything of PBDProfile that does not depend on the radius, computed in
+// double exactly like the scalar code
+struct ProfileConstants {
+    double sigmaT[3], sigmaTr[3], alpha[3], Dg[3], zb[3];
+    // CPhi(eta), CE(eta)
+    double Cphi, CE;
+    // equiangular samples on [0, inf) are t = max(r, 1e-12) * tan(xi*pi/2)
+    double equiTan[EQUI_SAMPLES];
+    // exponential samples and their pdf per channel
+    double expT[3][EXP_SAMPLES], expPdf[3][EXP_SAMPLES];
+};
+ProfileConstants profileConstants(glm::dvec3 sigma_a, glm::dvec3 sigma_t,
+                                  double eta);
+
+// AVX2 instantiations, built in their own translation unit with AVX2
+// enabled over Ops types local to it; they return false when the compiler
+// could not target AVX2
+bool profileBatchAVX2(const ProfileConstants& c, const double* r, double* out,
+                      size_t count);
+bool profileBatchAVX2(const ProfileConstants& c, const float* r, float* out,
+                      size_t count);
+
+template <typename Scalar>
+struct ExpCoefficients;
+// Cephes exp, Pade form
+template <>
+struct ExpCoefficients<double> {
+    static constexpr double lo = -708.0, hi = 709.0;
+    static constexpr double magic = 6755399441055744.0;  // 1.5 * 2^52
+};
+// Cephes expf, polynomial form
+template <>
+struct ExpCoefficients<float> {
+    static constexpr float lo = -87.0f, hi = 88.0f;
+    static constexpr float magic = 12582912.0f;  // 1.5 * 2^23
+};
+
+template <typename Ops>
+typename Ops::V muladd(typename Ops::V a, typename Ops::V b,
+                       typename Ops::V c) {
+    return Ops::add(Ops::mul(a, b), c);
+}
+
+template <typename Ops>
+typename Ops::V exp(typename Ops::V x) {
+    using V = typename Ops::V;
+    using S = typename Ops::Scalar;
+    using C = ExpCoefficients<S>;
+    V inRange = Ops::ge(x, Ops::set1(C::lo));
+    x = Ops::min(Ops::max(x, Ops::set1(C::lo)), Ops::set1(C::hi));
+    // round x / ln2 to nearest by pushing it into the low mantissa bits
+    V fx = muladd<Ops>(x, Ops::set1(S(1.44269504088896341)),
+                       Ops::set1(C::magic));
+    V n = Ops::sub(fx, Ops::set1(C::magic));
+    V r, e;
+    if constexpr (sizeof(S) == 8) {
+        r = Ops::sub(x, Ops::mul(n, Ops::set1(6.93145751953125E-1)));
+        r = Ops::sub(r, Ops::mul(n, Ops::set1(1.42860682030941723212E-6)));
+        V xx = Ops::mul(r, r);
+        V px = muladd<Ops>(Ops::set1(1.26177193074810590878E-4), xx,
+                           Ops::set1(3.02994407707441961300E-2));
+        px = Ops::mul(muladd<Ops>(px, xx, Ops::set1(9.99999999999999999910E-1)),
+                      r);
+        V qx = muladd<Ops>(Ops::set1(3.00198505138664455042E-6), xx,
+                           Ops::set1(2.52448340349684104192E-3));
+        qx = muladd<Ops>(qx, xx, Ops::set1(2.27265548208155028766E-1));
+        qx = muladd<Ops>(qx, xx, Ops::set1(2.00000000000000000009E0));
+        e = muladd<Ops>(Ops::set1(2.0), Ops::div(px, Ops::sub(qx, px)),
+                        Ops::set1(1.0));
+    } else {
+        r = Ops::sub(x, Ops::mul(n, Ops::set1(0.693359375f)));
+        r = Ops::sub(r, Ops::mul(n, Ops::set1(-2.12194440e-4f)));
+        V y = Ops::set1(1.9875691500E-4f);
+        y = muladd<Ops>(y, r, Ops::set1(1.3981999507E-3f));
+        y = muladd<Ops>(y, r, Ops::set1(8.3334519073E-3f));
+        y = muladd<Ops>(y, r, Ops::set1(4.1665795894E-2f));
+        y = muladd<Ops>(y, r, Ops::set1(1.6666665459E-1f));
+        y = muladd<Ops>(y, r, Ops::set1(5.0000001201E-1f));
+        e = Ops::add(muladd<Ops>(y, Ops::mul(r, r), r), Ops::set1(1.0f));
+    }
+    // below the range the scalar exp is (almost) zero as well
+    return Ops::select(inRange, Ops::mul(e, Ops::pow2(fx)));
+}
+
+// Ops::V with the operators DiffusionProfiles.hpp needs, so its templates
+// run on whole registers
+template <typename Ops>
+struct Lane {
+    using V = typename Ops::V;
+    using S = typename Ops::Scalar;
+    V v;
+    Lane(V v) : v(v) {}
+    // DIFFUSION_T(literal) broadcasts
+    explicit Lane(double s) : v(Ops::set1(S(s))) {}
+
+    friend Lane operator+(Lane a, Lane b) { return Ops::add(a.v, b.v); }
+    friend Lane operator-(Lane a, Lane b) { return Ops::sub(a.v, b.v); }
+    friend Lane operator*(Lane a, Lane b) { return Ops::mul(a.v, b.v); }
+    friend Lane operator/(Lane a, Lane b) { return Ops::div(a.v, b.v); }
+    friend Lane operator-(Lane a) { return Ops::sub(Ops::set1(S(0)), a.v); }
+    friend Lane sqrt(Lane a) { return Ops::sqrt(a.v); }
+    friend Lane exp(Lane a) { return pbd::exp<Ops>(a.v); }
+    // diffusion::oneMinusExp, float blends both branches by masks
+    friend Lane oneMinusExp(Lane x) {
+        Lane one(1.0);
+        Lane kappa = one - exp(-x);
+        if constexpr (sizeof(S) == 4) {
+            Lane series = x * (one - x * (Lane(0.5) - x * Lane(1.0 / 6.0)));
+            V threshold = Ops::set1(S(1e-3));
+            kappa = Ops::add(Ops::select(Ops::lt(x.v, threshold), series.v),
+                             Ops::select(Ops::ge(x.v, threshold), kappa.v));
+        }
+        return kappa;
+    }
+};
+
+template <typename Ops>
+struct Sample {
+    // C_phi * S_phi + C_E * S_E
+    typename Ops::V value;
+    typename Ops::V expSigmaT;
+};
+
+// PBDEvalSample of the scalar code for one channel, r2 = r * r
+template <typename Ops>
+Sample<Ops> evalSample(const ProfileConstants& c, int ch, typename Ops::V r2,
+                       typename Ops::V t) {
+    using V = typename Ops::V;
+    using S = typename Ops::Scalar;
+    using L = Lane<Ops>;
+    V expSigmaT = exp<Ops>(Ops::mul(Ops::set1(S(-c.sigmaT[ch])), t));
+    V Q = Ops::mul(Ops::set1(S(c.alpha[ch] * c.sigmaT[ch])), expSigmaT);
+    L response = diffusion::pbdResponse(
+        L(r2), L(t), L(c.sigmaT[ch]), L(c.sigmaTr[ch]), L(c.alpha[ch]),
+        L(c.Dg[ch]), L(c.zb[ch]), L(c.Cphi), L(c.CE));
+    return {Ops::mul(response.v, Q), expSigmaT};
+}
+
+// profile of one channel for Ops::width radii
+template <typename Ops>
+typename Ops::V profileChannel(const ProfileConstants& c, int ch,
+                               typename Ops::V r) {
+    using V = typename Ops::V;
+    using S = typename Ops::Scalar;
+    const S sigmaT = S(c.sigmaT[ch]);
+    V zero = Ops::set1(S(0)), one = Ops::set1(S(1));
+    V h = Ops::max(r, Ops::set1(S(1e-12)));
+    V r2 = Ops::mul(r, r);
+    // linearstep(0.9 sigma_t, 1.1 sigma_t, r)
+    V weight = Ops::min(
+        Ops::max(Ops::div(Ops::sub(r, Ops::set1(S(0.9) * sigmaT)),
+                          Ops::set1(S(0.2) * sigmaT)),
+                 zero),
+        one);
+    V equiWeight = Ops::mul(Ops::sub(one, weight), Ops::set1(S(EQUI_SAMPLES)));
+    V expWeight = Ops::mul(weight, Ops::set1(S(EXP_SAMPLES)));
+    // pdf of an equiangular sample on [0, inf) at distance t
+    auto equiPdf = [&](V t) {
+        return Ops::div(h, Ops::mul(Ops::set1(S(PI / 2)),
+                                    Ops::add(Ops::mul(h, h), Ops::mul(t, t))));
+    };
+
+    V equi = zero;
+    for (int j = 0; j < EQUI_SAMPLES; j++) {
+        V t = Ops::mul(h, Ops::set1(S(c.equiTan[j])));
+        V pdfEqui = equiPdf(t);
+        auto sample = evalSample<Ops>(c, ch, r2, t);
+        V pdfExp = Ops::mul(Ops::set1(sigmaT), sample.expSigmaT);
+        V a = Ops::mul(equiWeight, pdfEqui);
+        V w = Ops::div(Ops::div(a, Ops::add(a, Ops::mul(expWeight, pdfExp))),
+                       pdfEqui);
+        equi = Ops::add(equi, Ops::mul(sample.value, w));
+    }
+    V equiMask = Ops::lt(r, Ops::set1(S(1.1) * sigmaT));
+
+    V expSum = zero;
+    for (int j = 0; j < EXP_SAMPLES; j++) {
+        V t = Ops::set1(S(c.expT[ch][j]));
+        V pdfExp = Ops::set1(S(c.expPdf[ch][j]));
+        auto sample = evalSample<Ops>(c, ch, r2, t);
+        V a = Ops::mul(expWeight, pdfExp);
+        V w = Ops::div(
+            Ops::div(a, Ops::add(Ops::mul(equiWeight, equiPdf(t)), a)), pdfExp);
+        expSum = Ops::add(expSum, Ops::mul(sample.value, w));
+    }
+    V expMask = Ops::lt(Ops::set1(S(0.9) * sigmaT), r);
+
+    V equiCount = Ops::set1(S(EQUI_SAMPLES));
+    V expCount = Ops::set1(S(EXP_SAMPLES));
+    return Ops::add(Ops::select(equiMask, Ops::div(equi, equiCount)),
+                    Ops::select(expMask, Ops::div(expSum, expCount)));
+}
+
+// evaluates count radii, out holds count RGB triples
+template <typename Ops>
+void profileBatch(const ProfileConstants& c, const typename Ops::Scalar* r,
+                  typename Ops::Scalar* out, size_t count) {
+    using S = typename Ops::Scalar;
+    constexpr int W = Ops::width;
+    alignas(32) S lanes[W], result[3][W];
+    for (size_t base = 0; base < count; base += W) {
+        size_t n = count - base < size_t(W) ? count - base : size_t(W);
+        // the tail is padded with its last radius
+        for (size_t k = 0; k < size_t(W); k++)
+            lanes[k] = r[base + (k < n ? k : n - 1)];
+        auto rv = Ops::load(lanes);
+        for (int ch = 0; ch < 3; ch++)
+            Ops::store(result[ch], profileChannel<Ops>(c, ch, rv));
+        for (size_t k = 0; k < n; k++) {
+            for (int ch = 0; ch < 3; ch++)
+                out[(base + k) * 3 + ch] = result[ch][k];
+        }
+    }
+}
+
+}  // namespace pbd
+
+#endif /* HDSSS_INCLUDE_PBD_PROFILE_KERNEL_HPP */
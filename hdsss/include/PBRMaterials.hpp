@@ -20,6 +20,8 @@ struct ShaderPBRMetallicMaterial {
     glm::vec4 transmissionSigmaT;
     // sigmaA(3) + roughness(1)
     glm::vec4 sigmaARoughness;
+    // layer of the Rd profile atlas, GBuffer5.g
+    int rdProfileLayer{0};
     ShaderPBRMetallicMaterial(glm::vec3 baseColor, float metallic,
                               float transmission, glm::vec3 sigmaT,
                               glm::vec3 sigmaA, float roughness)
@@ -43,16 +45,18 @@ class PBRMetallicMaterial : public loo::Material {
     const ShaderPBRMetallicMaterial& getShaderMaterial() const {
         return m_shadermaterial;
     }
-    PBRMetallicMaterial(glm::vec3 baseColor, float metallic, float transmission,
-                        glm::vec3 sigmaT, glm::vec3 sigmaA, float roughness)
-        : m_shadermaterial(baseColor, metallic, transmission, sigmaT, sigmaA,
-                           roughness) {
+    explicit PBRMetallicMaterial(const ShaderPBRMetallicMaterial& material)
+        : m_shadermaterial(material) {
         if (PBRMetallicMaterial::uniformBuffer == nullptr) {
             PBRMetallicMaterial::uniformBuffer =
                 std::make_unique<loo::UniformBuffer>(
                     SHADER_BINDING_PORT_MR_PARAM, sizeof(PBRMetallicMaterial));
         }
     }
+    PBRMetallicMaterial(glm::vec3 baseColor, float metallic, float transmission,
+                        glm::vec3 sigmaT, glm::vec3 sigmaA, float roughness)
+        : PBRMetallicMaterial(ShaderPBRMetallicMaterial(
+              baseColor, metallic, transmission, sigmaT, sigmaA, roughness)) {}
     static std::shared_ptr<PBRMetallicMaterial> getDefault();
     static std::shared_ptr<PBRMetallicMaterial> getDefaultSubsurface();
     void bind(const loo::ShaderProgram& sp) override;
@@ -64,5 +68,17 @@ class PBRMetallicMaterial : public loo::Material {
 };
 std::shared_ptr<PBRMetallicMaterial> convertPBRMetallicMaterialFromBaseMaterial(
     const loo::BaseMaterial& baseMaterial);
+// the parameters of the conversions above without creating any GL object,
+// HDSSStabulate derives the same tables from them
+ShaderPBRMetallicMaterial createShaderPBRMetallicMaterial(
+    const loo::MetallicRoughnessWorkFlow& pbrMetallic);
+// white translucent material scattering with sigmaT and albedo, the default
+// subsurface material uses PBRMetallicMaterial::bssrdf
+ShaderPBRMetallicMaterial createSubsurfaceShaderMaterial(glm::vec3 sigmaT,
+                                                         glm::vec3 albedo);
+ShaderPBRMetallicMaterial createDefaultSubsurfaceShaderMaterial();
+inline bool isSubsurface(const ShaderPBRMetallicMaterial& material) {
+    return material.sigmaARoughness.r != 0.0f;
+}
 
 #endif /* HDSSS_INCLUDE_PBRMATERIALS_HPP */
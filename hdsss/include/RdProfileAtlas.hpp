@@ -0,0 +1,68 @@
+#ifndef HDSSS_INCLUDE_RD_PROFILE_ATLAS_HPP
+#define HDSSS_INCLUDE_RD_PROFILE_ATLAS_HPP
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <loo/Shader.hpp>
+#include <loo/Texture.hpp>
+#include <loo/UniformBuffer.hpp>
+#include <memory>
+#include <vector>
+#include "BSSRDF.hpp"
+#include "BSSRDFAnalyticProfile.hpp"
+#include "BSSRDFEncoding.hpp"
+
+// must match RD_PROFILE_MAX_LAYERS in subsurface.glsl
+constexpr int RD_PROFILE_MAX_LAYERS = 64;
+
+// std140 layout of the RdProfileAtlas block in subsurface.glsl
+struct ShaderRdProfileAtlas {
+    // maxDistance(x), maxArea(y) of every layer
+    glm::vec4 extents[RD_PROFILE_MAX_LAYERS];
+    GLint distanceWarp;
+    // terms of the LowRank encoding, 0 when the layers hold whole tables
+    GLint lowRank;
+    // 1 with the Analytic encoding
+    GLint analytic;
+    GLint padding[1];
+    // weights[0], rates[0], weights[1] and rates[1] of the
+    // BSSRDFAnalyticProfile of layer i at [4 i, 4 i + 4)
+    glm::vec4 analyticTerms[RD_PROFILE_MAX_LAYERS * 4];
+};
+
+// the layer of params in profiles, appended while there is room. A scene
+// with more distinct parameter sets than RD_PROFILE_MAX_LAYERS logs an
+// error and the excess ones share the layer of the closest profile
+int assignRdProfileLayer(std::vector<BSSRDFParams>& profiles,
+                         const BSSRDFParams& params);
+
+// Rd tables of every subsurface material in one texture array, a material
+// finds its table through the layer the G-buffer pass writes to GBuffer5.g.
+// With the LowRank encoding a layer holds the curves of its
+// BSSRDFLowRankTable instead of the table, with the Analytic one the
+// texture is a placeholder and the uniform block holds the fitted profiles
+class RdProfileAtlas {
+    std::unique_ptr<loo::Texture2DArray> m_texture;
+    std::unique_ptr<loo::UniformBuffer> m_uniformbuffer;
+    BSSRDFEncodingOptions m_encoding{};
+    int m_layers{0};
+    size_t m_memorysize{0};
+
+   public:
+    // used from the next build() on
+    void setEncoding(const BSSRDFEncodingOptions& encoding) {
+        m_encoding = encoding;
+    }
+    const BSSRDFEncodingOptions& getEncoding() const { return m_encoding; }
+    // layer i holds tables[i], all of them tabulated with the same options,
+    // at most RD_PROFILE_MAX_LAYERS(see assignRdProfileLayer()). Logs the
+    // error of every encoded layer
+    void build(const std::vector<BSSRDFTabulator>& tables);
+    bool empty() const { return m_layers == 0; }
+    int getLayerCount() const { return m_layers; }
+    // bytes of the texture array
+    size_t getMemorySize() const { return m_memorysize; }
+    const loo::Texture2DArray& getTexture() const { return *m_texture; }
+};
+
+#endif /* HDSSS_INCLUDE_RD_PROFILE_ATLAS_HPP */
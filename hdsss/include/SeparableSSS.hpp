@@ -0,0 +1,68 @@
+#ifndef HDSSS_INCLUDE_SEPARABLE_SSS_HPP
+#define HDSSS_INCLUDE_SEPARABLE_SSS_HPP
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <loo/Camera.hpp>
+#include <loo/Framebuffer.hpp>
+#include <loo/Shader.hpp>
+#include <loo/Texture.hpp>
+#include <loo/UniformBuffer.hpp>
+#include <memory>
+#include <vector>
+#include "BSSRDF.hpp"
+#include "BSSRDFGaussianFit.hpp"
+#include "RdProfileAtlas.hpp"
+
+struct SeparableSSSOptions {
+    // gaussians per profile, used by the next setProfiles()
+    int terms{BSSRDF_GAUSSIAN_TERMS_DEFAULT};
+    // a blur tap fades to the center value once its view depth differs by
+    // this many standard deviations of the blur
+    float depthFalloff{2.0f};
+};
+
+// std140 layout of the SeparableSSSProfiles block in separablesss.frag
+struct ShaderSeparableSSSProfiles {
+    // weight(rgb) and variance(a) of term k of layer i at
+    // [i * BSSRDF_GAUSSIAN_TERMS_MAX + k]
+    glm::vec4 terms[RD_PROFILE_MAX_LAYERS * BSSRDF_GAUSSIAN_TERMS_MAX];
+    GLint termCount;
+    GLint padding[3];
+};
+
+// Cheap alternative to the HDSSS passes: every Rd profile is fitted by a
+// few gaussians(BSSRDFGaussianFit) and the transmitted irradiance is blurred
+// by each of them in screen space, two separable passes per term instead of
+// the surfel splatting and the 10 layer gather of ssss.frag. The blurs do
+// not cross material or depth discontinuities
+class SeparableSSS {
+    loo::ShaderProgram m_blurshader;
+    loo::Framebuffer m_blurfb;
+    // horizontal pass of the current term
+    std::unique_ptr<loo::Texture2D> m_horizontaltex;
+    // previous and current term of the ladder
+    std::unique_ptr<loo::Texture2D> m_laddertex[2];
+    // sum of the weighted terms
+    std::unique_ptr<loo::Texture2D> m_resulttex;
+    std::unique_ptr<loo::UniformBuffer> m_uniformbuffer;
+    std::vector<BSSRDFGaussianFit> m_fits;
+
+   public:
+    SeparableSSS();
+    void init();
+    // fits options.terms gaussians to every table, layer i of the
+    // RdProfileAtlas to tables[i]. Logs the error of every fit
+    void setProfiles(const std::vector<BSSRDFTabulator>& tables);
+    const std::vector<BSSRDFGaussianFit>& getFits() const { return m_fits; }
+    void blurPass(const loo::Camera& camera,
+                  const loo::Texture2D& GBufferPosition,
+                  const loo::Texture2D& GBufferNormal,
+                  const loo::Texture2D& GBuffer3,
+                  const loo::Texture2D& GBuffer5,
+                  const loo::Texture2D& transmittedIrradiance);
+    const auto& getResult() { return *m_resulttex; }
+    SeparableSSSOptions options;
+};
+
+#endif /* HDSSS_INCLUDE_SEPARABLE_SSS_HPP */
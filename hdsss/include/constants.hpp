@@ -25,6 +25,11 @@ constexpr int SHADER_BINDING_PORT_MR_OCCLUSION = 11;
 constexpr int SHADER_BINDING_PORT_MR_METALLIC = 12;
 constexpr int SHADER_BINDING_PORT_MR_ROUGHNESS = 13;
 
+// per layer extents of the Rd profile atlas
+constexpr int SHADER_BINDING_PORT_RD_PROFILE_ATLAS = 4;
+// per layer gaussian fits of the Rd profiles, separable SSS
+constexpr int SHADER_BINDING_PORT_SEPARABLE_SSS_PROFILES = 5;
+
 constexpr int SHADER_LIGHTS_MAX = 12;
 
 constexpr long long N_SURFELS_MAX = 40000000ll;
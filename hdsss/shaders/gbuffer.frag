@@ -7,6 +7,8 @@ layout(location = 2) in vec2 vTexCoord;
 // tangent space -> world space
 layout(location = 3) in vec3 vTangent;
 layout(location = 4) in vec3 vBitangent;
+// level of detail of the mesh
+layout(location = 5) flat in int vLod;
 
 layout(location = 0) out vec4 FragPosition;
 layout(location = 1) out vec3 FragNormal;
@@ -20,7 +22,6 @@ uniform vec3 uCameraPosition;
 uniform bool enableNormal;
 uniform bool enableParallax;
 uniform bool enableLodVisualize;
-uniform int meshLod;
 uniform bool applySSS;
 const float ambientIntensity = 0.01f;
 #ifdef MATERIAL_PBR
@@ -30,6 +31,8 @@ layout(std140, binding = 3) uniform PBRMetallicMaterial {
     vec4 transmissionSigmaT;
     // sigmaA(3) + roughness(1)
     vec4 sigmaARoughness;
+    // layer of the Rd profile atlas
+    int rdProfileLayer;
 }
 simpleMaterial;
 layout(binding = 10) uniform sampler2D baseColorTex;
@@ -94,7 +97,7 @@ layout(binding = 7) uniform sampler2D normalTex;
 
 void main() {
     if (enableLodVisualize) {
-        switch (meshLod) {
+        switch (vLod) {
             case 0:
                 FragAlbedo.rgb = vec3(0.50, 0, 0.15);
                 break;
@@ -141,6 +144,7 @@ void main() {
         simpleMaterial.transmissionSigmaT.gba,
         simpleMaterial.sigmaARoughness.rgb, simpleMaterial.sigmaARoughness.a,
         FragAlbedo, GBuffer3, GBuffer4, GBuffer5);
+    GBuffer5.g = float(simpleMaterial.rdProfileLayer);
 #else
     GBufferFromSimpleMaterial(
         texCoord, diffuseTex, specularTex, simpleMaterial.diffuse.rgb,
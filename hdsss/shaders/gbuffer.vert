@@ -1,7 +1,9 @@
 #version 460 core
 #extension GL_GOOGLE_include_directive : enable
 
-layout(location = 0) in vec3 aPos;
+#include "include/vertex.glsl"
+
+layout(location = 0) in vec4 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 layout(location = 3) in vec3 aTangent;
@@ -12,6 +14,9 @@ layout(location = 1) out vec3 vNormal;
 layout(location = 2) out vec2 vTexCoord;
 layout(location = 3) out vec3 vTangent;
 layout(location = 4) out vec3 vBitangent;
+layout(location = 5) flat out int vLod;
+
+uniform int meshLod;
 
 layout(std140, binding = 0) uniform MVPMatrices {
     mat4 model;
@@ -21,11 +26,16 @@ layout(std140, binding = 0) uniform MVPMatrices {
 };
 
 void main() {
-    mat3 model3 = mat3(model);
-    vNormal = normalize(mat3(normalMatrix) * aNormal);
-    vTangent = normalize(model3 * aTangent);
-    vBitangent = normalize(model3 * aBitangent);
+    mat4 drawModel = drawModelMatrix(model);
+    mat3 model3 = mat3(drawModel);
+    vec3 normal = decodeVertexDirection(aNormal),
+         tangent = decodeVertexDirection(aTangent);
+    vec3 bitangent = decodeVertexBitangent(aPos, normal, tangent, aBitangent);
+    vNormal = normalize(mat3(drawNormalMatrix(normalMatrix)) * normal);
+    vTangent = normalize(model3 * tangent);
+    vBitangent = normalize(model3 * bitangent);
     vTexCoord = aTexCoord;
-    vPos = (model * vec4(aPos, 1.0)).xyz;
+    vLod = drawLod(meshLod);
+    vPos = (drawModel * vec4(decodeVertexPosition(aPos), 1.0)).xyz;
     gl_Position = projection * view * vec4(vPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,192 @@
+#ifndef HDSSS_SHADERS_INCLUDE_DIFFUSION_GLSL
+#define HDSSS_SHADERS_INCLUDE_DIFFUSION_GLSL
+// Diffusion profile math shared by the shaders and the CPU code, so both
+// sides evaluate the same expressions. Written in the common subset of GLSL
+// and C++: every function starts with DIFFUSION_FN, DIFFUSION_T is the
+// scalar type and DIFFUSION_VEC3 its 3-vector. Shaders get the float
+// defaults below, DiffusionProfiles.hpp turns the functions into templates.
+// Keep to that subset: no in/out qualifiers, no pow(), no swizzles and every
+// literal wrapped in DIFFUSION_T().
+#ifndef DIFFUSION_FN
+#define DIFFUSION_FN
+#define DIFFUSION_T float
+#define DIFFUSION_VEC3 vec3
+#endif
+
+#define DIFFUSION_PI DIFFUSION_T(3.14159265358979323846)
+
+// 2 C1 and 3 C2 of the angular moments of the Fresnel reflectance,
+// polynomial fits from d'Eon's "A better dipole"
+DIFFUSION_FN DIFFUSION_T QC1x2(DIFFUSION_T eta) {
+    DIFFUSION_T eta2 = eta * eta, eta3 = eta2 * eta, eta4 = eta3 * eta,
+                eta5 = eta4 * eta;
+    if (eta < DIFFUSION_T(1))
+        return DIFFUSION_T(0.919317) - DIFFUSION_T(3.47930) * eta +
+               DIFFUSION_T(6.753350) * eta2 - DIFFUSION_T(7.809890) * eta3 +
+               DIFFUSION_T(4.985540) * eta4 - DIFFUSION_T(1.368810) * eta5;
+    return DIFFUSION_T(-9.23372) + DIFFUSION_T(22.2272) * eta -
+           DIFFUSION_T(20.9292) * eta2 + DIFFUSION_T(10.2291) * eta3 -
+           DIFFUSION_T(2.54396) * eta4 + DIFFUSION_T(0.254913) * eta5;
+}
+DIFFUSION_FN DIFFUSION_T QC2x3(DIFFUSION_T eta) {
+    DIFFUSION_T eta2 = eta * eta, eta3 = eta2 * eta, eta4 = eta3 * eta,
+                eta5 = eta4 * eta;
+    if (eta < DIFFUSION_T(1))
+        return DIFFUSION_T(0.828421) - DIFFUSION_T(2.62051) * eta +
+               DIFFUSION_T(3.362310) * eta2 - DIFFUSION_T(1.952840) * eta3 +
+               DIFFUSION_T(0.236494) * eta4 + DIFFUSION_T(0.145787) * eta5;
+    return DIFFUSION_T(-1641.1) + DIFFUSION_T(135.926) / eta3 -
+           DIFFUSION_T(656.175) / eta2 + DIFFUSION_T(1376.53) / eta +
+           DIFFUSION_T(1213.67) * eta - DIFFUSION_T(568.556) * eta2 +
+           DIFFUSION_T(164.798) * eta3 - DIFFUSION_T(27.0181) * eta4 +
+           DIFFUSION_T(1.91826) * eta5;
+}
+// weights of the fluence and of the vector irradiance in the exitance
+DIFFUSION_FN DIFFUSION_T CPhi(DIFFUSION_T eta) {
+    return DIFFUSION_T(0.25) * (DIFFUSION_T(1) - QC1x2(eta));
+}
+DIFFUSION_FN DIFFUSION_T CE(DIFFUSION_T eta) {
+    return DIFFUSION_T(0.5) * (DIFFUSION_T(1) - QC2x3(eta));
+}
+
+// unpolarized Fresnel transmittance into a medium of relative index eta
+DIFFUSION_FN DIFFUSION_T fresnelTransmittance(DIFFUSION_T cosTheta,
+                                              DIFFUSION_T eta) {
+    DIFFUSION_T c = abs(cosTheta);
+    DIFFUSION_T g = sqrt(eta * eta + c * c - DIFFUSION_T(1));
+    DIFFUSION_T gmc = g - c, gpc = g + c;
+    DIFFUSION_T a = gmc / gpc;
+    DIFFUSION_T b = (c * gpc - DIFFUSION_T(1)) / (c * gmc + DIFFUSION_T(1));
+    DIFFUSION_T R = DIFFUSION_T(0.5) * a * a * (DIFFUSION_T(1) + b * b);
+    return clamp(DIFFUSION_T(1) - R, DIFFUSION_T(0), DIFFUSION_T(1));
+}
+
+// Jensen's fit of the diffuse Fresnel reflectance used by the classic dipole
+DIFFUSION_FN DIFFUSION_T diffuseFresnelReflectance(DIFFUSION_T eta) {
+    return DIFFUSION_T(-1.44) / (eta * eta) + DIFFUSION_T(0.71) / eta +
+           DIFFUSION_T(0.668) + DIFFUSION_T(0.0636) * eta;
+}
+
+// radiant exitance of the classic dipole per unit incident flux at squared
+// distance rSquare from the point of incidence
+DIFFUSION_FN DIFFUSION_VEC3 dipoleRadiantExitance(DIFFUSION_T rSquare,
+                                                  DIFFUSION_VEC3 sigmaSPrime,
+                                                  DIFFUSION_VEC3 sigmaA,
+                                                  DIFFUSION_T eta) {
+    DIFFUSION_VEC3 sigmaTPrime = sigmaSPrime + sigmaA;
+    // effective transport extinction coefficient
+    DIFFUSION_VEC3 sigmaTr = sqrt(DIFFUSION_T(3) * sigmaA * sigmaTPrime);
+    DIFFUSION_T Fdr = diffuseFresnelReflectance(eta);
+    DIFFUSION_T A = (DIFFUSION_T(1) + Fdr) / (DIFFUSION_T(1) - Fdr);
+    // depths of the real and the virtual source, the first one sits a mean
+    // free path below the surface
+    DIFFUSION_VEC3 zr = DIFFUSION_T(1) / sigmaTPrime;
+    DIFFUSION_VEC3 zv = zr * (DIFFUSION_T(1) + DIFFUSION_T(1.3333) * A);
+    DIFFUSION_VEC3 dr = sqrt(rSquare + zr * zr);
+    DIFFUSION_VEC3 dv = sqrt(rSquare + zv * zv);
+    DIFFUSION_VEC3 C1 = zr * (sigmaTr + DIFFUSION_T(1) / dr);
+    DIFFUSION_VEC3 C2 = zv * (sigmaTr + DIFFUSION_T(1) / dv);
+    return (DIFFUSION_T(1) - Fdr) *
+           (C1 * exp(-sigmaTr * dr) / (dr * dr) +
+            C2 * exp(-sigmaTr * dv) / (dv * dv)) *
+           (DIFFUSION_T(0.25) / DIFFUSION_PI);
+}
+
+// 1 - exp(-x), which cancels to zero in float for the tiny sample distances
+// close to r = 0, so small x switch to its series. DiffusionProfiles.hpp
+// evaluates it directly in double, SIMD lanes blend the same two branches
+#define DIFFUSION_SERIES_THRESHOLD DIFFUSION_T(1e-3)
+DIFFUSION_FN DIFFUSION_T oneMinusExp(DIFFUSION_T x) {
+    return x < DIFFUSION_SERIES_THRESHOLD
+               ? x * (DIFFUSION_T(1) -
+                      x * (DIFFUSION_T(0.5) - x * DIFFUSION_T(1.0 / 6.0)))
+               : DIFFUSION_T(1) - exp(-x);
+}
+
+// photon beam diffusion integrand of one channel without its source term:
+// kappa * (C_phi R_phi + C_E R_E) at depth t and squared radius r2, for the
+// full integrand multiply with alpha * sigmaT * exp(-sigmaT * t).
+// cPhi and cE are CPhi(eta) and CE(eta), zb the extrapolation distance
+DIFFUSION_FN DIFFUSION_T pbdResponse(DIFFUSION_T r2, DIFFUSION_T t,
+                                     DIFFUSION_T sigmaT, DIFFUSION_T sigmaTr,
+                                     DIFFUSION_T alpha, DIFFUSION_T Dg,
+                                     DIFFUSION_T zb, DIFFUSION_T cPhi,
+                                     DIFFUSION_T cE) {
+    DIFFUSION_T dr = sqrt(r2 + t * t);
+    DIFFUSION_T zv = t + DIFFUSION_T(2) * zb;
+    DIFFUSION_T dv = sqrt(r2 + zv * zv);
+    DIFFUSION_T kappa = oneMinusExp(DIFFUSION_T(2) * sigmaT * (dr + t));
+    DIFFUSION_T er = exp(-sigmaTr * dr) / dr;
+    DIFFUSION_T ev = exp(-sigmaTr * dv) / dv;
+    DIFFUSION_T RE = t * (DIFFUSION_T(1) + sigmaTr * dr) * er / (dr * dr) +
+                     zv * (DIFFUSION_T(1) + sigmaTr * dv) * ev / (dv * dv);
+    // R_phi = (er - ev) / Dg, the divisions by constants come first so the
+    // SIMD loops hoist them
+    return alpha / (DIFFUSION_T(4) * DIFFUSION_PI) *
+           (cPhi / Dg * (er - ev) + cE * RE) * kappa;
+}
+
+// Exponential pair profile, per channel
+//   R(r) = sum_j weight_j * rate_j * exp(-rate_j * r) / (2 pi r)
+// Burley's normalized diffusion is the pair rate_2 = rate_1 / 3 with weights
+// of 1/4 and 3/4 of the albedo. Every term integrates to its weight over the
+// plane and to weight_j * (1 - exp(-rate_j * rho)) within a radius rho.
+
+// part of a normalized term of the given rate that falls inside a disk of
+// radius rA at distance from the profile center, counting only the circles
+// rho0 <= rho <= rho1 around the center that cross the disk boundary. A
+// circle contributes its share acos(c) / pi inside the disk. The shares are
+// averaged over the CDF of the term, so the nodes crowd where a sharp term
+// puts its weight, with the cosine spacing and sine weights that follow the
+// square root behaviour of the share at both ends of the band
+#define DIFFUSION_DISK_BAND_NODES 8
+DIFFUSION_FN DIFFUSION_T exponentialDiskBand(DIFFUSION_T rate,
+                                             DIFFUSION_T distance,
+                                             DIFFUSION_T rA, DIFFUSION_T rho0,
+                                             DIFFUSION_T rho1) {
+    DIFFUSION_T spread = oneMinusExp(rate * (rho1 - rho0));
+    if (spread <= DIFFUSION_T(0))
+        return DIFFUSION_T(0);
+    DIFFUSION_T share = DIFFUSION_T(0), weights = DIFFUSION_T(0);
+    for (int k = 0; k < DIFFUSION_DISK_BAND_NODES; k++) {
+        DIFFUSION_T theta = (DIFFUSION_T(k) + DIFFUSION_T(0.5)) *
+                            DIFFUSION_PI /
+                            DIFFUSION_T(DIFFUSION_DISK_BAND_NODES);
+        DIFFUSION_T t = DIFFUSION_T(0.5) - DIFFUSION_T(0.5) * cos(theta);
+        DIFFUSION_T rho = rho0 - log(DIFFUSION_T(1) - t * spread) / rate;
+        DIFFUSION_T c = (rho * rho - rA * rA + distance * distance) /
+                        (DIFFUSION_T(2) * distance * rho);
+        DIFFUSION_T weight = sin(theta);
+        share += weight * acos(clamp(c, DIFFUSION_T(-1), DIFFUSION_T(1)));
+        weights += weight;
+    }
+    return exp(-rate * rho0) * spread * share / (weights * DIFFUSION_PI);
+}
+
+// mean of the exponential pair over a disk of the given area whose center
+// lies at distance > 0 from the profile center, i.e. the Rd' a table cell
+// holds up to the scale of the tabulator. The circles completely inside the
+// disk are closed form, the band crossing its boundary is the quadrature of
+// exponentialDiskBand()
+DIFFUSION_FN DIFFUSION_VEC3 exponentialPairDiskAverage(
+    DIFFUSION_T distance, DIFFUSION_T area, DIFFUSION_VEC3 weight1,
+    DIFFUSION_VEC3 rate1, DIFFUSION_VEC3 weight2, DIFFUSION_VEC3 rate2) {
+    DIFFUSION_T rA = sqrt(area / DIFFUSION_PI);
+    DIFFUSION_T inner = rA - distance;
+    DIFFUSION_T rho0 = abs(inner), rho1 = distance + rA;
+    DIFFUSION_VEC3 result = DIFFUSION_VEC3(DIFFUSION_T(0));
+    for (int c = 0; c < 3; c++) {
+        DIFFUSION_T sum =
+            weight1[c] * exponentialDiskBand(rate1[c], distance, rA, rho0,
+                                             rho1) +
+            weight2[c] *
+                exponentialDiskBand(rate2[c], distance, rA, rho0, rho1);
+        if (inner > DIFFUSION_T(0))
+            sum += weight1[c] * oneMinusExp(rate1[c] * inner) +
+                   weight2[c] * oneMinusExp(rate2[c] * inner);
+        result[c] = sum / area;
+    }
+    return result;
+}
+
+#endif /* HDSSS_SHADERS_INCLUDE_DIFFUSION_GLSL */
@@ -2,6 +2,7 @@
 #define HDSSS_SHADERS_INCLUDE_SUBSURFACE_HPP
 
 #extension GL_GOOGLE_include_directive : enable
+#include "./diffusion.glsl"
 #include "./surfel.glsl"
 
 struct SplatReceiver {
@@ -22,35 +23,8 @@ vec3 computeRadiantExitance(const in vec3 x_in, const in vec3 x_out,
     r_square *= sizeFactor * sizeFactor;
     r_square = max(clampDistance * clampDistance, r_square);
 
-    // vec3 sigma_s_prime = (1.0 - g) * sigma_s;
-    // // Reduced scattering coefficient
-
-    vec3 sigma_t_prime =
-        sigma_s_prime + sigma_a;  // Reduced extinction coefficient
-    vec3 sigma_tr =
-        sqrt(3.0 * sigma_a *
-             sigma_t_prime);  // Effective transport extinction coefficient
-
-    vec3 l_u = 1.0 / sigma_t_prime;  // Mean-free path
-
-    float F_dr = -1.44 / (eta * eta) + 0.71 / eta + 0.668 +
-                 0.0636 * eta;  // Diffuse Fresnel term
-    float A = (1.0 + F_dr) / (1.0 - F_dr);
-
-    vec3 z_r = l_u;  // Distance of inner dipole light to surface
-    vec3 z_v =
-        l_u * (1.0 + 1.3333 * A);  // Distance of outer dipole light to surface
-
-    vec3 d_r = sqrt(r_square + z_r * z_r);  // Distance to real light source
-    vec3 d_v = sqrt(r_square + z_v * z_v);  // Distance to virtual light source
-
-    vec3 C_1 = z_r * (sigma_tr + 1.0 / d_r);
-    vec3 C_2 = z_v * (sigma_tr + 1.0 / d_v);
-
-    return (1.0 - F_dr) *
-           (C_1 * exp(-sigma_tr * d_r) / (d_r * d_r) +
-            C_2 * exp(-sigma_tr * d_v) / (d_v * d_v)) *
-           0.25 * (1.0 / PI) * sampleArea;
+    return dipoleRadiantExitance(r_square, sigma_s_prime, sigma_a, eta) *
+           sampleArea;
 }
 
 float radianceFactor(const in vec3 direction) {
@@ -75,51 +49,99 @@ vec3 computeEffect(const in Surfel surfel, const in vec3 adjustedXi,
            surfel.light;
 }
 
-float fresnelTransmittance(in float cosTheta, in float eta) {
-    float c = abs(cosTheta);
-    float g_s = sqrt(pow(eta, 2) + c * c - 1);
-    float gmc = g_s - c;
-    float gpc = g_s + c;
-    float R = ((gmc / gpc) * (gmc / gpc)) / 2 *
-              (1 + pow(((c * gpc - 1) / (c * gmc + 1)), 2));
+// RD_PROFILE_MAX_LAYERS
+#define RD_PROFILE_MAX_LAYERS 64
+// ShaderRdProfileAtlas, SHADER_BINDING_PORT_RD_PROFILE_ATLAS
+layout(std140, binding = 4) uniform RdProfileAtlas {
+    // maxDistance(x), maxArea(y) of every layer
+    vec4 RdExtents[RD_PROFILE_MAX_LAYERS];
+    int RdDistanceWarp;
+    // terms of the LowRank encoding, 0 when the layers hold whole tables
+    int RdLowRank;
+    // 1 with the Analytic encoding, the layers hold no tables then
+    int RdAnalytic;
+    // BSSRDFAnalyticProfile of layer i: weights[0], rates[0], weights[1] and
+    // rates[1] at [4 i, 4 i + 4), in rgb
+    vec4 RdAnalyticTerms[RD_PROFILE_MAX_LAYERS * 4];
+};
+// layer of the material's Rd profile, written by the G-buffer pass
+int rdProfileLayer(in sampler2D GBuffer5, in vec2 uv) {
+    return int(texture(GBuffer5, uv).g + 0.5);
+}
 
-    return clamp01(1 - R);
+// BSSRDFAxisWarp of the table columns
+#define RD_WARP_LINEAR 0
+#define RD_WARP_SQRT 1
+#define RD_WARP_LOG 2
+// BSSRDF_LOG_WARP_SCALE
+#define RD_LOG_WARP_SCALE 64.0
+// texture coordinate of the column holding relative distance r
+float unwarpRdDistance(in int warp, in float r) {
+    if (warp == RD_WARP_SQRT)
+        return sqrt(r);
+    if (warp == RD_WARP_LOG)
+        return log(1.0 + RD_LOG_WARP_SCALE * r) / log(1.0 + RD_LOG_WARP_SCALE);
+    return r;
 }
 
-vec3 sampleFromRdProfile(in sampler2D RdProfile, in float RdMaxArea,
-                         in float RdMaxDistance, in float area,
-                         in float distance) {
-    float v = 1.0 - (area / RdMaxArea);
-    float u = distance / RdMaxDistance;
-    return texture(RdProfile, vec2(u, v)).rgb;
+// BSSRDFLowRankTable: row k < RdLowRank of the layer holds the distance
+// curve of term k, row RdLowRank + k its area curve, both indexed like the
+// columns and rows of the table
+vec3 sampleLowRankRdProfile(in sampler2DArray RdProfile, in int layer,
+                            in float u, in float v) {
+    float rows = float(2 * RdLowRank);
+    vec3 Rd = vec3(0.0);
+    for (int k = 0; k < RdLowRank; k++) {
+        float distanceRow = (float(k) + 0.5) / rows;
+        float areaRow = (float(k + RdLowRank) + 0.5) / rows;
+        Rd += texture(RdProfile, vec3(u, distanceRow, layer)).rgb *
+              texture(RdProfile, vec3(v, areaRow, layer)).rgb;
+    }
+    return max(Rd, vec3(0.0));
 }
 
-float QC1x2(float eta) {
-    float eta2 = eta * eta, eta3 = eta2 * eta, eta4 = eta3 * eta,
-          eta5 = eta4 * eta;
-    if (eta < 1)
-        return 0.919317 - 3.47930 * eta + 6.753350 * eta2 - 7.809890 * eta3 +
-               4.985540 * eta4 - 1.368810 * eta5;
-    else
-        return -9.23372 + 22.2272 * eta - 20.9292 * eta2 + 10.2291 * eta3 -
-               2.54396 * eta4 + 0.254913 * eta5;
+// BSSRDF_TABLE_SCALE
+#define RD_ANALYTIC_TABLE_SCALE 2.0
+// the cell at area and distance of the table the layer's exponential pair
+// was fitted to, computed without any fetch
+vec3 sampleAnalyticRdProfile(in int layer, in float area, in float distance) {
+    int i = 4 * layer;
+    return RD_ANALYTIC_TABLE_SCALE *
+           exponentialPairDiskAverage(distance, area, RdAnalyticTerms[i].rgb,
+                                      RdAnalyticTerms[i + 1].rgb,
+                                      RdAnalyticTerms[i + 2].rgb,
+                                      RdAnalyticTerms[i + 3].rgb);
 }
-float CPhi(float eta) {
-    return 1.0 / 4. * (1 - QC1x2(eta));
+
+vec3 sampleFromRdProfile(in sampler2DArray RdProfile, in int layer,
+                         in float area, in float distance) {
+    vec2 extent = RdExtents[layer].xy;
+    float v = 1.0 - (area / extent.y);
+    // the cell of the row the table lookup below reads, clamped like the
+    // tabulator does
+    if (RdAnalytic != 0)
+        return sampleAnalyticRdProfile(
+            layer, max(extent.y * clamp01(v), 1e-6),
+            clamp(distance, 1e-6, extent.x));
+    float u = unwarpRdDistance(RdDistanceWarp, clamp01(distance / extent.x));
+    // column x holds u = x / (n - 1), address its texel center
+    float n = float(textureSize(RdProfile, 0).x);
+    u = (u * (n - 1.0) + 0.5) / n;
+    if (RdLowRank > 0)
+        return sampleLowRankRdProfile(RdProfile, layer, u, v);
+    return texture(RdProfile, vec3(u, v, layer)).rgb;
 }
 
-vec3 computeFragmentEffect(in sampler2D RdProfile, in float RdMaxArea,
-                           in float RdMaxDistance, in vec3 xo, in vec3 no,
-                           in float area, in vec3 xi, in vec3 cameraPos,
-                           in vec3 transmittedIrradiance) {
+vec3 computeFragmentEffect(in sampler2DArray RdProfile, in int layer,
+                           in vec3 xo, in vec3 no, in float area, in vec3 xi,
+                           in vec3 cameraPos, in vec3 transmittedIrradiance) {
     vec3 v = normalize(cameraPos - xo);
     // outgoing fresnel term
     float fresnelTermXo = fresnelTransmittance(dot(no, v), eta);
     // incident fresnel term, assuming perpendicular incidence
     float fresnelTermXi = fresnelTransmittance(1, eta);
 
-    vec3 Rd = sampleFromRdProfile(RdProfile, RdMaxArea, RdMaxDistance, area,
-                                  length(xo - xi));
+    vec3 Rd = sampleFromRdProfile(RdProfile, layer, area, length(xo - xi));
     return fresnelTermXo * fresnelTermXi * Rd * transmittedIrradiance * PI_INV *
            0.25 / CPhi(eta);
 }
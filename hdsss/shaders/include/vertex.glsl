@@ -0,0 +1,76 @@
+#ifndef HDSSS_SHADERS_INCLUDE_VERTEX_GLSL
+#define HDSSS_SHADERS_INCLUDE_VERTEX_GLSL
+// decodes the vertex layouts of loo::Mesh, which sets these per mesh. The
+// float layout passes the attributes through. The quantized one
+// (loo::PackedVertex) holds the position as unorm16 in the mesh bounds with
+// the bitangent sign in w, octahedral normal and tangent in the xy of their
+// attributes and no bitangent. Mirrors loo::unpackVertex()
+uniform bool vertexQuantized;
+uniform vec3 vertexPositionMin;
+uniform vec3 vertexPositionExtent;
+
+// indirect draws of loo::Scene read the loo::DrawData of their instance
+// instead, for them drawIndirect is set
+uniform bool drawIndirect;
+struct DrawData {
+    mat4 model;
+    mat4 normalMatrix;
+    // w: 1 for the quantized layout
+    vec4 positionMin;
+    // w: level of detail
+    vec4 positionExtent;
+};
+layout(std430, binding = 0) readonly buffer DrawDataBlock {
+    DrawData drawData[];
+};
+// the instances of a command read consecutive entries
+DrawData currentDrawData() {
+    return drawData[gl_BaseInstance + gl_InstanceID];
+}
+
+// the matrices of the per mesh uniform block are passed in
+mat4 drawModelMatrix(mat4 model) {
+    return drawIndirect ? currentDrawData().model : model;
+}
+mat4 drawNormalMatrix(mat4 normalMatrix) {
+    return drawIndirect ? currentDrawData().normalMatrix
+                        : normalMatrix;
+}
+int drawLod(int meshLod) {
+    return drawIndirect ? int(currentDrawData().positionExtent.w)
+                        : meshLod;
+}
+bool isVertexQuantized() {
+    return drawIndirect ? currentDrawData().positionMin.w != 0.0
+                        : vertexQuantized;
+}
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// aPos is declared vec4, w defaults to 1 for the float layout
+vec3 decodeVertexPosition(vec4 aPos) {
+    if (!isVertexQuantized())
+        return aPos.xyz;
+    if (drawIndirect) {
+        DrawData draw = currentDrawData();
+        return draw.positionMin.xyz + aPos.xyz * draw.positionExtent.xyz;
+    }
+    return vertexPositionMin + aPos.xyz * vertexPositionExtent;
+}
+vec3 decodeVertexDirection(vec3 attribute) {
+    return isVertexQuantized() ? decodeOctahedral(attribute.xy) : attribute;
+}
+// normal and tangent decoded
+vec3 decodeVertexBitangent(vec4 aPos, vec3 normal, vec3 tangent,
+                           vec3 aBitangent) {
+    return isVertexQuantized() ? (aPos.w * 2.0 - 1.0) * cross(normal, tangent)
+                               : aBitangent;
+}
+
+#endif /* HDSSS_SHADERS_INCLUDE_VERTEX_GLSL */
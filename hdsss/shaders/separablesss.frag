@@ -0,0 +1,111 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+#include "include/math.glsl"
+#include "include/subsurface.glsl"
+
+// One step of the gaussian ladder of BSSRDFGaussianFit. Term k blurs the
+// result of term k - 1 by the difference of their variances, horizontally
+// and then vertically. The vertical pass writes the ladder and adds the
+// weighted term to the subsurface result
+layout(location = 0) out vec3 FragLadder;
+layout(location = 1) out vec3 FragResult;
+in vec2 texCoord;
+
+layout(binding = 0) uniform sampler2D GBufferPosition;
+layout(binding = 1) uniform sampler2D GBufferNormal;
+// pbr: transmission(1)(sss mask) + sigma_t(3)
+layout(binding = 2) uniform sampler2D GBuffer3;
+// occlusion(1) + Rd profile layer(1)
+layout(binding = 3) uniform sampler2D GBuffer5;
+// the previous term, or the transmitted irradiance for the first one
+layout(binding = 4) uniform sampler2D Source;
+
+// BSSRDF_GAUSSIAN_TERMS_MAX
+#define SSSS_GAUSSIAN_TERMS_MAX 6
+// ShaderSeparableSSSProfiles, SHADER_BINDING_PORT_SEPARABLE_SSS_PROFILES
+layout(std140, binding = 5) uniform SeparableSSSProfiles {
+    // weight(rgb) and variance(a) of term k of layer i at
+    // [i * SSSS_GAUSSIAN_TERMS_MAX + k]
+    vec4 SSSSTerms[RD_PROFILE_MAX_LAYERS * SSSS_GAUSSIAN_TERMS_MAX];
+    int SSSSTermCount;
+};
+
+uniform int term;
+uniform bool axisX;
+uniform vec3 cameraPos;
+uniform vec3 cameraFront;
+// pixels per world unit at a view depth of 1
+uniform float pixelScale;
+// a tap fades to the center value once its depth differs by this many
+// standard deviations
+uniform float depthFalloff;
+
+// taps on either side, spread over 3 standard deviations
+#define SSSS_TAPS 6
+
+bool isSubsurface(in vec2 uv) {
+#ifdef MATERIAL_PBR
+    return texture(GBuffer3, uv).r > 0.0;
+#else
+    return length(texture(GBuffer3, uv).rgb) > 0.0;
+#endif
+}
+
+void main() {
+    FragLadder = vec3(0.0);
+    FragResult = vec3(0.0);
+    if (!isSubsurface(texCoord))
+        return;
+    int layer = rdProfileLayer(GBuffer5, texCoord);
+    int index = layer * SSSS_GAUSSIAN_TERMS_MAX + term;
+    float variance = SSSSTerms[index].a -
+                     (term > 0 ? SSSSTerms[index - 1].a : 0.0);
+    float sigma = sqrt(max(variance, 0.0));
+
+    vec3 position = textureLod(GBufferPosition, texCoord, 0).rgb;
+    float depth = dot(position - cameraPos, cameraFront);
+    vec3 center = textureLod(Source, texCoord, 0).rgb;
+    vec2 texelSize = 1.0 / vec2(textureSize(Source, 0));
+    vec2 axis = axisX ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);
+    // standard deviation in pixels at the fragment's depth
+    float sigmaPixels = sigma * pixelScale / max(depth, 1e-4);
+
+    vec3 color = center;
+    if (sigmaPixels > 0.5) {
+        float spacing = 3.0 * sigmaPixels / float(SSSS_TAPS);
+        float weightSum = 1.0;
+        for (int i = -SSSS_TAPS; i <= SSSS_TAPS; i++) {
+            if (i == 0)
+                continue;
+            float offset = float(i) * spacing;
+            float weight = exp(-0.5 * sqr(offset / sigmaPixels));
+            vec2 uv = texCoord + offset * axis;
+            vec3 tap = textureLod(Source, uv, 0).rgb;
+            // other materials and the background keep the center value, so
+            // the blur neither bleeds across them nor loses energy
+            if (!isSubsurface(uv) || rdProfileLayer(GBuffer5, uv) != layer) {
+                tap = center;
+            } else {
+                float tapDepth =
+                    dot(textureLod(GBufferPosition, uv, 0).rgb - cameraPos,
+                        cameraFront);
+                tap = mix(tap, center,
+                          clamp01(abs(tapDepth - depth) /
+                                  (depthFalloff * max(sigma, 1e-6))));
+            }
+            color += weight * tap;
+            weightSum += weight;
+        }
+        color /= weightSum;
+    }
+    FragLadder = color;
+    if (axisX)
+        return;
+    // same factors as computeFragmentEffect
+    vec3 normal = normalize(textureLod(GBufferNormal, texCoord, 0).rgb);
+    vec3 v = normalize(cameraPos - position);
+    float fresnel = fresnelTransmittance(dot(normal, v), eta) *
+                    fresnelTransmittance(1, eta);
+    FragResult = fresnel * PI_INV * 0.25 / CPhi(eta) *
+                 SSSSTerms[index].rgb * color;
+}
@@ -1,5 +1,9 @@
 #version 460 core
-layout(location = 0) in vec3 aPos;
+#extension GL_GOOGLE_include_directive : enable
+
+#include "include/vertex.glsl"
+
+layout(location = 0) in vec4 aPos;
 
 uniform mat4 lightSpaceMatrix;
 layout(std140, binding = 0) uniform MVPMatrices {
@@ -10,5 +14,6 @@ layout(std140, binding = 0) uniform MVPMatrices {
 };
 
 void main() {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+    gl_Position = lightSpaceMatrix * drawModelMatrix(model) *
+                  vec4(decodeVertexPosition(aPos), 1.0);
 }
\ No newline at end of file
@@ -16,11 +16,11 @@ layout(binding = 2) uniform sampler2D GBuffer3;
 layout(binding = 3) uniform sampler2D GBuffer4;
 layout(binding = 4) uniform sampler2D TransmittedIrradiance;
 
-layout(binding = 5) uniform sampler2D RdProfile;
+layout(binding = 5) uniform sampler2DArray RdProfile;
+// occlusion(1) + Rd profile layer(1)
+layout(binding = 6) uniform sampler2D GBuffer5;
 
 uniform float pixelAreaScale;
-uniform float RdMaxArea;
-uniform float RdMaxDistance;
 uniform bool samplingMarkerEnable;
 uniform ivec2 samplingMarkerCenter;
 uniform vec3 cameraPos;
@@ -64,6 +64,7 @@ struct FragData {
     vec2 uv;
     vec3 sigma_a;
     vec3 sigma_s;
+    int rdLayer;
 };
 
 void computeLayerEffect(in int layer, in vec2 baseTexSize, in FragData fragData,
@@ -79,11 +80,11 @@ void computeLayerEffect(in int layer, in vec2 baseTexSize, in FragData fragData,
         vec3 transmitted_irradiance =
             sampleMipmap(TransmittedIrradiance, uv, gridWidth).rgb;
 
-        color +=
-            computeFragmentEffect(RdProfile, RdMaxArea, RdMaxDistance,
-                                  fragData.position, fragData.normal, gridSize,
-                                  position, cameraPos, transmitted_irradiance) *
-            sqrt(layer);
+        color += computeFragmentEffect(RdProfile, fragData.rdLayer,
+                                       fragData.position, fragData.normal,
+                                       gridSize, position, cameraPos,
+                                       transmitted_irradiance) *
+                 sqrt(layer);
 
         if (samplingMarkerEnable) {
             ivec2 xy = ivec2(samplingMarkerCenter + uvOffset);
@@ -114,7 +115,8 @@ void main() {
     const vec3 fragNormalWS =
         normalize(textureLod(GBufferNormal, texCoord, 0).rgb);
     FragData fragData =
-        FragData(fragPositionWS, fragNormalWS, texCoord, sigma_a, sigma_s);
+        FragData(fragPositionWS, fragNormalWS, texCoord, sigma_a, sigma_s,
+                 rdProfileLayer(GBuffer5, texCoord));
     // sampling layer 0
     for (int i = -INNER_LAYER_N; i <= INNER_LAYER_N; i++) {
         for (int j = -INNER_LAYER_N; j <= INNER_LAYER_N; j++) {
@@ -124,10 +126,10 @@ void main() {
             vec3 transmitted_irradiance =
                 texture(TransmittedIrradiance, uv).rgb;
 
-            color += computeFragmentEffect(RdProfile, RdMaxArea, RdMaxDistance,
-                                           fragData.position, fragData.normal,
-                                           pixelAreaScale, position, cameraPos,
-                                           transmitted_irradiance);
+            color += computeFragmentEffect(
+                RdProfile, fragData.rdLayer, fragData.position,
+                fragData.normal, pixelAreaScale, position, cameraPos,
+                transmitted_irradiance);
             // debug sampling
             if (samplingMarkerEnable) {
                 ivec2 xy = samplingMarkerCenter +
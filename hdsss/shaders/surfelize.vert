@@ -1,7 +1,9 @@
 #version 460 core
 #extension GL_GOOGLE_include_directive : enable
 
-layout(location = 0) in vec3 aPos;
+#include "include/vertex.glsl"
+
+layout(location = 0) in vec4 aPos;
 layout(location = 1) in vec3 aNormal;
 
 layout(location = 0) out vec3 vPos;
@@ -15,7 +17,8 @@ layout(std140, binding = 0) uniform MVPMatrices {
 };
 
 void main() {
-    mat3 model3 = mat3(model);
-    vNormal = normalize(mat3(normalMatrix) * aNormal);
-    vPos = (model * vec4(aPos, 1.0)).xyz;
+    vNormal = normalize(mat3(drawNormalMatrix(normalMatrix)) *
+                        decodeVertexDirection(aNormal));
+    vPos = (drawModelMatrix(model) * vec4(decodeVertexPosition(aPos), 1.0))
+               .xyz;
 }
@@ -9,10 +9,9 @@ in Surfel geometrySurfel;
 
 layout(binding = 0, location = 7) uniform sampler2D GBufferPosition;
 layout(binding = 1, location = 8) uniform sampler2D GBufferNormal;
-layout(binding = 3, location = 12) uniform sampler2D RdProfile;
+layout(binding = 3, location = 12) uniform sampler2DArray RdProfile;
+layout(binding = 4, location = 13) uniform sampler2D GBuffer5;
 layout(location = 9) uniform float strength;
-layout(location = 14) uniform float RdMaxArea;
-layout(location = 13) uniform float RdMaxDistance;
 layout(location = 5) uniform struct FB {
     ivec2 resolution;
 } framebufferDeviceStep;
@@ -45,9 +44,10 @@ void main() {
         //             strength;
 
         vec3 n = normalize(pixelNormal), v = normalize(cameraPos - xo);
-        fragColor = computeFragmentEffect(RdProfile, RdMaxArea, RdMaxDistance,
-                                          pixelPosition.xyz, n, surfelArea,
-                                          adjustedXi, cameraPos, vec3(1)) *
+        int layer = rdProfileLayer(GBuffer5, uv);
+        fragColor = computeFragmentEffect(RdProfile, layer, pixelPosition.xyz,
+                                          n, surfelArea, adjustedXi, cameraPos,
+                                          vec3(1)) *
                     strength;
     } else {
         fragColor = vec3(0.0);
@@ -1,20 +1,27 @@
 #include "BSSRDF.hpp"
 #include <corecrt_math.h>
 #include <corecrt_math_defines.h>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/ext.hpp>
 #include <iostream>
 #include <limits>
+#include <loo/Parallel.hpp>
 #include <string>
+#include <vector>
+#include "DiffusionProfiles.hpp"
 #include "glm/detail/qualifier.hpp"
 using namespace std;
 using namespace glm;
 
-BSSRDFTabulator::BSSRDFTabulator()
-    : m_table(BSSRDF_TABLE_SIZE * BSSRDF_TABLE_SIZE) {}
+BSSRDFTabulator::BSSRDFTabulator(const BSSRDFTabulateOptions& options)
+    : m_table(options.tableSize * options.tableSize), options(options) {}
 constexpr double BSSRDF_TABLE_MIN_CONTRIBUTION = 1e-7;
 
 dvec3 sourceFunction(dvec3 albedo, dvec3 sigmaT, double r) {
@@ -22,25 +29,10 @@ dvec3 sourceFunction(dvec3 albedo, dvec3 sigmaT, double r) {
 }
 
 double QC1x2(double eta) {
-    double eta2 = eta * eta, eta3 = eta2 * eta, eta4 = eta3 * eta,
-           eta5 = eta4 * eta;
-    if (eta < 1)
-        return 0.919317 - 3.47930 * eta + 6.753350 * eta2 - 7.809890 * eta3 +
-               4.985540 * eta4 - 1.368810 * eta5;
-    else
-        return -9.23372 + 22.2272 * eta - 20.9292 * eta2 + 10.2291 * eta3 -
-               2.54396 * eta4 + 0.254913 * eta5;
+    return diffusion::QC1x2(eta);
 }
 double QC2x3(double eta) {
-    double eta2 = eta * eta, eta3 = eta2 * eta, eta4 = eta3 * eta,
-           eta5 = eta4 * eta;
-    if (eta < 1)
-        return 0.828421 - 2.62051 * eta + 3.362310 * eta2 - 1.952840 * eta3 +
-               0.236494 * eta4 + 0.145787 * eta5;
-    else
-        return -1641.1 + 135.926 / eta3 - 656.175 / eta2 + 1376.53 / eta +
-               1213.67 * eta - 568.556 * eta2 + 164.798 * eta3 -
-               27.0181 * eta4 + 1.91826 * eta5;
+    return diffusion::QC2x3(eta);
 }
 dvec3 linearstep(dvec3 edge0, dvec3 edge1, dvec3 t) {
     t = ((t - edge0) / (edge1 - edge0));
@@ -95,38 +87,23 @@ dvec3 PBDProfile(dvec3 sigma_a, dvec3 sigma_t, double eta, double r) {
     double A_boundary = (1 + QC2x3(eta)) / (1 - QC1x2(eta));
     dvec3 z_b = 2 * A_boundary * D_g;
 
-    double C_phi = 1 / 4. * (1 - QC1x2(eta));
-    double C_E = 1 / 2. * (1 - QC2x3(eta));
+    double C_phi = diffusion::CPhi(eta);
+    double C_E = diffusion::CE(eta);
 
     double rn = 0.5;
 
     dvec3 weight = linearstep(blending_range_min, blending_range_max, dvec3(r));
     // print all variables
-    dvec3 KP_phi_equi(0.0), KP_E_equi(0.0);
+    dvec3 KP_equi(0.0);
 
+    // C_phi * S_phi + C_E * S_E
     auto PBDEvalSample = [=](double in_r, double t, int channel) {
-        double zr = t;
-
-        double dr = sqrt(in_r * in_r + t * t);
-        double dv = sqrt(in_r * in_r + pow(t + 2 * z_b[channel], 2));
-
-        double kappa = 1 - exp(-2 * sigma_t[channel] * (dr + t));
-
         double Q =
             alpha[channel] * sigma_t[channel] * exp(-sigma_t[channel] * t);
-
-        double R_phi = alpha[channel] / (4 * M_PI) / D_g[channel] *
-                       (exp(-sigma_tr[channel] * dr) / dr -
-                        exp(-sigma_tr[channel] * dv) / dv);
-        double R_E = alpha[channel] / (4 * M_PI) *
-                     (zr * (1 + sigma_tr[channel] * dr) *
-                          exp(-sigma_tr[channel] * dr) / pow(dr, 3) +
-                      (zr + 2 * z_b[channel]) * (1 + sigma_tr[channel] * dv) *
-                          exp(-sigma_tr[channel] * dv) / pow(dv, 3));
-
-        double S_phi = R_phi * Q * kappa;
-        double S_E = R_E * Q * kappa;
-        return std::make_tuple(S_phi, S_E);
+        return diffusion::pbdResponse(in_r * in_r, t, sigma_t[channel],
+                                      sigma_tr[channel], alpha[channel],
+                                      D_g[channel], z_b[channel], C_phi, C_E) *
+               Q;
     };
 
     for (int i = 0; i < 3; i++) {
@@ -136,30 +113,28 @@ dvec3 PBDProfile(dvec3 sigma_a, dvec3 sigma_t, double eta, double r) {
                 double x = (j_equi + rn) / num_samples_equi;
                 auto [t_equi, pdf_t_equi] = equiangular_sampling(
                     x, 0, numeric_limits<double>::infinity(), r);
-                auto [S_phi_equi, S_E_equi] = PBDEvalSample(r, t_equi, i);
+                double S_equi = PBDEvalSample(r, t_equi, i);
                 double pdf_t_exp =
                     exponential_sampling_pdfeval(t_equi, sigma_t[i]);
                 double w_t_equi_MIS =
                     (1 - weight[i]) * double(num_samples_equi) * pdf_t_equi /
                     ((1 - weight[i]) * double(num_samples_equi) * pdf_t_equi +
                      weight[i] * double(num_samples_exp) * pdf_t_exp);
-                KP_phi_equi[i] += S_phi_equi * w_t_equi_MIS / pdf_t_equi;
-                KP_E_equi[i] += S_E_equi * w_t_equi_MIS / pdf_t_equi;
+                KP_equi[i] += S_equi * w_t_equi_MIS / pdf_t_equi;
             }
 
-            KP_phi_equi[i] = KP_phi_equi[i] / num_samples_equi;
-            KP_E_equi[i] = KP_E_equi[i] / num_samples_equi;
+            KP_equi[i] = KP_equi[i] / num_samples_equi;
         }
     }
 
-    dvec3 KP_phi_exp(0), KP_E_exp(0);
+    dvec3 KP_exp(0);
     for (int i = 0; i < 3; i++) {
         if (r > blending_range_min[i]) {
             for (int j_exp = 0; j_exp < num_samples_exp; j_exp++) {
 
                 double x = (j_exp + rn) / num_samples_exp;
                 auto [t_exp, pdf_t_exp] = exponential_sampling(x, sigma_t[i]);
-                auto [S_phi_exp, S_E_exp] = PBDEvalSample(r, t_exp, i);
+                double S_exp = PBDEvalSample(r, t_exp, i);
                 double pdf_t_equi = equiangular_sampling_pdfeval(
                     t_exp, 0, numeric_limits<double>::infinity(), r);
 
@@ -168,31 +143,312 @@ dvec3 PBDProfile(dvec3 sigma_a, dvec3 sigma_t, double eta, double r) {
                     ((1 - weight[i]) * double(num_samples_equi) * pdf_t_equi +
                      weight[i] * double(num_samples_exp) * pdf_t_exp);
 
-                KP_phi_exp[i] =
-                    KP_phi_exp[i] + S_phi_exp * w_t_exp_MIS / pdf_t_exp;
-                KP_E_exp[i] = KP_E_exp[i] + S_E_exp * w_t_exp_MIS / pdf_t_exp;
+                KP_exp[i] = KP_exp[i] + S_exp * w_t_exp_MIS / pdf_t_exp;
             }
 
-            KP_phi_exp[i] = KP_phi_exp[i] / double(num_samples_exp);
-            KP_E_exp[i] = KP_E_exp[i] / double(num_samples_exp);
+            KP_exp[i] = KP_exp[i] / double(num_samples_exp);
         }
     }
-    return C_phi * (KP_phi_equi + KP_phi_exp) + C_E * (KP_E_equi + KP_E_exp);
+    return KP_equi + KP_exp;
 }
 dvec3 interpolate(dvec3 v0, dvec3 v1, double t) {
     return v0 * (1 - t) + v1 * t;
 }
-void BSSRDFTabulator::tabulate(const PBRMetallicMaterial& material) {
-    const auto shaderMaterial = material.getShaderMaterial();
-    dvec3 sigmaA(shaderMaterial.sigmaARoughness.r,
-                 shaderMaterial.sigmaARoughness.g,
-                 shaderMaterial.sigmaARoughness.b),
-        sigmaT(shaderMaterial.transmissionSigmaT.g,
-               shaderMaterial.transmissionSigmaT.b,
-               shaderMaterial.transmissionSigmaT.a),
-        albedo(shaderMaterial.baseColorMetallic.r,
-               shaderMaterial.baseColorMetallic.g,
-               shaderMaterial.baseColorMetallic.b);
+BSSRDFParams BSSRDFParams::fromMaterial(const PBRMetallicMaterial& material) {
+    return fromShaderMaterial(material.getShaderMaterial());
+}
+BSSRDFParams BSSRDFParams::fromShaderMaterial(
+    const ShaderPBRMetallicMaterial& shaderMaterial) {
+    BSSRDFParams params;
+    params.sigmaA = dvec3(shaderMaterial.sigmaARoughness.r,
+                          shaderMaterial.sigmaARoughness.g,
+                          shaderMaterial.sigmaARoughness.b);
+    params.sigmaT = dvec3(shaderMaterial.transmissionSigmaT.g,
+                          shaderMaterial.transmissionSigmaT.b,
+                          shaderMaterial.transmissionSigmaT.a);
+    params.albedo = dvec3(shaderMaterial.baseColorMetallic.r,
+                          shaderMaterial.baseColorMetallic.g,
+                          shaderMaterial.baseColorMetallic.b);
+    return params;
+}
+
+void BSSRDFTabulator::tabulate(const PBRMetallicMaterial& material,
+                               unsigned int nThreads) {
+    tabulate(BSSRDFParams::fromMaterial(material), nThreads);
+}
+
+double warpDistance(BSSRDFAxisWarp warp, double u) {
+    switch (warp) {
+        case BSSRDFAxisWarp::Sqrt:
+            return u * u;
+        case BSSRDFAxisWarp::Log:
+            return expm1(u * log1p(BSSRDF_LOG_WARP_SCALE)) /
+                   BSSRDF_LOG_WARP_SCALE;
+        default:
+            return u;
+    }
+}
+
+double unwarpDistance(BSSRDFAxisWarp warp, double r) {
+    switch (warp) {
+        case BSSRDFAxisWarp::Sqrt:
+            return sqrt(std::max(r, 0.0));
+        case BSSRDFAxisWarp::Log:
+            return log1p(BSSRDF_LOG_WARP_SCALE * std::max(r, 0.0)) /
+                   log1p(BSSRDF_LOG_WARP_SCALE);
+        default:
+            return r;
+    }
+}
+
+namespace {
+// radii of one adaptive profile segment, refined independently
+constexpr int BSSRDF_PROFILE_SEGMENT = 32;
+
+// the adaptive profile is smooth in r, so between two evaluated radii the
+// ones in between are only evaluated where a geometric interpolation misses
+// the midpoint by more than BSSRDF_PROFILE_TOLERANCE
+struct AdaptiveProfileSampler {
+    dvec3 sigmaA, sigmaT;
+    double eta;
+    const vector<double>& radii;
+    vector<dvec3>& profile;
+    int64_t samples{0};
+
+    void evaluate(size_t i) {
+        int radiusSamples = 0;
+        profile[i] = PBDProfileAdaptive(sigmaA, sigmaT, eta, radii[i],
+                                        BSSRDF_PROFILE_TOLERANCE,
+                                        &radiusSamples);
+        samples += radiusSamples;
+    }
+    dvec3 interpolate(size_t i0, size_t i1, size_t i) const {
+        double t = double(i - i0) / double(i1 - i0);
+        dvec3 v0 = profile[i0], v1 = profile[i1], v;
+        for (int c = 0; c < 3; c++) {
+            v[c] = v0[c] > 0 && v1[c] > 0
+                       ? v0[c] * std::pow(v1[c] / v0[c], t)
+                       : v0[c] * (1 - t) + v1[c] * t;
+        }
+        return v;
+    }
+    // profile[i0] and profile[i1] are evaluated already
+    void refine(size_t i0, size_t i1) {
+        if (i1 - i0 < 2)
+            return;
+        size_t mid = (i0 + i1) / 2;
+        evaluate(mid);
+        dvec3 error = abs(interpolate(i0, i1, mid) - profile[mid]);
+        bool converged = true;
+        for (int c = 0; c < 3; c++) {
+            double bound = BSSRDF_PROFILE_TOLERANCE * std::abs(profile[mid][c]);
+            converged &= error[c] <= bound;
+        }
+        if (converged) {
+            for (size_t i = i0 + 1; i < i1; i++) {
+                if (i != mid)
+                    profile[i] = i < mid ? interpolate(i0, mid, i)
+                                         : interpolate(mid, i1, i);
+            }
+            return;
+        }
+        refine(i0, mid);
+        refine(mid, i1);
+    }
+};
+
+// PBDProfile at spacing * i for i < count, in batches spread over the
+// workers. Fixed batches run on SIMD, adaptive segments are refined where
+// the profile bends
+vector<dvec3> sampleProfile(dvec3 sigmaA, dvec3 sigmaT, double eta,
+                            BSSRDFProfileQuadrature quadrature, double spacing,
+                            int count, unsigned int nThreads) {
+    constexpr int BATCH = 256;
+    vector<double> radii(count);
+    for (int i = 0; i < count; i++) {
+        radii[i] = spacing * i;
+    }
+    vector<dvec3> profile(count);
+    if (quadrature == BSSRDFProfileQuadrature::Fixed) {
+        loo::parallelFor(
+            (count + BATCH - 1) / BATCH,
+            [&](size_t batch) {
+                size_t begin = batch * BATCH;
+                PBDProfileBatch(sigmaA, sigmaT, eta, &radii[begin],
+                                &profile[begin],
+                                std::min<size_t>(BATCH, count - begin));
+            },
+            nThreads);
+        return profile;
+    }
+    // the segment ends first, then every segment between its two ends
+    int segments =
+        std::max((count - 1 + BSSRDF_PROFILE_SEGMENT - 1) /
+                     BSSRDF_PROFILE_SEGMENT,
+                 1);
+    auto segmentEnd = [&](size_t k) {
+        return std::min<size_t>(k * BSSRDF_PROFILE_SEGMENT, count - 1);
+    };
+    atomic<int64_t> samples{0};
+    loo::parallelFor(
+        segments + 1,
+        [&](size_t k) {
+            AdaptiveProfileSampler sampler{sigmaA, sigmaT, eta, radii,
+                                           profile};
+            sampler.evaluate(segmentEnd(k));
+            samples += sampler.samples;
+        },
+        nThreads);
+    loo::parallelFor(
+        segments,
+        [&](size_t k) {
+            AdaptiveProfileSampler sampler{sigmaA, sigmaT, eta, radii,
+                                           profile};
+            sampler.refine(segmentEnd(k), segmentEnd(k + 1));
+            samples += sampler.samples;
+        },
+        nThreads);
+    LOG(INFO) << "Adaptive Rd profile: " << samples << " samples over "
+              << count << " radii";
+    return profile;
+}
+
+// linear interpolation of the precomputed Rd profile, clamped at both ends
+struct RdCurve {
+    const vector<dvec3>& samples;
+    double rMax;
+    dvec3 operator()(double xi) const {
+        int size = samples.size();
+        double x = xi / rMax * (size - 1);
+        x = std::max(x, 1e-6);
+        int x0 = std::floor(x), x1 = std::ceil(x);
+        x0 = std::clamp(x0, 0, size - 1);
+        x1 = std::clamp(x1, 0, size - 1);
+        double t = x - x0;
+        t = std::clamp(t, 0.0, 1.0);
+        return interpolate(samples[x0], samples[x1], t);
+    }
+};
+
+// one table row(fixed A) with the reference trapezoid march, steps of
+// deltaX over the profile for every column distance
+void marchRow(const RdCurve& Rd, double A, double rMax, double deltaX,
+              const vector<double>& columns, vec3* row) {
+    double rA = sqrt(A * M_1_PI);
+    for (size_t x = 0; x < columns.size(); x++) {
+        // use x for r
+        double r = columns[x];
+        double xi = std::max(0.0, rA - rMax), xEnd = rA + r;
+        dvec3 value(0.0);
+        while (xi < xEnd) {
+            double xi1 = xi + deltaX;
+            double bi = 2 * xi *
+                        acos(std::clamp(
+                            (xi * xi - rA * rA + r * r) / (2.0 * r * xi), -1.0,
+                            1.0)),
+                   bi1 = 2 * xi1 *
+                         acos(std::clamp((xi1 * xi1 - rA * rA + r * r) /
+                                             (2.0 * r * xi1),
+                                         -1.0, 1.0));
+            dvec3 arcRdIntegral = Rd(xi) * bi + Rd(xi1) * bi1;
+            arcRdIntegral *= deltaX;
+            value += arcRdIntegral;
+            xi = xi1;
+        }
+        value /= A;
+        row[x] = value;
+    }
+}
+
+// panels across rMax for the band integrals, bounds the work per cell
+// independently of the table size
+constexpr int BSSRDF_BAND_PANELS = 32;
+// profile samples read by the band quadrature
+constexpr int BSSRDF_BAND_PROFILE_SIZE = 4096;
+constexpr double GAUSS_LEGENDRE_4_NODES[4]{
+    -0.8611363115940526, -0.3399810435848563, 0.3399810435848563,
+    0.8611363115940526};
+constexpr double GAUSS_LEGENDRE_4_WEIGHTS[4]{
+    0.3478548451374538, 0.6521451548625461, 0.6521451548625461,
+    0.3478548451374538};
+
+// integral of 2*pi*x*Rd(x) from x0 to x0 + tau * h for Rd linear between
+// Rd0 at x0 and Rd1 at x0 + h
+dvec3 fullCircleIntegral(double x0, double h, dvec3 Rd0, dvec3 Rd1,
+                         double tau) {
+    dvec3 slope = Rd1 - Rd0;
+    return 2.0 * M_PI * h *
+           (x0 * Rd0 * tau + (x0 * slope + h * Rd0) * (tau * tau / 2.0) +
+            h * slope * (tau * tau * tau / 3.0));
+}
+
+// quadrature nodes on [-1, 1] for a band split into a given number of
+// panels, mapped through x = -cos(theta) with panels of equal width in x
+struct BandNode {
+    double x, weight;
+};
+vector<vector<BandNode>> bandQuadratureNodes(int maxPanels) {
+    vector<vector<BandNode>> nodes(maxPanels + 1);
+    for (int panels = 1; panels <= maxPanels; panels++) {
+        double theta0 = 0.0;
+        for (int p = 1; p <= panels; p++) {
+            double theta1 =
+                p == panels ? M_PI : acos(1.0 - 2.0 * double(p) / panels);
+            double half = (theta1 - theta0) / 2, mid = (theta1 + theta0) / 2;
+            for (int k = 0; k < 4; k++) {
+                double theta = mid + half * GAUSS_LEGENDRE_4_NODES[k];
+                nodes[panels].push_back(
+                    {-cos(theta),
+                     GAUSS_LEGENDRE_4_WEIGHTS[k] * half * sin(theta)});
+            }
+            theta0 = theta1;
+        }
+    }
+    return nodes;
+}
+
+// integral of Rd over the circles around the profile center that cross the
+// disk boundary, i.e. x in [|r - rA|, r + rA] weighted by the arc length
+// inside the disk. The cosine mapping of the nodes removes the square root
+// behaviour of the arc length at both ends of the band
+dvec3 bandIntegral(const RdCurve& Rd, const vector<BandNode>& nodes, double r,
+                   double rA) {
+    double m = std::max(r, rA), h = std::min(r, rA);
+    dvec3 sum(0.0);
+    for (const auto& node : nodes) {
+        double x = m + h * node.x;
+        double arc =
+            2 * x *
+            acos(std::clamp((x * x - rA * rA + r * r) / (2.0 * r * x), -1.0,
+                            1.0));
+        sum += (node.weight * h * arc) * Rd(x);
+    }
+    return sum;
+}
+}  // namespace
+
+vector<dvec3> sampleRdProfile(const BSSRDFParams& params,
+                              BSSRDFProfileQuadrature quadrature,
+                              double spacing, int count,
+                              unsigned int nThreads) {
+    if (nThreads == 0)
+        nThreads = loo::defaultThreadCount();
+    return sampleProfile(params.sigmaA, params.sigmaT, params.eta, quadrature,
+                         spacing, count, nThreads);
+}
+
+void BSSRDFTabulator::tabulate(const BSSRDFParams& params,
+                               unsigned int nThreads) {
+    auto startTime = chrono::steady_clock::now();
+    const int N = options.tableSize;
+    CHECK_GE(N, 2);
+    this->params = params;
+    m_mapping.reset();
+    m_table.resize(N * N);
+    if (nThreads == 0)
+        nThreads = loo::defaultThreadCount();
+    const dvec3 sigmaA = params.sigmaA, sigmaT = params.sigmaT,
+                albedo = params.albedo;
     double rLeft = 0, rRight = 100, rMax = (rLeft + rRight) / 2.0;
     dvec3 Qr;
     double QrMax;
@@ -208,67 +464,269 @@ void BSSRDFTabulator::tabulate(const PBRMetallicMaterial& material) {
         }
     }
     double Amax = M_PI * rMax * rMax;
-    double eta = 1.5;
+    double eta = params.eta;
     maxArea = Amax;
     maxDistance = rMax;
     LOG(INFO) << "rMax: " << rMax << " Amax: " << Amax;
     // step1: precompute the Rd profile
-    LOG(INFO) << "Precomputing Rd profile...";
-    dvec3 RdProfile[BSSRDF_TABLE_SIZE];
-    double deltaX = rMax / (BSSRDF_TABLE_SIZE - 1), xi = 0;
-    for (int y = 0; y < BSSRDF_TABLE_SIZE; y++) {
-        dvec3 Rd = PBDProfile(sigmaA, sigmaT, eta, xi);
-        RdProfile[y] = Rd;
-        xi += deltaX;
+    LOG(INFO) << "Precomputing Rd profile with " << nThreads << " threads...";
+    double deltaX = rMax / (N - 1);
+    vector<dvec3> RdProfile =
+        sampleProfile(sigmaA, sigmaT, eta, options.profileQuadrature, deltaX,
+                      N, nThreads);
+    RdCurve Rd{RdProfile, rMax};
+    // distance of every table column
+    vector<double> columns(N);
+    for (int x = 0; x < N; x++) {
+        double u = double(x) / (N - 1);
+        columns[x] =
+            std::max(rMax * warpDistance(options.distanceWarp, u), 1e-6);
     }
-    auto interpolateRd = [=](double xi) {
-        double x = xi / rMax * (BSSRDF_TABLE_SIZE - 1);
-        x = std::max(x, 1e-6);
-        int x0 = std::floor(x), x1 = std::ceil(x);
-        x0 = std::clamp(x0, 0, BSSRDF_TABLE_SIZE - 1);
-        x1 = std::clamp(x1, 0, BSSRDF_TABLE_SIZE - 1);
-        double t = x - x0;
-        t = std::clamp(t, 0.0, 1.0);
-        return interpolate(RdProfile[x0], RdProfile[x1], t);
-    };
     // step2: precompute the Rd' integral
     LOG(INFO) << "Precomputing Rd' integral...";
-    for (int y = 0; y < BSSRDF_TABLE_SIZE; y++) {
-        // use y for A
-        double A = Amax * y / BSSRDF_TABLE_SIZE;
-        A = std::max(A, 1e-6);
-        double rA = sqrt(A * M_1_PI);
-        for (int x = 0; x < BSSRDF_TABLE_SIZE; x++) {
-            // use x for r
-            double r = rMax * x / (BSSRDF_TABLE_SIZE - 1);
-            r = std::max(r, 1e-6);
-            double xi = std::max(0.0, rA - rMax), xEnd = rA + r;
-            dvec3 value(0.0);
-            while (xi < xEnd) {
-                double xi1 = xi + deltaX;
-                double bi = 2 * xi *
-                            acos(std::clamp(
-                                (xi * xi - rA * rA + r * r) / (2.0 * r * xi),
-                                -1.0, 1.0)),
-                       bi1 = 2 * xi1 *
-                             acos(std::clamp((xi1 * xi1 - rA * rA + r * r) /
-                                                 (2.0 * r * xi1),
-                                             -1.0, 1.0));
-                dvec3 arcRdIntegral =
-                    interpolateRd(xi) * bi + interpolateRd(xi1) * bi1;
-                arcRdIntegral *= deltaX;
-                value += arcRdIntegral;
-                xi = xi1;
-            }
-            value /= A;
-            m_table[y * BSSRDF_TABLE_SIZE + x] = value;
+    atomic<int> rowsDone{0};
+    auto reportRow = [&]() {
+        int done = ++rowsDone;
+        if (done % 64 == 0)
+            LOG(INFO) << "y: " << done << " / " << N;
+    };
+    if (options.integration == BSSRDFIntegration::March) {
+        // every row(fixed A) is independent, so rows are the unit of work
+        loo::parallelFor(
+            N,
+            [&](size_t y) {
+                // use y for A
+                double A = std::max(Amax * y / N, 1e-6);
+                marchRow(Rd, A, rMax, deltaX, columns, &m_table[y * N]);
+                reportRow();
+            },
+            nThreads);
+    } else {
+        // the March sum is 2/A times the integral of Rd over the disk. Split
+        // at x = rA - r, the circles inside it lie completely in the disk and
+        // are read from a prefix sum, only the band of circles crossing the
+        // disk boundary needs a quadrature per cell
+        // the quadrature nodes fall between the table columns, where a linear
+        // interpolation of the N samples overestimates the convex falloff,
+        // so the profile is resampled finer for this mode
+        const int M = std::max(N, BSSRDF_BAND_PROFILE_SIZE);
+        const double deltaM = rMax / (M - 1);
+        vector<dvec3> fineProfile =
+            sampleProfile(sigmaA, sigmaT, eta, options.profileQuadrature,
+                          deltaM, M, nThreads);
+        RdCurve fineRd{fineProfile, rMax};
+        vector<dvec3> fullCirclePrefix(M);
+        fullCirclePrefix[0] = dvec3(0.0);
+        for (int k = 1; k < M; k++) {
+            fullCirclePrefix[k] =
+                fullCirclePrefix[k - 1] +
+                fullCircleIntegral(deltaM * (k - 1), deltaM, fineProfile[k - 1],
+                                   fineProfile[k], 1.0);
         }
-        LOG(INFO) << "y: " << y + 1 << " / " << BSSRDF_TABLE_SIZE;
+        auto bandNodes = bandQuadratureNodes(2 * BSSRDF_BAND_PANELS);
+        double panelWidth = rMax / BSSRDF_BAND_PANELS;
+        loo::parallelFor(
+            N,
+            [&](size_t y) {
+                double A = std::max(Amax * y / N, 1e-6);
+                double rA = sqrt(A * M_1_PI);
+                vec3* row = &m_table[y * N];
+                // disks smaller than the profile spacing are not resolved by
+                // the March, keep its values there
+                if (rA < 2.0 * deltaX) {
+                    marchRow(Rd, A, rMax, deltaX, columns, row);
+                    reportRow();
+                    return;
+                }
+                for (int x = 0; x < N; x++) {
+                    double r = columns[x];
+                    // panels of about equal width resolve the profile falloff
+                    int panels = std::clamp(
+                        int(std::ceil(2.0 * std::min(r, rA) / panelWidth)), 1,
+                        2 * BSSRDF_BAND_PANELS);
+                    dvec3 value =
+                        bandIntegral(fineRd, bandNodes[panels], r, rA);
+                    if (r < rA) {
+                        double inner = rA - r;
+                        int k = std::min(int(inner / deltaM), M - 2);
+                        value += fullCirclePrefix[k] +
+                                 fullCircleIntegral(
+                                     deltaM * k, deltaM, fineProfile[k],
+                                     fineProfile[k + 1],
+                                     (inner - deltaM * k) / deltaM);
+                    }
+                    // keeps the scale of the March sum, which adds both
+                    // trapezoid ends at full weight
+                    row[x] = 2.0 * value / A;
+                }
+                reportRow();
+            },
+            nThreads);
     }
+    LOG(INFO) << "Tabulation finished in "
+              << chrono::duration<double, milli>(chrono::steady_clock::now() -
+                                                 startTime)
+                     .count()
+              << " ms using " << nThreads << " threads";
 }
 
-void BSSRDFTabulator::read(const std::string& filename) {
+namespace {
+// on-disk layout of a binary table, the RGB float payload follows directly
+struct BSSRDFTableHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t tableSize;
+    // BSSRDFIntegration used to produce the payload
+    uint32_t integration;
+    // BSSRDFAxisWarp of the columns
+    uint32_t distanceWarp;
+    // BSSRDFProfileQuadrature, zero(Fixed) in files older than the field
+    uint32_t profileQuadrature;
+    double maxDistance, maxArea;
+    double sigmaA[3], sigmaT[3], albedo[3];
+    double eta;
+    // FNV-1a of the payload
+    uint64_t checksum;
+};
+constexpr char BSSRDF_TABLE_MAGIC[4] = {'H', 'D', 'R', 'D'};
+size_t tablePayloadSize(size_t tableSize) {
+    return sizeof(vec3) * tableSize * tableSize;
+}
+
+uint64_t fnv1a(const void* data, size_t size) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+}  // namespace
+
+const vec3* BSSRDFTabulator::getTableData() const {
+    if (m_mapping) {
+        return reinterpret_cast<const vec3*>(m_mapping->data() +
+                                             sizeof(BSSRDFTableHeader));
+    }
+    return m_table.data();
+}
+
+vec3 BSSRDFTabulator::lookup(double distance, double area) const {
+    const int N = options.tableSize;
+    const vec3* table = getTableData();
+    double u = unwarpDistance(options.distanceWarp, distance / maxDistance);
+    double x = std::clamp(u, 0.0, 1.0) * (N - 1);
+    double y = std::clamp(area / maxArea * N, 0.0, double(N - 1));
+    int x0 = std::min(int(x), N - 2), y0 = std::min(int(y), N - 2);
+    float tx = x - x0, ty = y - y0;
+    auto cell = [&](int dx, int dy) {
+        return table[(y0 + dy) * N + x0 + dx];
+    };
+    return mix(mix(cell(0, 0), cell(1, 0), tx),
+               mix(cell(0, 1), cell(1, 1), tx), ty);
+}
+
+BSSRDFTabulator BSSRDFTabulator::resampled(int tableSize) const {
+    CHECK_GE(tableSize, 2);
+    BSSRDFTabulateOptions resampledOptions = options;
+    resampledOptions.tableSize = tableSize;
+    BSSRDFTabulator result(resampledOptions);
+    result.params = params;
+    result.maxDistance = maxDistance;
+    result.maxArea = maxArea;
+    result.m_table.resize(tableSize * tableSize);
+    for (int y = 0; y < tableSize; y++) {
+        double area = maxArea * y / tableSize;
+        for (int x = 0; x < tableSize; x++) {
+            double u = double(x) / (tableSize - 1);
+            double distance =
+                maxDistance * warpDistance(options.distanceWarp, u);
+            result.m_table[y * tableSize + x] = lookup(distance, area);
+        }
+    }
+    return result;
+}
+
+bool BSSRDFTabulator::read(const std::string& filename) {
+    char magic[4]{};
+    {
+        ifstream ifs(filename, ios::binary);
+        if (!ifs) {
+            LOG(ERROR) << "Failed to open BSSRDF table " << filename;
+            return false;
+        }
+        ifs.read(magic, sizeof(magic));
+    }
+    if (memcmp(magic, BSSRDF_TABLE_MAGIC, sizeof(magic)) == 0)
+        return readBinary(filename);
+    LOG(INFO) << "Importing legacy text BSSRDF table " << filename;
+    return importText(filename);
+}
+
+bool BSSRDFTabulator::readBinary(const std::string& filename) {
+    auto mapping = make_shared<loo::MappedFile>(filename);
+    if (!mapping->isOpen())
+        return false;
+    BSSRDFTableHeader header;
+    if (mapping->size() < sizeof(header)) {
+        LOG(ERROR) << filename << ": truncated BSSRDF table header";
+        return false;
+    }
+    memcpy(&header, mapping->data(), sizeof(header));
+    if (header.version != BSSRDF_TABLE_FORMAT_VERSION ||
+        header.tableSize < 2 ||
+        header.integration > uint32_t(BSSRDFIntegration::BandQuadrature) ||
+        header.distanceWarp > uint32_t(BSSRDFAxisWarp::Log) ||
+        header.profileQuadrature >
+            uint32_t(BSSRDFProfileQuadrature::Adaptive)) {
+        LOG(ERROR) << filename << ": unsupported BSSRDF table version "
+                   << header.version << " size " << header.tableSize;
+        return false;
+    }
+    size_t payloadSize = tablePayloadSize(header.tableSize);
+    if (mapping->size() != sizeof(header) + payloadSize) {
+        LOG(ERROR) << filename << ": unexpected BSSRDF table size "
+                   << mapping->size();
+        return false;
+    }
+    if (fnv1a(mapping->data() + sizeof(header), payloadSize) !=
+        header.checksum) {
+        LOG(ERROR) << filename << ": BSSRDF table checksum mismatch";
+        return false;
+    }
+    options.tableSize = header.tableSize;
+    options.integration = BSSRDFIntegration(header.integration);
+    options.distanceWarp = BSSRDFAxisWarp(header.distanceWarp);
+    options.profileQuadrature =
+        BSSRDFProfileQuadrature(header.profileQuadrature);
+    maxDistance = header.maxDistance;
+    maxArea = header.maxArea;
+    params.sigmaA = dvec3(header.sigmaA[0], header.sigmaA[1], header.sigmaA[2]);
+    params.sigmaT = dvec3(header.sigmaT[0], header.sigmaT[1], header.sigmaT[2]);
+    params.albedo = dvec3(header.albedo[0], header.albedo[1], header.albedo[2]);
+    params.eta = header.eta;
+    m_mapping = std::move(mapping);
+    m_table.clear();
+    m_table.shrink_to_fit();
+    return true;
+}
+
+BSSRDFTabulateOptions BSSRDFTabulator::textTableOptions(
+    BSSRDFTabulateOptions options) {
+    // text tables were always marched at the default resolution
+    options.tableSize = BSSRDF_TABLE_SIZE;
+    options.integration = BSSRDFIntegration::March;
+    options.distanceWarp = BSSRDFAxisWarp::Linear;
+    options.profileQuadrature = BSSRDFProfileQuadrature::Fixed;
+    return options;
+}
+
+bool BSSRDFTabulator::importText(const std::string& filename) {
     ifstream ifs(filename);
+    options = textTableOptions(options);
+    m_mapping.reset();
+    m_table.resize(BSSRDF_TABLE_SIZE * BSSRDF_TABLE_SIZE);
     ifs >> maxDistance >> maxArea;
     for (int y = 0; y < BSSRDF_TABLE_SIZE; y++) {
         for (int x = 0; x < BSSRDF_TABLE_SIZE; x++) {
@@ -277,26 +735,47 @@ void BSSRDFTabulator::read(const std::string& filename) {
             m_table[y * BSSRDF_TABLE_SIZE + x] = buf;
         }
     }
-    ifs.close();
+    if (ifs.fail()) {
+        LOG(ERROR) << filename << ": truncated BSSRDF text table";
+        return false;
+    }
+    return true;
 }
 
-void BSSRDFTabulator::save(const std::string& filename) {
-    ofstream ofs(filename);
-    ofs << maxDistance << " " << maxArea << endl;
-    for (int y = 0; y < BSSRDF_TABLE_SIZE; y++) {
-        for (int x = 0; x < BSSRDF_TABLE_SIZE; x++) {
-            auto value = m_table[y * BSSRDF_TABLE_SIZE + x];
-            ofs << value.r << " " << value.g << " " << value.b << " ";
-        }
-        ofs << endl;
+bool BSSRDFTabulator::save(const std::string& filename) const {
+    BSSRDFTableHeader header{};
+    memcpy(header.magic, BSSRDF_TABLE_MAGIC, sizeof(header.magic));
+    header.version = BSSRDF_TABLE_FORMAT_VERSION;
+    header.tableSize = options.tableSize;
+    header.integration = uint32_t(options.integration);
+    header.distanceWarp = uint32_t(options.distanceWarp);
+    header.profileQuadrature = uint32_t(options.profileQuadrature);
+    header.maxDistance = maxDistance;
+    header.maxArea = maxArea;
+    for (int i = 0; i < 3; i++) {
+        header.sigmaA[i] = params.sigmaA[i];
+        header.sigmaT[i] = params.sigmaT[i];
+        header.albedo[i] = params.albedo[i];
     }
+    header.eta = params.eta;
+    size_t payloadSize = tablePayloadSize(options.tableSize);
+    header.checksum = fnv1a(getTableData(), payloadSize);
+
+    ofstream ofs(filename, ios::binary);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(getTableData()), payloadSize);
     ofs.close();
+    if (ofs.fail()) {
+        LOG(ERROR) << "Failed to write BSSRDF table " << filename;
+        return false;
+    }
+    return true;
 }
-unique_ptr<loo::Texture2D> BSSRDFTabulator::generateTexture() {
+unique_ptr<loo::Texture2D> BSSRDFTabulator::generateTexture() const {
     auto tex = make_unique<loo::Texture2D>();
     tex->init();
-    tex->setup(m_table.data(), BSSRDF_TABLE_SIZE, BSSRDF_TABLE_SIZE, GL_RGB32F,
-               GL_RGB, GL_FLOAT, 1);
+    tex->setup(getTableData(), options.tableSize, options.tableSize,
+               GL_RGB32F, GL_RGB, GL_FLOAT, 1);
     tex->setSizeFilter(GL_LINEAR, GL_LINEAR);
     tex->setWrapFilter(GL_CLAMP_TO_EDGE);
     return tex;
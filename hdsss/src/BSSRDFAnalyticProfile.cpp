@@ -0,0 +1,193 @@
+#include "BSSRDFAnalyticProfile.hpp"
+
+#include <corecrt_math.h>
+#include <corecrt_math_defines.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "DiffusionProfiles.hpp"
+using namespace std;
+using namespace glm;
+
+// candidates per rate in the coarse search, the pattern search refines the
+// best pair down to ANALYTIC_FIT_STEP in log space
+constexpr int ANALYTIC_FIT_GRID = 32;
+constexpr double ANALYTIC_FIT_STEP = 1e-3;
+
+namespace {
+
+// one channel of the profile as r * Rd(r) with the trapezoid weights dr
+struct ChannelFit {
+    vector<double> radii, target, dr;
+    double norm{0.0};
+
+    // weights minimizing the squared error of the pair with the given
+    // rates, clamped to non-negative ones. Returns the relative error
+    double solve(double rate1, double rate2, double& weight1,
+                 double& weight2) const {
+        // r * Rd(r) of a unit term is rate * exp(-rate * r) / 2 pi
+        double g11 = 0, g12 = 0, g22 = 0, c1 = 0, c2 = 0;
+        for (size_t i = 0; i < radii.size(); i++) {
+            double b1 = rate1 * exp(-rate1 * radii[i]) / (2.0 * M_PI),
+                   b2 = rate2 * exp(-rate2 * radii[i]) / (2.0 * M_PI);
+            g11 += dr[i] * b1 * b1;
+            g12 += dr[i] * b1 * b2;
+            g22 += dr[i] * b2 * b2;
+            c1 += dr[i] * b1 * target[i];
+            c2 += dr[i] * b2 * target[i];
+        }
+        auto error = [&](double x1, double x2) {
+            return norm - 2.0 * (c1 * x1 + c2 * x2) + x1 * x1 * g11 +
+                   2.0 * x1 * x2 * g12 + x2 * x2 * g22;
+        };
+        double det = g11 * g22 - g12 * g12;
+        weight1 = weight2 = 0.0;
+        if (det > 1e-12 * g11 * g22) {
+            weight1 = (c1 * g22 - c2 * g12) / det;
+            weight2 = (c2 * g11 - c1 * g12) / det;
+        }
+        if (weight1 < 0.0 || weight2 < 0.0 || weight1 + weight2 <= 0.0) {
+            // the optimum lies on a boundary, keep the better single term
+            double only1 = std::max(c1 / g11, 0.0),
+                   only2 = std::max(c2 / g22, 0.0);
+            if (error(only1, 0.0) < error(0.0, only2)) {
+                weight1 = only1;
+                weight2 = 0.0;
+            } else {
+                weight1 = 0.0;
+                weight2 = only2;
+            }
+        }
+        return std::max(error(weight1, weight2), 0.0) / norm;
+    }
+};
+
+}  // namespace
+
+BSSRDFAnalyticProfile BSSRDFAnalyticProfile::fit(const BSSRDFTabulator& table,
+                                                 unsigned int nThreads) {
+    CHECK_GT(table.maxDistance, 0.0);
+    double spacing = table.maxDistance / (BSSRDF_ANALYTIC_FIT_SAMPLES - 1);
+    auto profile =
+        sampleRdProfile(table.params, table.options.profileQuadrature,
+                        spacing, BSSRDF_ANALYTIC_FIT_SAMPLES, nThreads);
+    return fit(profile, spacing);
+}
+
+BSSRDFAnalyticProfile BSSRDFAnalyticProfile::fit(const vector<dvec3>& profile,
+                                                 double spacing) {
+    CHECK_GE(profile.size(), 3);
+    const int count = profile.size();
+    // decay lengths from a sample spacing to the whole profile
+    const double logLow = -log(spacing * (count - 1)),
+                 logHigh = -log(spacing);
+    const double gridStep = (logHigh - logLow) / (ANALYTIC_FIT_GRID - 1);
+
+    BSSRDFAnalyticProfile result;
+    for (int c = 0; c < 3; c++) {
+        ChannelFit channel;
+        channel.radii.resize(count);
+        channel.target.resize(count);
+        channel.dr.resize(count);
+        for (int i = 0; i < count; i++) {
+            channel.radii[i] = spacing * i;
+            channel.target[i] = spacing * i * profile[i][c];
+            // r = 0 is left out, r * Rd vanishes there for the tabulated
+            // profile but not for the pair
+            channel.dr[i] = i == 0                      ? 0.0
+                            : (i == 1 || i == count - 1) ? spacing / 2
+                                                         : spacing;
+            channel.norm +=
+                channel.dr[i] * channel.target[i] * channel.target[i];
+        }
+        if (channel.norm <= 0.0)
+            continue;
+        double w1, w2;
+        // log rates, the first one at least as large as the second
+        auto residual = [&](double a, double b) {
+            if (a > logHigh || b < logLow || a < b)
+                return numeric_limits<double>::infinity();
+            return channel.solve(exp(a), exp(b), w1, w2);
+        };
+        double bestA = logHigh, bestB = logLow,
+               best = numeric_limits<double>::infinity();
+        for (int i = 0; i < ANALYTIC_FIT_GRID; i++) {
+            for (int j = 0; j <= i; j++) {
+                double a = logLow + gridStep * i, b = logLow + gridStep * j;
+                double value = residual(a, b);
+                if (value < best) {
+                    best = value;
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+        for (double step = gridStep / 2; step > ANALYTIC_FIT_STEP;) {
+            bool improved = false;
+            const double moves[4][2]{
+                {step, 0}, {-step, 0}, {0, step}, {0, -step}};
+            for (const auto& move : moves) {
+                double a = bestA + move[0], b = bestB + move[1];
+                double value = residual(a, b);
+                if (value < best) {
+                    best = value;
+                    bestA = a;
+                    bestB = b;
+                    improved = true;
+                }
+            }
+            if (!improved)
+                step /= 2;
+        }
+        channel.solve(exp(bestA), exp(bestB), w1, w2);
+        result.rates[0][c] = exp(bestA);
+        result.rates[1][c] = exp(bestB);
+        result.weights[0][c] = w1;
+        result.weights[1][c] = w2;
+    }
+    return result;
+}
+
+dvec3 BSSRDFAnalyticProfile::evaluate(double r) const {
+    r = std::max(r, 1e-6);
+    dvec3 sum(0.0);
+    for (int j = 0; j < 2; j++)
+        sum += weights[j] * rates[j] * exp(-rates[j] * r) / (2.0 * M_PI * r);
+    return sum;
+}
+
+dvec3 BSSRDFAnalyticProfile::diskAverage(double distance, double area) const {
+    return BSSRDF_TABLE_SCALE *
+           diffusion::exponentialPairDiskAverage(
+               std::max(distance, 1e-6), std::max(area, 1e-6), weights[0],
+               rates[0], weights[1], rates[1]);
+}
+
+vector<vec3> BSSRDFAnalyticProfile::decode(const BSSRDFTabulator& table) const {
+    const int N = table.options.tableSize;
+    vec3 weight1(weights[0]), rate1(rates[0]), weight2(weights[1]),
+        rate2(rates[1]);
+    vector<vec3> cells(size_t(N) * N);
+    for (int y = 0; y < N; y++) {
+        // the distances and areas tabulate() evaluates the cells at
+        float area = std::max(table.maxArea * y / N, 1e-6);
+        for (int x = 0; x < N; x++) {
+            double u = double(x) / (N - 1);
+            float distance = std::max(
+                table.maxDistance * warpDistance(table.options.distanceWarp, u),
+                1e-6);
+            cells[size_t(y) * N + x] =
+                float(BSSRDF_TABLE_SCALE) *
+                diffusion::exponentialPairDiskAverage(distance, area, weight1,
+                                                      rate1, weight2, rate2);
+        }
+    }
+    return cells;
+}
+
+BSSRDFEncodingError BSSRDFAnalyticProfile::measureError(
+    const BSSRDFTabulator& table) const {
+    return measureEncodingError(table, decode(table), 1);
+}
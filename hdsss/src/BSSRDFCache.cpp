@@ -0,0 +1,187 @@
+#include "BSSRDFCache.hpp"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <loo/Hash.hpp>
+#include <loo/Parallel.hpp>
+#include <random>
+#include <vector>
+using namespace std;
+using namespace glm;
+namespace fs = std::filesystem;
+
+BSSRDFCache::BSSRDFCache(fs::path directory, uintmax_t maxBytes)
+    : m_directory(std::move(directory)), m_maxBytes(maxBytes) {}
+
+string BSSRDFCache::key(const BSSRDFParams& params,
+                        const BSSRDFTabulateOptions& options) {
+    loo::SHA256 sha;
+    const char tag[] = "HDSSS BSSRDF table";
+    sha.update(tag, sizeof(tag));
+    sha.updateValue(uint32_t(BSSRDF_TABULATOR_VERSION));
+    sha.updateValue(uint32_t(BSSRDF_TABLE_FORMAT_VERSION));
+    sha.updateValue(uint32_t(options.tableSize));
+    sha.updateValue(uint32_t(options.integration));
+    sha.updateValue(uint32_t(options.distanceWarp));
+    sha.updateValue(uint32_t(options.profileQuadrature));
+    sha.updateValue(params.eta);
+    for (int i = 0; i < 3; i++) {
+        sha.updateValue(params.sigmaA[i]);
+        sha.updateValue(params.sigmaT[i]);
+        sha.updateValue(params.albedo[i]);
+    }
+    return loo::SHA256::toHex(sha.finalize());
+}
+
+fs::path BSSRDFCache::entryPath(const BSSRDFParams& params,
+                                const BSSRDFTabulateOptions& options) const {
+    return m_directory / (key(params, options) + ".bin");
+}
+
+bool BSSRDFCache::load(const BSSRDFParams& params,
+                       BSSRDFTabulator& tabulator) const {
+    auto path = entryPath(params, tabulator.options);
+    error_code ec;
+    if (!fs::exists(path, ec))
+        return false;
+    // read into a scratch tabulator, a rejected entry must not change the
+    // options a miss is tabulated with
+    BSSRDFTabulator entry;
+    if (!entry.read(path.string()))
+        return false;
+    // the header repeats the inputs, so a key collision can never hand out
+    // the wrong profile
+    if (!(entry.params == params) ||
+        !(entry.options == tabulator.options)) {
+        LOG(WARNING) << "BSSRDF cache entry " << path
+                     << " does not match its key, ignoring it";
+        return false;
+    }
+    tabulator = std::move(entry);
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    LOG(INFO) << "BSSRDF cache hit " << path;
+    return true;
+}
+
+void BSSRDFCache::fetch(const BSSRDFParams& params, BSSRDFTabulator& tabulator,
+                        unsigned int nThreads) const {
+    if (load(params, tabulator))
+        return;
+    LOG(INFO) << "BSSRDF cache miss, tabulating "
+              << key(params, tabulator.options);
+    tabulator.tabulate(params, nThreads);
+    store(tabulator);
+}
+
+vector<BSSRDFTabulator> BSSRDFCache::fetch(
+    const vector<BSSRDFParams>& params, const BSSRDFTabulateOptions& options,
+    unsigned int nThreads) const {
+    vector<BSSRDFTabulator> tables(params.size(), BSSRDFTabulator(options));
+    vector<size_t> misses;
+    for (size_t i = 0; i < params.size(); i++) {
+        if (!load(params[i], tables[i]))
+            misses.push_back(i);
+    }
+    if (misses.empty())
+        return tables;
+    if (nThreads == 0)
+        nThreads = loo::defaultThreadCount();
+    // one job over all misses: every table gets an equal share of the
+    // workers and spreads its rows over them
+    unsigned int concurrent = std::min<size_t>(misses.size(), nThreads);
+    unsigned int rowThreads = std::max(1u, nThreads / concurrent);
+    LOG(INFO) << "BSSRDF cache missed " << misses.size() << " of "
+              << params.size() << " tables, tabulating " << concurrent
+              << " at a time";
+    loo::parallelFor(
+        misses.size(),
+        [&](size_t i) {
+            auto& table = tables[misses[i]];
+            table.tabulate(params[misses[i]], rowThreads);
+            store(table);
+        },
+        concurrent);
+    return tables;
+}
+
+bool BSSRDFCache::store(const BSSRDFTabulator& tabulator) const {
+    error_code ec;
+    fs::create_directories(m_directory, ec);
+    if (ec) {
+        LOG(ERROR) << "Failed to create BSSRDF cache directory " << m_directory
+                   << ": " << ec.message();
+        return false;
+    }
+    auto path = entryPath(tabulator.params, tabulator.options);
+    // write under a name no other process uses, then publish with a rename
+    // so readers only ever see complete tables
+    random_device rd;
+    uint64_t nonce = (uint64_t(rd()) << 32) | rd();
+    auto tmpPath = path;
+    tmpPath += ".tmp" + to_string(nonce);
+    if (!tabulator.save(tmpPath.string())) {
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    fs::rename(tmpPath, path, ec);
+    if (ec) {
+        // another process may hold the published entry open on Windows, its
+        // content is identical to ours anyway
+        bool published = fs::exists(path);
+        fs::remove(tmpPath, ec);
+        if (!published) {
+            LOG(ERROR) << "Failed to publish BSSRDF cache entry " << path;
+            return false;
+        }
+    }
+    evict();
+    return true;
+}
+
+void BSSRDFCache::evict() const {
+    struct Entry {
+        fs::path path;
+        uintmax_t size;
+        fs::file_time_type lastUse;
+    };
+    vector<Entry> entries;
+    uintmax_t totalBytes = 0;
+    error_code ec;
+    auto now = fs::file_time_type::clock::now();
+    for (auto& file : fs::directory_iterator(m_directory, ec)) {
+        if (!file.is_regular_file(ec))
+            continue;
+        auto lastUse = file.last_write_time(ec);
+        if (ec)
+            continue;
+        auto path = file.path();
+        if (path.extension() != ".bin") {
+            // temp files left behind by writers that crashed
+            if (path.extension().string().rfind(".tmp", 0) == 0 &&
+                now - lastUse > chrono::hours(1))
+                fs::remove(path, ec);
+            continue;
+        }
+        auto size = file.file_size(ec);
+        if (ec)
+            continue;
+        entries.push_back({path, size, lastUse});
+        totalBytes += size;
+    }
+    if (totalBytes <= m_maxBytes)
+        return;
+    sort(entries.begin(), entries.end(),
+         [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+    for (auto& entry : entries) {
+        if (totalBytes <= m_maxBytes)
+            break;
+        // entries mapped by another process can't be removed on Windows,
+        // they are retried on the next eviction
+        if (fs::remove(entry.path, ec)) {
+            LOG(INFO) << "Evicted BSSRDF cache entry " << entry.path;
+            totalBytes -= entry.size;
+        }
+    }
+}
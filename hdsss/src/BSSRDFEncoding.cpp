@@ -0,0 +1,230 @@
+#include "BSSRDFEncoding.hpp"
+
+#include <corecrt_math.h>
+#include <corecrt_math_defines.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+#include <vector>
+#include "BSSRDFAnalyticProfile.hpp"
+using namespace std;
+using namespace glm;
+
+// power steps of the subspace iteration, more of them change the error of
+// the factorization by a few percent at most
+constexpr int LOW_RANK_ITERATIONS = 12;
+
+const char* encodingName(BSSRDFTableEncoding encoding) {
+    switch (encoding) {
+        case BSSRDFTableEncoding::Float32:
+            return "float32";
+        case BSSRDFTableEncoding::Half:
+            return "half";
+        case BSSRDFTableEncoding::SharedExponent:
+            return "rgb9e5";
+        case BSSRDFTableEncoding::LowRank:
+            return "low_rank";
+        case BSSRDFTableEncoding::Analytic:
+            return "analytic";
+    }
+    return "unknown";
+}
+
+size_t encodedTableSize(int tableSize, const BSSRDFEncodingOptions& options) {
+    size_t cells = size_t(tableSize) * tableSize;
+    switch (options.encoding) {
+        case BSSRDFTableEncoding::Half:
+            return cells * 6;
+        case BSSRDFTableEncoding::SharedExponent:
+            return cells * 4;
+        case BSSRDFTableEncoding::LowRank:
+            return size_t(2 * options.rank) * tableSize * sizeof(vec3);
+        case BSSRDFTableEncoding::Analytic:
+            return 4 * sizeof(vec4);
+        default:
+            return cells * sizeof(vec3);
+    }
+}
+
+namespace {
+
+// columns of the n x k column-major matrix m orthonormalized in place by
+// modified Gram-Schmidt, run twice to stay orthogonal in double. Columns
+// that vanish(rank deficient tables) are zeroed
+void orthonormalize(vector<double>& m, int n, int k) {
+    for (int j = 0; j < k; j++) {
+        double* col = &m[size_t(j) * n];
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < j; i++) {
+                const double* other = &m[size_t(i) * n];
+                double dot = 0.0;
+                for (int y = 0; y < n; y++)
+                    dot += col[y] * other[y];
+                for (int y = 0; y < n; y++)
+                    col[y] -= dot * other[y];
+            }
+        }
+        double norm = 0.0;
+        for (int y = 0; y < n; y++)
+            norm += col[y] * col[y];
+        norm = sqrt(norm);
+        double scale = norm > 1e-300 ? 1.0 / norm : 0.0;
+        for (int y = 0; y < n; y++)
+            col[y] *= scale;
+    }
+}
+
+// out(n x k) = a(n x n, row-major) * in(n x k), or its transpose
+void multiply(const vector<double>& a, const vector<double>& in,
+              vector<double>& out, int n, int k, bool transposed) {
+    fill(out.begin(), out.end(), 0.0);
+    for (int y = 0; y < n; y++) {
+        const double* row = &a[size_t(y) * n];
+        for (int j = 0; j < k; j++) {
+            const double* v = &in[size_t(j) * n];
+            double* o = &out[size_t(j) * n];
+            if (transposed) {
+                // A^T u: row y of A scaled by u[y]
+                double s = v[y];
+                for (int x = 0; x < n; x++)
+                    o[x] += row[x] * s;
+            } else {
+                double dot = 0.0;
+                for (int x = 0; x < n; x++)
+                    dot += row[x] * v[x];
+                o[y] = dot;
+            }
+        }
+    }
+}
+
+}  // namespace
+
+BSSRDFLowRankTable BSSRDFLowRankTable::factorize(const BSSRDFTabulator& table,
+                                                 int rank) {
+    const int N = table.options.tableSize;
+    CHECK_GE(rank, 1);
+    CHECK_LE(rank, std::min(N, BSSRDF_LOW_RANK_MAX));
+    BSSRDFLowRankTable result;
+    result.tableSize = N;
+    result.rank = rank;
+    result.distanceCurves.assign(size_t(rank) * N, vec3(0.0f));
+    result.areaCurves.assign(size_t(rank) * N, vec3(0.0f));
+
+    const vec3* data = table.getTableData();
+    vector<double> a(size_t(N) * N), u(size_t(N) * rank), v(size_t(N) * rank);
+    for (int c = 0; c < 3; c++) {
+        for (size_t i = 0; i < a.size(); i++)
+            a[i] = data[i][c];
+        // deterministic start: the table applied to the first cosines
+        for (int j = 0; j < rank; j++) {
+            for (int x = 0; x < N; x++)
+                v[size_t(j) * N + x] = cos(M_PI * j * (x + 0.5) / N);
+        }
+        multiply(a, v, u, N, rank, false);
+        orthonormalize(u, N, rank);
+        for (int it = 0; it < LOW_RANK_ITERATIONS; it++) {
+            multiply(a, u, v, N, rank, true);
+            multiply(a, v, u, N, rank, false);
+            orthonormalize(u, N, rank);
+        }
+        // projecting onto the converged left subspace, U U^T A, leaves the
+        // area curves orthonormal and puts the singular values into A^T U
+        multiply(a, u, v, N, rank, true);
+        for (int j = 0; j < rank; j++) {
+            for (int i = 0; i < N; i++) {
+                size_t index = size_t(j) * N + i;
+                result.areaCurves[index][c] = float(u[index]);
+                result.distanceCurves[index][c] = float(v[index]);
+            }
+        }
+    }
+    return result;
+}
+
+vec3 BSSRDFLowRankTable::cell(int x, int y) const {
+    vec3 sum(0.0f);
+    for (int k = 0; k < rank; k++) {
+        sum += areaCurves[size_t(k) * tableSize + y] *
+               distanceCurves[size_t(k) * tableSize + x];
+    }
+    return max(sum, vec3(0.0f));
+}
+
+vector<vec3> BSSRDFLowRankTable::decode() const {
+    vector<vec3> cells(size_t(tableSize) * tableSize);
+    for (int y = 0; y < tableSize; y++) {
+        for (int x = 0; x < tableSize; x++)
+            cells[size_t(y) * tableSize + x] = cell(x, y);
+    }
+    return cells;
+}
+
+vector<vec3> decodeTable(const BSSRDFTabulator& table,
+                         const BSSRDFEncodingOptions& options) {
+    const int N = table.options.tableSize;
+    const vec3* data = table.getTableData();
+    vector<vec3> decoded(data, data + size_t(N) * N);
+    switch (options.encoding) {
+        case BSSRDFTableEncoding::Half:
+            for (auto& value : decoded) {
+                for (int c = 0; c < 3; c++)
+                    value[c] = unpackHalf1x16(packHalf1x16(value[c]));
+            }
+            break;
+        case BSSRDFTableEncoding::SharedExponent:
+            for (auto& value : decoded)
+                value = unpackF3x9_E1x5(packF3x9_E1x5(value));
+            break;
+        case BSSRDFTableEncoding::LowRank:
+            decoded =
+                BSSRDFLowRankTable::factorize(table, options.rank).decode();
+            break;
+        case BSSRDFTableEncoding::Analytic:
+            decoded = BSSRDFAnalyticProfile::fit(table).decode(table);
+            break;
+        default:
+            break;
+    }
+    return decoded;
+}
+
+BSSRDFEncodingError measureEncodingError(const BSSRDFTabulator& table,
+                                         const BSSRDFEncodingOptions& options) {
+    return measureEncodingError(table, decodeTable(table, options));
+}
+
+BSSRDFEncodingError measureEncodingError(const BSSRDFTabulator& table,
+                                         const vector<vec3>& decoded,
+                                         int firstRow) {
+    const int N = table.options.tableSize;
+    CHECK(firstRow >= 0 && firstRow < N);
+    const vec3* data = table.getTableData();
+    CHECK_EQ(decoded.size(), size_t(N) * N);
+    const size_t first = size_t(firstRow) * N, cells = size_t(N) * N - first;
+    dvec3 peak(0.0);
+    for (size_t i = first; i < first + cells; i++)
+        peak = max(peak, dvec3(data[i]));
+
+    BSSRDFEncodingError error;
+    double squares = 0.0, relative = 0.0;
+    size_t counted = 0;
+    for (size_t i = first; i < first + cells; i++) {
+        for (int c = 0; c < 3; c++) {
+            if (peak[c] <= 0.0)
+                continue;
+            double reference = data[i][c];
+            double difference = std::abs(double(decoded[i][c]) - reference);
+            error.maxError = std::max(error.maxError, difference / peak[c]);
+            squares += (difference / peak[c]) * (difference / peak[c]);
+            if (reference > BSSRDF_ENCODING_ERROR_FLOOR * peak[c]) {
+                relative += difference / reference;
+                counted++;
+            }
+        }
+    }
+    error.rmsError = sqrt(squares / (3.0 * cells));
+    error.meanRelativeError = counted ? relative / counted : 0.0;
+    return error;
+}
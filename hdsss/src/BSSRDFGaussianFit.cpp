@@ -0,0 +1,320 @@
+#include "BSSRDFGaussianFit.hpp"
+
+#include <corecrt_math.h>
+#include <corecrt_math_defines.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+using namespace std;
+using namespace glm;
+
+// candidates per ladder end in the coarse search, the pattern search
+// refines the best pair down to GAUSSIAN_FIT_STEP in log space
+constexpr int GAUSSIAN_FIT_GRID = 24;
+constexpr double GAUSSIAN_FIT_STEP = 1e-3;
+
+namespace {
+
+double gaussian(double variance, double r) {
+    return exp(-r * r / (2.0 * variance)) / (2.0 * M_PI * variance);
+}
+
+// x minimizing x^T G x - 2 c^T x subject to x >= 0(Lawson-Hanson on the
+// normal equations). G is symmetric positive semi-definite and at most
+// BSSRDF_GAUSSIAN_TERMS_MAX wide
+vector<double> nonNegativeLeastSquares(const vector<double>& G,
+                                       const vector<double>& c, int n) {
+    constexpr double tolerance = 1e-12;
+    vector<double> x(n, 0.0), s(n);
+    vector<bool> passive(n, false);
+    // solves G_PP s_P = c_P by gaussian elimination, zero outside P
+    auto solvePassive = [&]() {
+        vector<int> p;
+        for (int i = 0; i < n; i++) {
+            if (passive[i])
+                p.push_back(i);
+        }
+        int m = p.size();
+        vector<double> a(m * (m + 1));
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < m; j++)
+                a[i * (m + 1) + j] = G[p[i] * n + p[j]];
+            a[i * (m + 1) + m] = c[p[i]];
+        }
+        for (int k = 0; k < m; k++) {
+            int pivot = k;
+            for (int i = k + 1; i < m; i++) {
+                if (std::abs(a[i * (m + 1) + k]) >
+                    std::abs(a[pivot * (m + 1) + k]))
+                    pivot = i;
+            }
+            for (int j = 0; j <= m; j++)
+                swap(a[k * (m + 1) + j], a[pivot * (m + 1) + j]);
+            double diagonal = a[k * (m + 1) + k];
+            if (std::abs(diagonal) < tolerance)
+                continue;
+            for (int i = k + 1; i < m; i++) {
+                double f = a[i * (m + 1) + k] / diagonal;
+                for (int j = k; j <= m; j++)
+                    a[i * (m + 1) + j] -= f * a[k * (m + 1) + j];
+            }
+        }
+        fill(s.begin(), s.end(), 0.0);
+        for (int k = m - 1; k >= 0; k--) {
+            double sum = a[k * (m + 1) + m];
+            for (int j = k + 1; j < m; j++)
+                sum -= a[k * (m + 1) + j] * s[p[j]];
+            double diagonal = a[k * (m + 1) + k];
+            s[p[k]] = std::abs(diagonal) < tolerance ? 0.0 : sum / diagonal;
+        }
+    };
+    for (int outer = 0; outer < 4 * n; outer++) {
+        // gradient of the objective, w_j > 0 means x_j wants to grow
+        int best = -1;
+        double bestGradient = tolerance;
+        for (int j = 0; j < n; j++) {
+            if (passive[j])
+                continue;
+            double w = c[j];
+            for (int k = 0; k < n; k++)
+                w -= G[j * n + k] * x[k];
+            if (w > bestGradient) {
+                bestGradient = w;
+                best = j;
+            }
+        }
+        if (best < 0)
+            break;
+        passive[best] = true;
+        for (int inner = 0; inner < 4 * n; inner++) {
+            solvePassive();
+            bool feasible = true;
+            double alpha = 1.0;
+            for (int j = 0; j < n; j++) {
+                if (passive[j] && s[j] <= 0.0) {
+                    feasible = false;
+                    alpha = std::min(alpha, x[j] / (x[j] - s[j]));
+                }
+            }
+            if (feasible) {
+                x = s;
+                break;
+            }
+            // step towards s until the first weight hits zero and drop it
+            for (int j = 0; j < n; j++) {
+                x[j] += alpha * (s[j] - x[j]);
+                if (passive[j] && x[j] <= tolerance) {
+                    x[j] = 0.0;
+                    passive[j] = false;
+                }
+            }
+        }
+    }
+    return x;
+}
+
+// the profile samples with their weights r_i^2 dr, i.e. the fit is of
+// r * Rd(r), shared by every candidate ladder
+struct FitProblem {
+    const vector<dvec3>& profile;
+    double spacing;
+    vector<double> radii, area;
+    dvec3 norm{0.0};
+
+    FitProblem(const vector<dvec3>& profile, double spacing)
+        : profile(profile), spacing(spacing) {
+        int count = profile.size();
+        radii.resize(count);
+        area.resize(count);
+        for (int i = 0; i < count; i++) {
+            radii[i] = spacing * i;
+            // trapezoid rule
+            double dr = (i == 0 || i == count - 1) ? spacing / 2 : spacing;
+            area[i] = radii[i] * radii[i] * dr;
+            norm += area[i] * profile[i] * profile[i];
+        }
+    }
+
+    // weights of the ladder with the given variances, the returned residual
+    // is the sum of the relative squared errors of the channels
+    double solve(const vector<double>& variances,
+                 vector<dvec3>& weights) const {
+        const int n = variances.size(), count = radii.size();
+        vector<double> basis(size_t(n) * count);
+        for (int k = 0; k < n; k++) {
+            for (int i = 0; i < count; i++)
+                basis[size_t(k) * count + i] = gaussian(variances[k], radii[i]);
+        }
+        vector<double> G(n * n, 0.0), scale(n);
+        for (int j = 0; j < n; j++) {
+            for (int k = j; k < n; k++) {
+                double dot = 0.0;
+                for (int i = 0; i < count; i++) {
+                    dot += area[i] * basis[size_t(j) * count + i] *
+                           basis[size_t(k) * count + i];
+                }
+                G[j * n + k] = G[k * n + j] = dot;
+            }
+        }
+        // unit diagonal, the narrow terms would dominate otherwise
+        for (int j = 0; j < n; j++)
+            scale[j] = G[j * n + j] > 0.0 ? 1.0 / sqrt(G[j * n + j]) : 0.0;
+        for (int j = 0; j < n; j++) {
+            for (int k = 0; k < n; k++)
+                G[j * n + k] *= scale[j] * scale[k];
+        }
+        weights.assign(n, dvec3(0.0));
+        double residual = 0.0;
+        for (int ch = 0; ch < 3; ch++) {
+            if (norm[ch] <= 0.0)
+                continue;
+            vector<double> c(n, 0.0);
+            for (int j = 0; j < n; j++) {
+                for (int i = 0; i < count; i++) {
+                    c[j] += area[i] * basis[size_t(j) * count + i] *
+                            profile[i][ch];
+                }
+                c[j] *= scale[j];
+            }
+            auto x = nonNegativeLeastSquares(G, c, n);
+            // |Ax - b|^2 = b^T b - 2 c^T x + x^T G x
+            double error = norm[ch];
+            for (int j = 0; j < n; j++) {
+                error -= 2.0 * c[j] * x[j];
+                for (int k = 0; k < n; k++)
+                    error += x[j] * G[j * n + k] * x[k];
+                weights[j][ch] = x[j] * scale[j];
+            }
+            residual += std::max(error, 0.0) / norm[ch];
+        }
+        return residual;
+    }
+};
+
+// standard deviations from sigma0 to sigma1, geometric in between
+vector<double> ladder(double logSigma0, double logSigma1, int terms) {
+    vector<double> variances(terms);
+    for (int k = 0; k < terms; k++) {
+        double t = terms > 1 ? double(k) / (terms - 1) : 0.0;
+        double sigma = exp(logSigma0 + (logSigma1 - logSigma0) * t);
+        variances[k] = sigma * sigma;
+    }
+    return variances;
+}
+
+}  // namespace
+
+BSSRDFGaussianFit BSSRDFGaussianFit::fit(const BSSRDFTabulator& table,
+                                         int terms, unsigned int nThreads) {
+    CHECK_GT(table.maxDistance, 0.0);
+    double spacing = table.maxDistance / (BSSRDF_GAUSSIAN_FIT_SAMPLES - 1);
+    auto profile =
+        sampleRdProfile(table.params, table.options.profileQuadrature,
+                        spacing, BSSRDF_GAUSSIAN_FIT_SAMPLES, nThreads);
+    return fit(profile, spacing, terms);
+}
+
+BSSRDFGaussianFit BSSRDFGaussianFit::fit(const vector<dvec3>& profile,
+                                         double spacing, int terms) {
+    CHECK_GE(terms, 1);
+    CHECK_LE(terms, BSSRDF_GAUSSIAN_TERMS_MAX);
+    CHECK_GE(profile.size(), 2);
+    FitProblem problem(profile, spacing);
+    // narrower terms than the sample spacing are not resolved, wider ones
+    // than half the profile only flatten its tail
+    const double logLow = log(spacing),
+                 logHigh = log(spacing * (profile.size() - 1) / 2.0);
+    const double gridStep = (logHigh - logLow) / (GAUSSIAN_FIT_GRID - 1);
+    const double minimalSpread = terms > 1 ? gridStep : 0.0;
+    vector<dvec3> weights;
+    auto residual = [&](double a, double b) {
+        if (a < logLow || b > logHigh || b - a < minimalSpread)
+            return numeric_limits<double>::infinity();
+        return problem.solve(ladder(a, b, terms), weights);
+    };
+
+    double bestA = logLow, bestB = logHigh,
+           best = numeric_limits<double>::infinity();
+    for (int i = 0; i < GAUSSIAN_FIT_GRID; i++) {
+        // a single term has both ends of the ladder at the same place
+        int first = terms > 1 ? i + 1 : i,
+            last = terms > 1 ? GAUSSIAN_FIT_GRID - 1 : i;
+        for (int j = first; j <= last; j++) {
+            double a = logLow + gridStep * i, b = logLow + gridStep * j;
+            double value = residual(a, b);
+            if (value < best) {
+                best = value;
+                bestA = a;
+                bestB = b;
+            }
+        }
+    }
+    // pattern search around the best candidate, a single term only moves
+    // both ends together
+    for (double step = gridStep / 2; step > GAUSSIAN_FIT_STEP;) {
+        bool improved = false;
+        const double moves[4][2]{{step, 0}, {-step, 0}, {0, step}, {0, -step}};
+        for (const auto& move : moves) {
+            double a = bestA + move[0], b = bestB + move[1];
+            if (terms == 1)
+                b = a = bestA + move[0] + move[1];
+            double value = residual(a, b);
+            if (value < best) {
+                best = value;
+                bestA = a;
+                bestB = b;
+                improved = true;
+            }
+        }
+        if (!improved)
+            step /= 2;
+    }
+
+    BSSRDFGaussianFit result;
+    result.variances = ladder(bestA, bestB, terms);
+    problem.solve(result.variances, result.weights);
+    result.error = measureGaussianFitError(result, profile, spacing);
+    return result;
+}
+
+dvec3 BSSRDFGaussianFit::evaluate(double r) const {
+    dvec3 sum(0.0);
+    for (size_t k = 0; k < variances.size(); k++)
+        sum += weights[k] * gaussian(variances[k], r);
+    return sum;
+}
+
+BSSRDFGaussianFitError measureGaussianFitError(const BSSRDFGaussianFit& fit,
+                                               const vector<dvec3>& profile,
+                                               double spacing) {
+    const int count = profile.size();
+    dvec3 peak(0.0), energy(0.0), fitted(0.0);
+    vector<dvec3> values(count);
+    for (int i = 0; i < count; i++) {
+        double r = spacing * i;
+        values[i] = fit.evaluate(r);
+        peak = max(peak, r * profile[i]);
+        double dr = (i == 0 || i == count - 1) ? spacing / 2 : spacing;
+        energy += 2.0 * M_PI * r * dr * profile[i];
+        fitted += 2.0 * M_PI * r * dr * values[i];
+    }
+    BSSRDFGaussianFitError error;
+    double squares = 0.0;
+    for (int c = 0; c < 3; c++) {
+        if (peak[c] <= 0.0)
+            continue;
+        for (int i = 0; i < count; i++) {
+            double r = spacing * i;
+            double difference =
+                r * std::abs(values[i][c] - profile[i][c]) / peak[c];
+            error.maxError = std::max(error.maxError, difference);
+            squares += difference * difference;
+        }
+        error.energyError = std::max(
+            error.energyError, std::abs(fitted[c] - energy[c]) / energy[c]);
+    }
+    error.rmsError = sqrt(squares / (3.0 * count));
+    return error;
+}
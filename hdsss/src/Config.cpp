@@ -0,0 +1,179 @@
+#include "Config.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <string>
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+using namespace std;
+
+static glm::vec3 parseVec3(const json& j, const string& key,
+                           glm::vec3 defaultVal) {
+    if (j.contains(key)) {
+        auto& v = j[key];
+        return glm::vec3(v[0], v[1], v[2]);
+    } else {
+        return defaultVal;
+    }
+}
+
+HDSSSConfig parseJSONConfig(const char* filename, string& modelPath,
+                            string& skyboxPath) {
+    fs::path p(filename);
+    LOG(INFO) << "Loading config from " << fs::absolute(filename).string()
+              << endl;
+    HDSSSConfig config;
+    ifstream ifs(filename);
+    if (ifs.fail()) {
+        LOG(WARNING) << "Failed to open config file " << filename << endl;
+        return config;
+    }
+    json conf = json::parse(ifs);
+    if (conf.contains("camera")) {
+        auto& camera = conf["camera"];
+        config.camera.position =
+            parseVec3(camera, "position", config.camera.position);
+        config.camera.lookat =
+            parseVec3(camera, "lookat", config.camera.lookat);
+        config.camera.fov =
+            glm::radians(camera.value("fov", config.camera.fov));
+        config.camera.zNear = camera.value("znear", config.camera.zNear);
+        config.camera.zFar = camera.value("zfar", config.camera.zFar);
+    }
+    if (conf.contains("light")) {
+        auto& light = conf["light"];
+        config.light.direction =
+            parseVec3(light, "direction", config.light.direction);
+        config.light.color = parseVec3(light, "color", config.light.color);
+        config.light.intensity =
+            light.value("intensity", config.light.intensity);
+    }
+    if (conf.contains("model")) {
+        auto& model = conf["model"];
+        float scale = model.value("scale", 1.0f);
+        float rotationY = glm::radians(model.value("rotationY", 0.0f));
+        config.model.transform = glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+        config.model.transform =
+            glm::rotate(config.model.transform, rotationY, glm::vec3(0, 1, 0));
+        modelPath = model.value("path", modelPath);
+        auto& optimize = config.model.optimize;
+        if (model.contains("optimize") && model["optimize"].is_boolean()) {
+            if (!model["optimize"].get<bool>())
+                optimize = {false, false, 0.0f, false, 0};
+        } else if (model.contains("optimize")) {
+            auto& stages = model["optimize"];
+            optimize.weld = stages.value("weld", optimize.weld);
+            optimize.vertexCache =
+                stages.value("vertex_cache", optimize.vertexCache);
+            optimize.overdrawThreshold = stages.value(
+                "overdraw_threshold", optimize.overdrawThreshold);
+            optimize.vertexFetch =
+                stages.value("vertex_fetch", optimize.vertexFetch);
+            optimize.meshlets = stages.value("meshlets", optimize.meshlets);
+        }
+        if (model.contains("lod") && model["lod"].is_boolean()) {
+            if (!model["lod"].get<bool>())
+                optimize.lodLevels = 0;
+        } else if (model.contains("lod")) {
+            auto& lod = model["lod"];
+            optimize.lodLevels = lod.value("levels", optimize.lodLevels);
+            optimize.lodReduction =
+                lod.value("reduction", optimize.lodReduction);
+            optimize.lodMaxError = lod.value("max_error", optimize.lodMaxError);
+            config.model.lodPixelError =
+                lod.value("pixel_error", config.model.lodPixelError);
+        }
+        string vertexFormat = model.value("vertex_format", string("float"));
+        if (vertexFormat == "quantized") {
+            config.model.vertexFormat = loo::VertexFormat::Quantized;
+        } else if (vertexFormat != "float") {
+            LOG(WARNING) << "Unknown vertex_format " << vertexFormat
+                         << ", using float";
+        }
+    }
+    if (conf.contains("skybox")) {
+        auto& skybox = conf["skybox"];
+        skyboxPath = skybox.value("path", skyboxPath);
+    }
+    if (conf.contains("bssrdf")) {
+        auto& bssrdf = conf["bssrdf"];
+        config.bssrdf.sigma_t =
+            parseVec3(bssrdf, "sigma_t", config.bssrdf.sigma_t);
+        config.bssrdf.albedo =
+            parseVec3(bssrdf, "albedo", config.bssrdf.albedo);
+        auto& table = config.bssrdf.table;
+        int tableSize = bssrdf.value("table_size", table.tableSize);
+        if (tableSize >= 2) {
+            table.tableSize = tableSize;
+        } else {
+            LOG(WARNING) << "table_size " << tableSize
+                         << " is below 2, using " << table.tableSize;
+        }
+        int& progressive = config.bssrdf.progressiveTableSize;
+        progressive = bssrdf.value("progressive_table_size", progressive);
+        // 0 turns the coarse tables off, a smaller one can't be tabulated
+        if (progressive != 0 && progressive < 2) {
+            LOG(WARNING) << "progressive_table_size " << progressive
+                         << " is neither 0 nor at least 2, turning the "
+                            "progressive tables off";
+            progressive = 0;
+        }
+        string warp = bssrdf.value("distance_warp", string("linear"));
+        if (warp == "sqrt") {
+            table.distanceWarp = BSSRDFAxisWarp::Sqrt;
+        } else if (warp == "log") {
+            table.distanceWarp = BSSRDFAxisWarp::Log;
+        } else if (warp != "linear") {
+            LOG(WARNING) << "Unknown distance_warp " << warp
+                         << ", using linear";
+        }
+        string quadrature =
+            bssrdf.value("profile_quadrature", string("adaptive"));
+        if (quadrature == "fixed") {
+            table.profileQuadrature = BSSRDFProfileQuadrature::Fixed;
+        } else if (quadrature != "adaptive") {
+            LOG(WARNING) << "Unknown profile_quadrature " << quadrature
+                         << ", using adaptive";
+        }
+        auto& encoding = config.bssrdf.encoding;
+        string encodingType =
+            bssrdf.value("table_encoding", string("float32"));
+        if (encodingType == "half") {
+            encoding.encoding = BSSRDFTableEncoding::Half;
+        } else if (encodingType == "rgb9e5") {
+            encoding.encoding = BSSRDFTableEncoding::SharedExponent;
+        } else if (encodingType == "low_rank") {
+            encoding.encoding = BSSRDFTableEncoding::LowRank;
+        } else if (encodingType == "analytic") {
+            encoding.encoding = BSSRDFTableEncoding::Analytic;
+        } else if (encodingType != "float32") {
+            LOG(WARNING) << "Unknown table_encoding " << encodingType
+                         << ", using float32";
+        }
+        encoding.rank = std::clamp(bssrdf.value("table_rank", encoding.rank),
+                                   1, BSSRDF_LOW_RANK_MAX);
+    }
+    if (conf.contains("cache")) {
+        auto& cache = conf["cache"];
+        config.cache.directory =
+            cache.value("directory", config.cache.directory);
+        config.cache.maxSizeMB =
+            cache.value("max_size_mb", config.cache.maxSizeMB);
+        config.cache.meshDirectory =
+            cache.value("mesh_directory", config.cache.meshDirectory);
+    }
+    if (conf.contains("animation")) {
+        auto& animation = conf["animation"];
+        config.animation.cameraRotationY =
+            glm::radians(animation.value("cameraRotationY", 0.0f));
+        config.animation.modelRotationY =
+            glm::radians(animation.value("modelRotationY", 0.0f));
+    }
+    return config;
+}
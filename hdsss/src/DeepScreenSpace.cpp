@@ -292,14 +292,21 @@ void DeepScreenSpace::surfelizePass(const Scene& scene,
     glPatchParameteri(GL_PATCH_VERTICES, 3);
     glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, m_surfelizetf);
     glBeginTransformFeedback(GL_POINTS);
-    scene.draw(
+    // a surfel reaches the pixels within maxDistance, meshes farther outside
+    // of the view can't contribute
+    auto frustum = Frustum::fromMatrix(camera.getProjectionMatrix() *
+                                       camera.getViewMatrix())
+                       .inflated(options.maxDistance);
+    m_surfelizestatistics = scene.draw(
         m_surfelizeshader,
-        [&mvp, &mvpBuffer](const auto& scene, const auto& mesh) {
-            mvp.model = scene.getModelMatrix() * mesh.objectMatrix;
+        [&mvp, &mvpBuffer](const auto&, const auto&, const auto& model) {
+            mvp.model = model;
             mvpBuffer.updateData(offsetof(MVP, model), sizeof(mvp.model),
                                  &mvp.model);
         },
-        GL_FILL, DRAW_FLAG_TESSELLATION);
+        GL_FILL,
+        DRAW_FLAG_LOD | DRAW_FLAG_TESSELLATION | DRAW_FLAG_GEOMETRY_ONLY,
+        options.surfelizeLodBias, &frustum);
     glEndTransformFeedback();
     glFlush();
     glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
@@ -130,13 +130,18 @@ void HDSSS::translucencyPass(const loo::Scene& scene, MVP& mvp,
                              const loo::ShaderLight& mainLight,
                              const loo::Texture2D& GBufferPosition,
                              const loo::Texture2D& GBufferNormal,
+                             const loo::Texture2D& GBuffer5,
                              const loo::Texture2D& mainLightShadowMap) {
+    m_surfelizetimer.begin();
     surfelizePass(scene, mvp, mvpBuffer);
+    m_surfelizetimer.end();
 
     panicPossibleGLError();
 
-    splattingPass(mainLight, GBufferPosition, GBufferNormal,
+    m_splattingtimer.begin();
+    splattingPass(mainLight, GBufferPosition, GBufferNormal, GBuffer5,
                   mainLightShadowMap);
+    m_splattingtimer.end();
 }
 // fourth pass: subpass 1
 void HDSSS::surfelizePass(const Scene& scene, MVP& mvp,
@@ -151,14 +156,20 @@ void HDSSS::surfelizePass(const Scene& scene, MVP& mvp,
     glPatchParameteri(GL_PATCH_VERTICES, 3);
     glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, m_surfelizetf);
     glBeginTransformFeedback(GL_POINTS);
-    scene.draw(
+    // a surfel reaches the pixels within maxDistance, meshes farther outside
+    // of the view can't contribute
+    auto frustum = Frustum::fromMatrix(mvp.projection * mvp.view)
+                       .inflated(options.maxDistance);
+    m_surfelizestatistics = scene.draw(
         m_surfelizeshader,
-        [&mvp, &mvpBuffer](const auto& scene, const auto& mesh) {
-            mvp.model = scene.getModelMatrix() * mesh.objectMatrix;
+        [&mvp, &mvpBuffer](const auto&, const auto&, const auto& model) {
+            mvp.model = model;
             mvpBuffer.updateData(offsetof(MVP, model), sizeof(mvp.model),
                                  &mvp.model);
         },
-        GL_FILL, DRAW_FLAG_TESSELLATION);
+        GL_FILL,
+        DRAW_FLAG_LOD | DRAW_FLAG_TESSELLATION | DRAW_FLAG_GEOMETRY_ONLY,
+        options.surfelizeLodBias, &frustum);
     glEndTransformFeedback();
     glFlush();
     glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
@@ -172,6 +183,7 @@ void HDSSS::surfelizePass(const Scene& scene, MVP& mvp,
 void HDSSS::splattingPass(const loo::ShaderLight& mainLight,
                           const loo::Texture2D& GBufferPosition,
                           const loo::Texture2D& GBufferNormal,
+                          const loo::Texture2D& GBuffer5,
                           const loo::Texture2D& mainLightShadowMap) {
     auto app = static_cast<HDSSSApplication*>(Application::getContext());
     m_translucencyfb.bind();
@@ -199,12 +211,11 @@ void HDSSS::splattingPass(const loo::ShaderLight& mainLight,
         m_translucencyshader.setUniform("minimalEffect", options.minimalEffect);
         m_translucencyshader.setUniform("maxDistance", options.maxDistance);
 
-        m_translucencyshader.setUniform("RdMaxArea", rdProfile.maxArea);
-        m_translucencyshader.setUniform("RdMaxDistance", rdProfile.maxDistance);
         m_translucencyshader.setTexture(0, GBufferPosition);
         m_translucencyshader.setTexture(1, GBufferNormal);
         m_translucencyshader.setTexture(2, mainLightShadowMap);
-        m_translucencyshader.setTexture(3, *rdProfile.texture);
+        m_translucencyshader.setTexture(3, rdProfiles.getTexture());
+        m_translucencyshader.setTexture(4, GBuffer5);
         glBindVertexArray(m_surfelbuffer.vao);
         glDrawArrays(GL_POINTS, 0, getSurfelCount());
         logPossibleGLError();
@@ -227,7 +238,9 @@ void HDSSS::SSSSPass(loo::Texture2D& GBufferPosition,
                      loo::Texture2D& GBufferNormal,
                      const loo::Texture2D& GBuffer3,
                      const loo::Texture2D& GBuffer4,
+                     const loo::Texture2D& GBuffer5,
                      loo::Texture2D& transmittedIrradiance) {
+    m_sssstimer.begin();
     GBufferPosition.setSizeFilter(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     GBufferNormal.setSizeFilter(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     transmittedIrradiance.setSizeFilter(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
@@ -242,8 +255,6 @@ void HDSSS::SSSSPass(loo::Texture2D& GBufferPosition,
     m_ssssfb.bind();
     m_ssssshader.use();
     m_ssssshader.setUniform("pixelAreaScale", options.ssssPixelAreaScale);
-    m_ssssshader.setUniform("RdMaxArea", rdProfile.maxArea);
-    m_ssssshader.setUniform("RdMaxDistance", rdProfile.maxDistance);
     m_ssssshader.setUniform("samplingMarkerEnable", options.ssssSamplingMarker);
     m_ssssshader.setUniform("samplingMarkerCenter",
                             options.ssssSamplingMarkerCenter);
@@ -254,8 +265,10 @@ void HDSSS::SSSSPass(loo::Texture2D& GBufferPosition,
     m_ssssshader.setTexture(3, GBuffer4);
     m_ssssshader.setTexture(4, transmittedIrradiance);
 
-    m_ssssshader.setTexture(5, *rdProfile.texture);
+    m_ssssshader.setTexture(5, rdProfiles.getTexture());
+    m_ssssshader.setTexture(6, GBuffer5);
 
     Quad::globalQuad().draw();
     m_ssssfb.unbind();
+    m_sssstimer.end();
 }
\ No newline at end of file
@@ -3,12 +3,16 @@
 #include <GLFW/glfw3.h>
 #include <imgui.h>
 
+#include <algorithm>
+#include <chrono>
 #include <ctime>
 #include <filesystem>
 #include <fstream>
 #include <locale>
+#include <loo/Parallel.hpp>
 #include <loo/glError.hpp>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
@@ -94,10 +98,11 @@ static void scrollCallback(GLFWwindow* window, double xOffset, double yOffset) {
 void HDSSSApplication::loadModel(const std::string& filename,
                                  glm::mat4 transform) {
     LOG(INFO) << "Loading model from " << filename << endl;
-    auto meshes = createMeshFromFile(filename, transform);
+    auto meshes = createMeshFromFile(filename, transform, m_meshoptimize,
+                                     m_meshcachedirectory);
     m_scene.addMeshes(std::move(meshes));
 
-    m_scene.prepare();
+    m_scene.prepare(m_vertexformat);
     LOG(INFO) << "Load done" << endl;
 }
 
@@ -105,10 +110,11 @@ void HDSSSApplication::loadGLTF(const std::string& filename,
                                 glm::mat4 transform) {
     LOG(INFO) << "Loading scene from " << filename << endl;
     // TODO: m_scene = createSceneFromFile(filename);
-    auto meshes = createMeshFromFile(filename, transform);
+    auto meshes = createMeshFromFile(filename, transform, m_meshoptimize,
+                                     m_meshcachedirectory);
     m_scene.addMeshes(std::move(meshes));
 
-    m_scene.prepare();
+    m_scene.prepare(m_vertexformat);
     LOG(INFO) << "Load done" << endl;
 }
 
@@ -131,7 +137,15 @@ HDSSSApplication::HDSSSApplication(int width, int height,
       m_deferredshader{Shader(DEFERRED_VERT, ShaderType::Vertex),
                        Shader(DEFERRED_FRAG, ShaderType::Fragment)},
 
-      m_finalprocess(getWidth(), getHeight()) {
+      m_finalprocess(getWidth(), getHeight()),
+      m_meshoptimize(config.model.optimize),
+      m_meshcachedirectory(config.cache.meshDirectory),
+      m_vertexformat(config.model.vertexFormat),
+      m_lodpixelerror(config.model.lodPixelError),
+      m_bssrdfcache(config.cache.directory,
+                    config.cache.maxSizeMB * 1024 * 1024),
+      m_tableoptions(config.bssrdf.table),
+      m_progressivetablesize(config.bssrdf.progressiveTableSize) {
     if (skyBoxPrefix) {
         // skybox setup
         auto skyboxFilenames = TextureCubeMap::builder()
@@ -158,7 +172,9 @@ HDSSSApplication::HDSSSApplication(int width, int height,
     initShadowMap();
     initDeferredPass();
     m_hdsss.init();
+    m_hdsss.rdProfiles.setEncoding(config.bssrdf.encoding);
     m_dss.init();
+    m_separablesss.init();
 
     // final pass related
     { m_finalprocess.init(); }
@@ -303,20 +319,48 @@ void HDSSSApplication::gui() {
                 const GLubyte* version = glGetString(GL_VERSION);
                 ImGui::TextWrapped("Renderer: %s", renderer);
                 ImGui::TextWrapped("OpenGL Version: %s", version);
-                int triangleCount = m_scene.countTriangle();
-                const char* base = "";
-                if (triangleCount > 5000) {
-                    triangleCount /= 1000;
-                    base = "k";
-                }
-                if (triangleCount > 5000) {
-                    triangleCount /= 1000;
-                    base = "M";
-                }
+                auto abbreviate = [](size_t count, const char*& base) {
+                    base = "";
+                    if (count > 5000) {
+                        count /= 1000;
+                        base = "k";
+                    }
+                    if (count > 5000) {
+                        count /= 1000;
+                        base = "M";
+                    }
+                    return int(count);
+                };
+                // all meshes at their full level and as last drawn
+                const char *base, *drawnBase;
+                int triangleCount = abbreviate(m_scene.countTriangle(), base);
+                int drawnCount =
+                    abbreviate(m_gbufferstatistics.triangles, drawnBase);
                 ImGui::Text(
-                    "Scene meshes: %d\n"
-                    "Scene triangles: %d%s",
-                    (int)m_scene.countMesh(), triangleCount, base);
+                    "Scene meshes: %d, materials: %d\n"
+                    "Scene triangles: %d%s\n"
+                    "G-buffer triangles: %d%s",
+                    (int)m_scene.countMesh(), (int)m_scene.countMaterial(),
+                    triangleCount, base, drawnCount, drawnBase);
+                // meshes(and meshlets) drawn / skipped by the frustum of
+                // every pass
+                auto culling = [](const char* pass,
+                                  const DrawStatistics& statistics) {
+                    ImGui::Text("%s: %d visible, %d culled, %d draw calls",
+                                pass, int(statistics.visible),
+                                int(statistics.culled),
+                                int(statistics.drawCalls));
+                    if (statistics.meshletsVisible + statistics.meshletsCulled)
+                        ImGui::Text("  meshlets: %d visible, %d culled",
+                                    int(statistics.meshletsVisible),
+                                    int(statistics.meshletsCulled));
+                };
+                culling("G-buffer", m_gbufferstatistics);
+                culling("Shadow map", m_shadowstatistics);
+                if (m_method == SubsurfaceMethod::HDSSS)
+                    culling("Surfelize", m_hdsss.getSurfelizeStatistics());
+                else if (m_method == SubsurfaceMethod::DSS)
+                    culling("Surfelize", m_dss.getSurfelizeStatistics());
                 ImGui::TextWrapped("Camera position: %.2f %.2f %.2f",
                                    m_maincam.getPosition().x,
                                    m_maincam.getPosition().y,
@@ -336,6 +380,22 @@ void HDSSSApplication::gui() {
                         postfix = "M";
                     }
                     ImGui::Text("Surfel count: %d%s", nSurfel, postfix.c_str());
+                    const auto& rdProfiles = m_hdsss.rdProfiles;
+                    if (!rdProfiles.empty()) {
+                        ImGui::Text(
+                            "Rd profiles: %d layers, %.2f MB %s",
+                            rdProfiles.getLayerCount(),
+                            rdProfiles.getMemorySize() / (1024.0 * 1024.0),
+                            encodingName(rdProfiles.getEncoding().encoding));
+                    }
+                    auto timings = m_hdsss.getTimings();
+                    ImGui::Text("Surfelize: %.3f ms", timings.surfelize);
+                    ImGui::Text("Splatting: %.3f ms", timings.splatting);
+                    ImGui::Text("SSSS: %.3f ms", timings.ssss);
+                    if (!m_rdrefinementlayers.empty()) {
+                        ImGui::Text("Refining %d coarse Rd profiles...",
+                                    int(m_rdrefinementlayers.size()));
+                    }
                 }
             } else if (m_method == SubsurfaceMethod::DSS) {
                 if (ImGui::CollapsingHeader("Deep Screen Space info",
@@ -352,6 +412,17 @@ void HDSSSApplication::gui() {
                     }
                     ImGui::Text("Surfel count: %d%s", nSurfel, postfix.c_str());
                 }
+            } else if (m_method == SubsurfaceMethod::Separable) {
+                if (ImGui::CollapsingHeader("Separable SSS info",
+                                            ImGuiTreeNodeFlags_DefaultOpen)) {
+                    const auto& fits = m_separablesss.getFits();
+                    for (size_t i = 0; i < fits.size(); i++) {
+                        ImGui::Text(
+                            "Layer %d: %d gaussians, rms %.2e, energy %.1f%%",
+                            int(i), fits[i].terms(), fits[i].error.rmsError,
+                            fits[i].error.energyError * 100.0);
+                    }
+                }
             }
         }
     }
@@ -378,20 +449,32 @@ void HDSSSApplication::gui() {
                 ImGui::Checkbox("Normal mapping", &m_enablenormal);
                 ImGui::Checkbox("Parallax mapping", &m_enableparallax);
                 ImGui::Checkbox("Visualize lod", &m_lodvisualize);
+                ImGui::SliderFloat("Lod pixel error", &m_lodpixelerror, 0.0f,
+                                   16.0f, "%.1f");
+                ImGui::Checkbox("Frustum culling", &m_frustumculling);
+                ImGui::Checkbox("Meshlet cone culling(closed meshes)",
+                                &m_coneculling);
+                ImGui::Checkbox("Indirect draws", &m_indirectdraw);
                 if (ImGui::Button("Save screenshot")) {
                     m_screenshotflag = true;
                 }
                 ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.5f);
-                if (ImGui::BeginCombo("Subsurface Method",
-                                      m_method == SubsurfaceMethod::HDSSS
-                                          ? "High Distance SS"
-                                          : "Deep Screen Space")) {
+                const char* methodName = "High Distance SS";
+                if (m_method == SubsurfaceMethod::DSS)
+                    methodName = "Deep Screen Space";
+                else if (m_method == SubsurfaceMethod::Separable)
+                    methodName = "Separable SSS";
+                if (ImGui::BeginCombo("Subsurface Method", methodName)) {
                     if (ImGui::Selectable("High Distance SS",
                                           m_method == SubsurfaceMethod::HDSSS))
                         m_method = SubsurfaceMethod::HDSSS;
                     if (ImGui::Selectable("Deep Screen Space",
                                           m_method == SubsurfaceMethod::DSS))
                         m_method = SubsurfaceMethod::DSS;
+                    if (ImGui::Selectable(
+                            "Separable SSS",
+                            m_method == SubsurfaceMethod::Separable))
+                        m_method = SubsurfaceMethod::Separable;
                     ImGui::EndCombo();
                 }
             }
@@ -400,6 +483,9 @@ void HDSSSApplication::gui() {
                                             ImGuiTreeNodeFlags_DefaultOpen)) {
                     ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.45f);
                     auto& options = m_hdsss.options;
+                    ImGui::SliderFloat("Surfelize lod bias",
+                                       &options.surfelizeLodBias, 0.0f, 8.0f,
+                                       "%.1f");
                     ImGui::SliderFloat("Splatting strength",
                                        &options.splattingStrength, 1.0f, 1e2f,
                                        "%.1f", ImGuiSliderFlags_Logarithmic);
@@ -409,6 +495,28 @@ void HDSSSApplication::gui() {
                     ImGui::SliderFloat("Splatting maxDistance",
                                        &options.maxDistance, 0.0001, 5.0,
                                        "%.4f", ImGuiSliderFlags_Logarithmic);
+                    // switching the encoding live compares the pass timings
+                    auto encoding = m_hdsss.rdProfiles.getEncoding();
+                    if (ImGui::BeginCombo("Rd encoding",
+                                          encodingName(encoding.encoding))) {
+                        for (auto candidate :
+                             {BSSRDFTableEncoding::Float32,
+                              BSSRDFTableEncoding::Half,
+                              BSSRDFTableEncoding::SharedExponent,
+                              BSSRDFTableEncoding::LowRank,
+                              BSSRDFTableEncoding::Analytic}) {
+                            if (ImGui::Selectable(
+                                    encodingName(candidate),
+                                    encoding.encoding == candidate) &&
+                                encoding.encoding != candidate &&
+                                !m_rdtables.empty()) {
+                                encoding.encoding = candidate;
+                                m_hdsss.rdProfiles.setEncoding(encoding);
+                                m_hdsss.rdProfiles.build(m_rdtables);
+                            }
+                        }
+                        ImGui::EndCombo();
+                    }
 
                     ImGui::Checkbox("SSSS marker", &options.ssssSamplingMarker);
                     options.ssssSamplingMarkerCenter.x = io.MousePos.x;
@@ -443,6 +551,9 @@ void HDSSSApplication::gui() {
                     ImGui::SliderFloat("Surfel scale", &options.surfelScale,
                                        1e-4, 1.5f, "%.4f",
                                        ImGuiSliderFlags_Logarithmic);
+                    ImGui::SliderFloat("Surfelize lod bias",
+                                       &options.surfelizeLodBias, 0.0f, 8.0f,
+                                       "%.1f");
                     ImGui::SliderFloat("Splatting strength",
                                        &options.splattingStrength, 1.0f, 1e2f,
                                        "%.1f", ImGuiSliderFlags_Logarithmic);
@@ -462,6 +573,34 @@ void HDSSSApplication::gui() {
                     ImGui::Checkbox("Use DSS texture",
                                     &m_finalpassoptions.translucency);
 
+                    ImGui::PopItemWidth();
+                }
+            } else if (m_method == SubsurfaceMethod::Separable) {
+                if (ImGui::CollapsingHeader("Separable SSS options",
+                                            ImGuiTreeNodeFlags_DefaultOpen)) {
+                    ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.45f);
+                    auto& options = m_separablesss.options;
+                    // refitting only samples the profiles, no tabulation
+                    if (ImGui::SliderInt("Gaussians", &options.terms, 1,
+                                         BSSRDF_GAUSSIAN_TERMS_MAX) &&
+                        !m_rdtables.empty()) {
+                        m_separablesss.setProfiles(m_rdtables);
+                    }
+                    ImGui::SliderFloat("Depth falloff", &options.depthFalloff,
+                                       0.1f, 10.0f, "%.2f",
+                                       ImGuiSliderFlags_Logarithmic);
+
+                    ImGui::TextWrapped(
+                        "Below fields only effect materials with SSS masks");
+                    ImGui::Checkbox("Use diffuse texture",
+                                    &m_finalpassoptions.diffuse);
+                    ImGui::Checkbox("Use specular texture",
+                                    &m_finalpassoptions.specular);
+                    ImGui::Checkbox("Use SSS texture", &m_finalpassoptions.SSS);
+                    ImGui::SliderFloat("SSS strength",
+                                       &m_finalpassoptions.SSSStrength, 0.0,
+                                       4.0);
+
                     ImGui::PopItemWidth();
                 }
             }
@@ -477,6 +616,10 @@ void HDSSSApplication::gui() {
                         m_transmitted_irradiance->getId(),
                         m_hdsss.getSSSSResult().getId(),
                         m_hdsss.getUpscaleResult().getId()};
+        } else if (m_method == SubsurfaceMethod::Separable) {
+            textures = {m_gbuffers.normal->getId(),
+                        m_transmitted_irradiance->getId(),
+                        m_separablesss.getResult().getId()};
         } else {
             textures = {m_dss.getPartitionedNormal().getId(),
                         m_dss.getSplattingResult().getId(),
@@ -502,6 +645,11 @@ void HDSSSApplication::finalScreenPass() {
                               m_hdsss.getUpscaleResult(),
                               m_hdsss.getSSSSResult(), *m_gbuffers.buffer3,
                               *m_skyboxresult, m_finalpassoptions);
+    else if (m_method == SubsurfaceMethod::Separable)
+        m_finalprocess.render(*m_diffuseresult, *m_reflected_radiance,
+                              Texture2D::getBlackTexture(),
+                              m_separablesss.getResult(), *m_gbuffers.buffer3,
+                              *m_skyboxresult, m_finalpassoptions);
     else
         m_finalprocess.render(*m_diffuseresult, *m_reflected_radiance,
                               m_dss.getSumUpResult(),
@@ -510,85 +658,144 @@ void HDSSSApplication::finalScreenPass() {
 }
 
 void HDSSSApplication::convertMaterial() {
+    // subsurface materials with equal scattering parameters share a layer
+    vector<BSSRDFParams> profiles;
+    auto assignLayer = [&profiles](PBRMetallicMaterial& material) {
+        material.getShaderMaterial().rdProfileLayer = assignRdProfileLayer(
+            profiles, BSSRDFParams::fromMaterial(material));
+    };
+    // meshes sharing a material keep sharing the converted one, indirect
+    // draws group them by it
+    unordered_map<const Material*, shared_ptr<Material>> converted;
     for (auto& mesh : m_scene.getMeshes()) {
         // Now default material is PBR material
-        if (mesh->material) {
+        if (!mesh->material)
+            continue;
+        auto& material = converted[mesh->material.get()];
+        if (!material) {
 #ifdef MATERIAL_PBR
-            LOG(INFO) << "Converting material to PBR material";
             auto pbrMaterial = convertPBRMetallicMaterialFromBaseMaterial(
                 *static_pointer_cast<BaseMaterial>(mesh->material));
-            if (pbrMaterial->getShaderMaterial().sigmaARoughness.r != 0.0f) {
-
-                BSSRDFTabulator tabulator;
-                auto shaderMaterial = pbrMaterial->getShaderMaterial();
-                vec3 sigmaA(shaderMaterial.sigmaARoughness.r,
-                            shaderMaterial.sigmaARoughness.g,
-                            shaderMaterial.sigmaARoughness.b),
-                    sigmaT(shaderMaterial.transmissionSigmaT.g,
-                           shaderMaterial.transmissionSigmaT.b,
-                           shaderMaterial.transmissionSigmaT.a);
-                auto vec3Hash = std::hash<vec3>();
-                fs::path savedTablet = to_string(vec3Hash(sigmaA)) + "_" +
-                                       to_string(vec3Hash(sigmaT)) +
-                                       "_tabulated.txt";
-                if (fs::exists(savedTablet)) {
-                    LOG(INFO) << "Loading tabulated data from " << savedTablet;
-                    tabulator.read(savedTablet.string());
-                } else {
-                    tabulator.tabulate(
-                        *static_pointer_cast<PBRMetallicMaterial>(pbrMaterial));
-                    tabulator.save(savedTablet.string());
-                }
-                auto& rdprofile = m_hdsss.rdProfile;
-                rdprofile.texture = tabulator.generateTexture();
-                rdprofile.maxArea = tabulator.maxArea;
-                rdprofile.maxDistance = tabulator.maxDistance;
-                LOG(INFO) << "Precompute table max area: " << rdprofile.maxArea
-                          << " max distance: " << rdprofile.maxDistance;
+            if (isSubsurface(pbrMaterial->getShaderMaterial())) {
+                assignLayer(*pbrMaterial);
             }
-            mesh->material = pbrMaterial;
+            material = pbrMaterial;
 #else
-            LOG(INFO) << "Converting material to simple(blinn-phong) material";
-            mesh->material = convertSimpleMaterialFromBaseMaterial(
+            material = convertSimpleMaterialFromBaseMaterial(
                 *static_pointer_cast<BaseMaterial>(mesh->material));
 #endif
         }
+        mesh->material = material;
     }
-    auto& rdprofile = m_hdsss.rdProfile;
-    if (!rdprofile.texture) {
+#ifdef MATERIAL_PBR
+    LOG(INFO) << "Converted " << converted.size()
+              << " materials to PBR materials for " << m_scene.countMesh()
+              << " meshes";
+#else
+    LOG(INFO) << "Converted " << converted.size()
+              << " materials to simple(blinn-phong) materials for "
+              << m_scene.countMesh() << " meshes";
+#endif
+    if (profiles.empty()) {
         LOG(WARNING) << "No material found, use default "
                         "subsurface material instead";
         // no material exists, use default BSSRDF material
-        BSSRDFTabulator tabulator;
         CHECK_GT(m_scene.getMeshes().size(), 0);
         auto& mesh = m_scene.getMeshes()[0];
         mesh->material = PBRMetallicMaterial::getDefaultSubsurface();
-        auto pbrMaterial = mesh->material;
-        auto shaderMaterial =
-            PBRMetallicMaterial::getDefaultSubsurface()->getShaderMaterial();
-        vec3 sigmaA(shaderMaterial.sigmaARoughness.r,
-                    shaderMaterial.sigmaARoughness.g,
-                    shaderMaterial.sigmaARoughness.b),
-            sigmaT(shaderMaterial.transmissionSigmaT.g,
-                   shaderMaterial.transmissionSigmaT.b,
-                   shaderMaterial.transmissionSigmaT.a);
+        assignLayer(*PBRMetallicMaterial::getDefaultSubsurface());
+    }
+    loadRdProfiles(profiles);
+}
+
+void HDSSSApplication::loadRdProfiles(const vector<BSSRDFParams>& profiles) {
+    // tables from older builds were stored in the working directory under a
+    // std::hash name. They are imported once into the cache, but only help
+    // when the current options are the ones they were tabulated with
+    bool importLegacy =
+        BSSRDFTabulator::textTableOptions(m_tableoptions) == m_tableoptions;
+    for (const auto& params : profiles) {
+        BSSRDFTabulator tabulator(m_tableoptions);
+        if (!importLegacy || m_bssrdfcache.load(params, tabulator))
+            continue;
+        vec3 sigmaA(params.sigmaA), sigmaT(params.sigmaT);
         auto vec3Hash = std::hash<vec3>();
-        fs::path savedTablet = to_string(vec3Hash(sigmaA)) + "_" +
-                               to_string(vec3Hash(sigmaT)) + "_tabulated.txt";
-        if (fs::exists(savedTablet)) {
-            LOG(INFO) << "Loading tabulated data from " << savedTablet;
-            tabulator.read(savedTablet.string());
-        } else {
-            tabulator.tabulate(*PBRMetallicMaterial::getDefaultSubsurface());
-            tabulator.save(savedTablet.string());
+        fs::path legacyTablet = to_string(vec3Hash(sigmaA)) + "_" +
+                                to_string(vec3Hash(sigmaT)) + "_tabulated.txt";
+        if (fs::exists(legacyTablet) &&
+            tabulator.read(legacyTablet.string())) {
+            LOG(INFO) << "Imported tabulated data from " << legacyTablet;
+            // the text format carries no parameters
+            tabulator.params = params;
+            m_bssrdfcache.store(tabulator);
+        }
+    }
+    // a refinement still running belongs to the previous scene
+    if (m_rdrefinement.valid())
+        m_rdrefinement.wait();
+    m_rdrefinement = {};
+    m_rdrefinementlayers.clear();
+
+    if (m_progressivetablesize <= 0 ||
+        m_progressivetablesize >= m_tableoptions.tableSize) {
+        // a single job tabulates whatever is still missing
+        m_rdtables = m_bssrdfcache.fetch(profiles, m_tableoptions);
+    } else {
+        m_rdtables.assign(profiles.size(), BSSRDFTabulator(m_tableoptions));
+        vector<BSSRDFParams> misses;
+        for (size_t i = 0; i < profiles.size(); i++) {
+            if (m_bssrdfcache.load(profiles[i], m_rdtables[i]))
+                continue;
+            // a coarse table takes milliseconds, upsampled it keeps the
+            // atlas layers at a single resolution
+            BSSRDFTabulateOptions coarseOptions = m_tableoptions;
+            coarseOptions.tableSize = m_progressivetablesize;
+            BSSRDFTabulator coarse(coarseOptions);
+            coarse.tabulate(profiles[i]);
+            m_rdtables[i] = coarse.resampled(m_tableoptions.tableSize);
+            m_rdrefinementlayers.push_back(i);
+            misses.push_back(profiles[i]);
+        }
+        if (!misses.empty()) {
+            LOG(INFO) << "Showing " << misses.size() << " coarse "
+                      << m_progressivetablesize << "x"
+                      << m_progressivetablesize
+                      << " Rd profiles while refining in the background";
+            // leave a core to the render thread, the job only touches its
+            // own copies and the cache directory, never GL
+            unsigned int nThreads =
+                std::max(1u, loo::defaultThreadCount() - 1);
+            m_rdrefinement = std::async(
+                std::launch::async,
+                [cache = m_bssrdfcache, options = m_tableoptions,
+                 misses = std::move(misses), nThreads]() {
+                    return cache.fetch(misses, options, nThreads);
+                });
         }
-        auto& rdprofile = m_hdsss.rdProfile;
-        rdprofile.texture = tabulator.generateTexture();
-        rdprofile.maxArea = tabulator.maxArea;
-        rdprofile.maxDistance = tabulator.maxDistance;
-        LOG(INFO) << "Precompute table max area: " << rdprofile.maxArea
-                  << " max distance: " << rdprofile.maxDistance;
     }
+    for (size_t i = 0; i < m_rdtables.size(); i++) {
+        LOG(INFO) << "Rd profile layer " << i
+                  << " max area: " << m_rdtables[i].maxArea
+                  << " max distance: " << m_rdtables[i].maxDistance;
+    }
+    m_hdsss.rdProfiles.build(m_rdtables);
+    m_separablesss.setProfiles(m_rdtables);
+}
+
+void HDSSSApplication::swapRefinedRdProfiles() {
+    if (!m_rdrefinement.valid() ||
+        m_rdrefinement.wait_for(chrono::seconds(0)) != future_status::ready)
+        return;
+    auto refined = m_rdrefinement.get();
+    for (size_t i = 0; i < refined.size(); i++) {
+        m_rdtables[m_rdrefinementlayers[i]] = std::move(refined[i]);
+    }
+    LOG(INFO) << "Swapping in " << refined.size()
+              << " refined Rd profiles";
+    m_rdrefinementlayers.clear();
+    // no pass holds on to the atlas between frames
+    m_hdsss.rdProfiles.build(m_rdtables);
+    m_separablesss.setProfiles(m_rdtables);
 }
 
 void HDSSSApplication::skyboxPass() {
@@ -598,8 +805,10 @@ void HDSSSApplication::skyboxPass() {
     glm::mat4 view;
     m_maincam.getViewMatrix(view);
     m_skyboxshader.use();
-    m_mvp.view = glm::mat4(glm::mat3(view));
-    m_mvpbuffer.updateData(0, sizeof(MVP), &m_mvp);
+    // a copy, the later passes cull against the camera view in m_mvp
+    MVP skyboxMvp = m_mvp;
+    skyboxMvp.view = glm::mat4(glm::mat3(view));
+    m_mvpbuffer.updateData(0, sizeof(MVP), &skyboxMvp);
     m_skyboxshader.setTexture(
         SHADER_BINDING_PORT_SKYBOX,
         m_skyboxtex ? *m_skyboxtex : TextureCubeMap::getBlackTexture());
@@ -613,7 +822,7 @@ void HDSSSApplication::gbufferPass() {
 
     m_gbufferfb.enableAttachments({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
                                    GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3,
-                                   GL_COLOR_ATTACHMENT4});
+                                   GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5});
 
     clear();
 
@@ -639,14 +848,18 @@ void HDSSSApplication::shadowMapPass() {
 
     m_shadowmapshader.setUniform("lightSpaceMatrix", lightSpaceMatrix);
 
-    m_scene.draw(
+    auto frustum = Frustum::fromMatrix(lightSpaceMatrix);
+    m_shadowstatistics = m_scene.draw(
         m_shadowmapshader,
-        [this](const auto& scene, const auto& mesh) {
-            m_mvp.model = scene.getModelMatrix() * mesh.objectMatrix;
+        [this](const auto&, const auto&, const auto& model) {
+            m_mvp.model = model;
             m_mvpbuffer.updateData(offsetof(MVP, model), sizeof(m_mvp.model),
                                    &m_mvp.model);
         },
-        GL_FILL, 0);
+        GL_FILL,
+        DRAW_FLAG_LOD | DRAW_FLAG_GEOMETRY_ONLY |
+            (m_coneculling ? DRAW_FLAG_CONE_CULLING : 0),
+        0.0f, &frustum);
 
     m_mainlightshadowmapfb.unbind();
     glViewport(vp[0], vp[1], vp[2], vp[3]);
@@ -708,14 +921,25 @@ void HDSSSApplication::scene() {
     m_baseshader.setUniform("enableLodVisualize", (int)m_lodvisualize);
     logPossibleGLError();
 
-    m_scene.draw(
+    // indirect draws never call beforeDraw, the camera goes up once
+    m_mvp.model = m_scene.getModelMatrix();
+    m_mvp.normalMatrix = glm::transpose(glm::inverse(m_mvp.model));
+    m_mvpbuffer.updateData(0, sizeof(MVP), &m_mvp);
+    auto frustum = Frustum::fromMatrix(m_mvp.projection * m_mvp.view);
+    m_gbufferstatistics = m_scene.draw(
         m_baseshader,
-        [this](const auto& scene, const auto& mesh) {
-            m_mvp.model = scene.getModelMatrix() * mesh.objectMatrix;
+        [this](const auto&, const auto&, const auto& model) {
+            m_mvp.model = model;
             m_mvp.normalMatrix = glm::transpose(glm::inverse(m_mvp.model));
-            m_mvpbuffer.updateData(0, sizeof(MVP), &m_mvp);
+            m_mvpbuffer.updateData(offsetof(MVP, model), sizeof(m_mvp.model),
+                                   &m_mvp.model);
+            m_mvpbuffer.updateData(offsetof(MVP, normalMatrix),
+                                   sizeof(m_mvp.normalMatrix),
+                                   &m_mvp.normalMatrix);
         },
-        m_wireframe ? GL_LINE : GL_FILL, 0);
+        m_wireframe ? GL_LINE : GL_FILL,
+        DRAW_FLAG_LOD | (m_coneculling ? DRAW_FLAG_CONE_CULLING : 0), 0.0f,
+        &frustum);
     logPossibleGLError();
 }
 
@@ -751,17 +975,22 @@ void HDSSSApplication::mouse() {
     glfwSetScrollCallback(getWindow(), scrollCallback);
 }
 void HDSSSApplication::loop() {
+    swapRefinedRdProfiles();
     m_maincam.m_aspect = getWindowRatio();
     // render
     glEnable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE);
 
     if (m_modelrotationy != 0) {
+        float angle =
+            glm::radians(m_modelrotationy) * getFrameDeltaTime() * 1000.0f;
         for (auto& mesh : m_scene.getMeshes()) {
-            mesh->objectMatrix = glm::rotate(
-                mesh->objectMatrix,
-                glm::radians(m_modelrotationy) * getFrameDeltaTime() * 1000.0f,
-                vec3(0, 1, 0));
+            // every copy turns around its own origin
+            if (mesh->instances.empty())
+                mesh->objectMatrix =
+                    glm::rotate(mesh->objectMatrix, angle, vec3(0, 1, 0));
+            for (auto& instance : mesh->instances)
+                instance = glm::rotate(instance, angle, vec3(0, 1, 0));
         }
     }
     if (m_camerarotationy != 0) {
@@ -776,6 +1005,12 @@ void HDSSSApplication::loop() {
     }
 
     {
+        // the passes share the levels of detail picked for the camera
+        m_scene.setLodScreenError(m_lodpixelerror / float(getHeight()));
+        m_scene.setFrustumCulling(m_frustumculling);
+        m_scene.setIndirectDraw(m_indirectdraw);
+        m_scene.updateLod(m_maincam.getViewMatrix(),
+                          m_maincam.getProjectionMatrix());
         gbufferPass();
 
         shadowMapPass();
@@ -784,13 +1019,14 @@ void HDSSSApplication::loop() {
         if (m_method == SubsurfaceMethod::HDSSS) {
             m_hdsss.translucencyPass(m_scene, m_mvp, m_mvpbuffer, m_lights[0],
                                      *m_gbuffers.position, *m_gbuffers.normal,
+                                     *m_gbuffers.buffer5,
                                      *m_mainlightshadowmap);
 
             m_hdsss.upscaleTranslucencyPass();
 
             m_hdsss.SSSSPass(*m_gbuffers.position, *m_gbuffers.normal,
                              *m_gbuffers.buffer3, *m_gbuffers.buffer4,
-                             *m_transmitted_irradiance);
+                             *m_gbuffers.buffer5, *m_transmitted_irradiance);
         } else if (m_method == SubsurfaceMethod::DSS) {
             m_dss.shufflePartitionPass(*m_gbuffers.position,
                                        *m_gbuffers.normal);
@@ -799,6 +1035,11 @@ void HDSSSApplication::loop() {
             m_dss.unshufflePartitionPass();
             m_dss.blurPass();
             m_dss.sumUpPass();
+        } else if (m_method == SubsurfaceMethod::Separable) {
+            m_separablesss.blurPass(m_maincam, *m_gbuffers.position,
+                                    *m_gbuffers.normal, *m_gbuffers.buffer3,
+                                    *m_gbuffers.buffer5,
+                                    *m_transmitted_irradiance);
         }
 
         finalScreenPass();
@@ -0,0 +1,129 @@
+#include "PBDProfileKernel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "BSSRDF.hpp"
+using namespace std;
+using namespace glm;
+
+namespace {
+
+// 7-point Gauss and 15-point Kronrod rule on [-1, 1], the odd Kronrod nodes
+// are the Gauss ones, so every panel costs 15 evaluations and yields both
+constexpr double KRONROD_NODES[8] = {
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0.0};
+constexpr double KRONROD_WEIGHTS[8] = {
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+constexpr double GAUSS_WEIGHTS[4] = {
+    0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+constexpr int PANEL_SAMPLES = 15;
+
+// panels one log t interval is split into before refining
+constexpr int INITIAL_PANELS = 4;
+// refinement stops here even if the error target is not met
+constexpr int MAX_PANELS = 256;
+// the integrand carries exp(-sigma_t * t), the tail beyond this many mean
+// free paths is below 1e-17
+constexpr double TAIL_MEAN_FREE_PATHS = 40.0;
+// below this fraction of the smaller of r and the mean free path the
+// integrand grows linearly in t and its integral is negligible
+constexpr double HEAD_FRACTION = 1e-6;
+
+struct Panel {
+    double a, b, value, error;
+};
+
+// C_phi * S_phi + C_E * S_E of the scalar PBDProfile at depth t
+double integrand(const pbd::ProfileConstants& c, int i, double r, double t) {
+    double Q = c.alpha[i] * c.sigmaT[i] * exp(-c.sigmaT[i] * t);
+    return diffusion::pbdResponse(r * r, t, c.sigmaT[i], c.sigmaTr[i],
+                                  c.alpha[i], c.Dg[i], c.zb[i], c.Cphi, c.CE) *
+           Q;
+}
+
+// G7-K15 over [a, b] in s = log t, |K - G| bounds the error of the Kronrod
+// result(it is the error of the Gauss one)
+template <typename F>
+Panel integratePanel(const F& f, double a, double b) {
+    double center = 0.5 * (a + b), halfWidth = 0.5 * (b - a);
+    double fCenter = f(center);
+    double kronrod = KRONROD_WEIGHTS[7] * fCenter;
+    double gauss = GAUSS_WEIGHTS[3] * fCenter;
+    for (int j = 0; j < 7; j++) {
+        double dx = halfWidth * KRONROD_NODES[j];
+        double sum = f(center - dx) + f(center + dx);
+        kronrod += KRONROD_WEIGHTS[j] * sum;
+        if (j % 2 == 1)
+            gauss += GAUSS_WEIGHTS[j / 2] * sum;
+    }
+    return {a, b, kronrod * halfWidth, std::abs(kronrod - gauss) * halfWidth};
+}
+
+// globally adaptive: the panel with the largest error estimate is bisected
+// until the summed estimate drops below relativeError of the integral
+double integrateChannel(const pbd::ProfileConstants& c, int i, double r,
+                        double relativeError, int& samples) {
+    double rClamped = std::max(r, 1e-6);
+    double meanFreePath = 1.0 / c.sigmaT[i];
+    double sMin = log(HEAD_FRACTION * std::min(rClamped, meanFreePath));
+    double sMax = log(TAIL_MEAN_FREE_PATHS * meanFreePath);
+    // dt = t ds flattens the 1/t falloff between r and the mean free path
+    auto f = [&](double s) {
+        double t = exp(s);
+        return integrand(c, i, rClamped, t) * t;
+    };
+    vector<Panel> panels;
+    panels.reserve(MAX_PANELS);
+    double width = (sMax - sMin) / INITIAL_PANELS;
+    for (int k = 0; k < INITIAL_PANELS; k++) {
+        panels.push_back(
+            integratePanel(f, sMin + k * width, sMin + (k + 1) * width));
+    }
+    auto worst = [](const Panel& p0, const Panel& p1) {
+        return p0.error < p1.error;
+    };
+    while (int(panels.size()) < MAX_PANELS) {
+        double value = 0.0, error = 0.0;
+        for (const auto& p : panels) {
+            value += p.value;
+            error += p.error;
+        }
+        if (error <= relativeError * std::abs(value))
+            break;
+        auto it = max_element(panels.begin(), panels.end(), worst);
+        Panel p = *it;
+        double mid = 0.5 * (p.a + p.b);
+        *it = integratePanel(f, p.a, mid);
+        panels.push_back(integratePanel(f, mid, p.b));
+    }
+    samples += PANEL_SAMPLES * (2 * int(panels.size()) - INITIAL_PANELS);
+    double value = 0.0;
+    for (const auto& p : panels) {
+        value += p.value;
+    }
+    return value;
+}
+
+}  // namespace
+
+dvec3 PBDProfileAdaptive(dvec3 sigma_a, dvec3 sigma_t, double eta, double r,
+                         double relativeError, int* samples) {
+    auto c = pbd::profileConstants(sigma_a, sigma_t, eta);
+    int count = 0;
+    dvec3 result;
+    for (int i = 0; i < 3; i++) {
+        result[i] = integrateChannel(c, i, r, relativeError, count);
+    }
+    if (samples)
+        *samples = count;
+    return result;
+}
@@ -0,0 +1,175 @@
+#include "PBDProfileKernel.hpp"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#include "BSSRDF.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HDSSS_PBD_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+using namespace std;
+using namespace glm;
+
+namespace pbd {
+
+ProfileConstants profileConstants(dvec3 sigma_a, dvec3 sigma_t, double eta) {
+    ProfileConstants c;
+    dvec3 sigma_s = sigma_t - sigma_a;
+    dvec3 D_g =
+        (2.0 * sigma_a + sigma_s) / (3.0 * pow(sigma_a + sigma_s, dvec3(2)));
+    dvec3 sigma_tr = sqrt(sigma_a / D_g);
+    dvec3 alpha = sigma_s / sigma_t;
+    double A_boundary = (1 + QC2x3(eta)) / (1 - QC1x2(eta));
+    dvec3 z_b = 2 * A_boundary * D_g;
+    c.Cphi = diffusion::CPhi(eta);
+    c.CE = diffusion::CE(eta);
+    // stratified sample positions of the scalar code
+    const double rn = 0.5;
+    for (int j = 0; j < EQUI_SAMPLES; j++) {
+        double xi = (j + rn) / EQUI_SAMPLES;
+        c.equiTan[j] = tan(PI / 2 * xi);
+    }
+    for (int i = 0; i < 3; i++) {
+        c.sigmaT[i] = sigma_t[i];
+        c.sigmaTr[i] = sigma_tr[i];
+        c.alpha[i] = alpha[i];
+        c.Dg[i] = D_g[i];
+        c.zb[i] = z_b[i];
+        for (int j = 0; j < EXP_SAMPLES; j++) {
+            double xi = (j + rn) / EXP_SAMPLES;
+            c.expT[i][j] = -log(1 - xi) / sigma_t[i];
+            c.expPdf[i][j] = sigma_t[i] * std::exp(-sigma_t[i] * c.expT[i][j]);
+        }
+    }
+    return c;
+}
+
+#ifdef HDSSS_PBD_SSE2
+struct SSE2d {
+    using V = __m128d;
+    using Scalar = double;
+    static constexpr int width = 2;
+    static V set1(double x) { return _mm_set1_pd(x); }
+    static V load(const double* p) { return _mm_load_pd(p); }
+    static void store(double* p, V v) { _mm_store_pd(p, v); }
+    static V add(V a, V b) { return _mm_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm_div_pd(a, b); }
+    static V sqrt(V a) { return _mm_sqrt_pd(a); }
+    static V min(V a, V b) { return _mm_min_pd(a, b); }
+    static V max(V a, V b) { return _mm_max_pd(a, b); }
+    static V lt(V a, V b) { return _mm_cmplt_pd(a, b); }
+    static V ge(V a, V b) { return _mm_cmpge_pd(a, b); }
+    static V select(V mask, V a) { return _mm_and_pd(mask, a); }
+    static V pow2(V fx) {
+        __m128i n = _mm_add_epi64(_mm_castpd_si128(fx), _mm_set1_epi64x(1023));
+        return _mm_castsi128_pd(_mm_slli_epi64(n, 52));
+    }
+};
+
+struct SSE2f {
+    using V = __m128;
+    using Scalar = float;
+    static constexpr int width = 4;
+    static V set1(float x) { return _mm_set1_ps(x); }
+    static V load(const float* p) { return _mm_load_ps(p); }
+    static void store(float* p, V v) { _mm_store_ps(p, v); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm_div_ps(a, b); }
+    static V sqrt(V a) { return _mm_sqrt_ps(a); }
+    static V min(V a, V b) { return _mm_min_ps(a, b); }
+    static V max(V a, V b) { return _mm_max_ps(a, b); }
+    static V lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static V ge(V a, V b) { return _mm_cmpge_ps(a, b); }
+    static V select(V mask, V a) { return _mm_and_ps(mask, a); }
+    static V pow2(V fx) {
+        __m128i n = _mm_add_epi32(_mm_castps_si128(fx), _mm_set1_epi32(127));
+        return _mm_castsi128_ps(_mm_slli_epi32(n, 23));
+    }
+};
+#endif
+
+}  // namespace pbd
+
+SIMDLevel bestSIMDLevel() {
+#ifdef HDSSS_PBD_SSE2
+    static const SIMDLevel best = []() {
+        bool avx2 = false;
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] >= 7) {
+            __cpuid(info, 1);
+            bool osxsave = info[2] & (1 << 27), avx = info[2] & (1 << 28);
+            __cpuidex(info, 7, 0);
+            // the OS must also save the ymm registers
+            avx2 = osxsave && avx && (info[1] & (1 << 5)) &&
+                   (_xgetbv(0) & 6) == 6;
+        }
+#else
+        avx2 = __builtin_cpu_supports("avx2");
+#endif
+        // the AVX2 unit may have been built without AVX2 code generation
+        double probe[4]{}, result[12];
+        if (avx2 && pbd::profileBatchAVX2(pbd::ProfileConstants{}, probe,
+                                          result, 0))
+            return SIMDLevel::AVX2;
+        return SIMDLevel::SSE2;
+    }();
+    return best;
+#else
+    return SIMDLevel::Scalar;
+#endif
+}
+
+template <typename Scalar, typename Vec3>
+static void profileBatch(dvec3 sigma_a, dvec3 sigma_t, double eta,
+                         const Scalar* r, Vec3* out, size_t count,
+                         SIMDLevel level) {
+    static_assert(sizeof(Vec3) == 3 * sizeof(Scalar),
+                  "RGB output must be tightly packed");
+    if (count == 0)
+        return;
+    level = std::min(level, bestSIMDLevel());
+    auto c = pbd::profileConstants(sigma_a, sigma_t, eta);
+    auto outScalars = reinterpret_cast<Scalar*>(out);
+#ifdef HDSSS_PBD_SSE2
+    using SSE2 =
+        std::conditional_t<sizeof(Scalar) == 8, pbd::SSE2d, pbd::SSE2f>;
+    if (level == SIMDLevel::AVX2 &&
+        pbd::profileBatchAVX2(c, r, outScalars, count))
+        return;
+    if (level >= SIMDLevel::SSE2) {
+        pbd::profileBatch<SSE2>(c, r, outScalars, count);
+        return;
+    }
+#endif
+    (void)c;
+    (void)outScalars;
+    for (size_t i = 0; i < count; i++)
+        out[i] = Vec3(PBDProfile(sigma_a, sigma_t, eta, r[i]));
+}
+
+void PBDProfileBatch(dvec3 sigma_a, dvec3 sigma_t, double eta, const double* r,
+                     dvec3* out, size_t count, SIMDLevel level) {
+    profileBatch(sigma_a, sigma_t, eta, r, out, count, level);
+}
+
+void PBDProfileBatch(vec3 sigma_a, vec3 sigma_t, float eta, const float* r,
+                     vec3* out, size_t count, SIMDLevel level) {
+    profileBatch(dvec3(sigma_a), dvec3(sigma_t), double(eta), r, out, count,
+                 level);
+}
@@ -0,0 +1,85 @@
+// built with AVX2 code generation, only called after a CPUID check. The Ops
+// types live in an anonymous namespace, so every kernel instantiation stays
+// local to this file and the linker never picks an AVX2 copy for the others
+#include "PBDProfileKernel.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace pbd {
+
+#ifdef __AVX2__
+namespace {
+
+struct AVX2d {
+    using V = __m256d;
+    using Scalar = double;
+    static constexpr int width = 4;
+    static V set1(double x) { return _mm256_set1_pd(x); }
+    static V load(const double* p) { return _mm256_load_pd(p); }
+    static void store(double* p, V v) { _mm256_store_pd(p, v); }
+    static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm256_div_pd(a, b); }
+    static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+    static V min(V a, V b) { return _mm256_min_pd(a, b); }
+    static V max(V a, V b) { return _mm256_max_pd(a, b); }
+    static V lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static V ge(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static V select(V mask, V a) { return _mm256_and_pd(mask, a); }
+    static V pow2(V fx) {
+        __m256i n = _mm256_add_epi64(_mm256_castpd_si256(fx),
+                                     _mm256_set1_epi64x(1023));
+        return _mm256_castsi256_pd(_mm256_slli_epi64(n, 52));
+    }
+};
+
+struct AVX2f {
+    using V = __m256;
+    using Scalar = float;
+    static constexpr int width = 8;
+    static V set1(float x) { return _mm256_set1_ps(x); }
+    static V load(const float* p) { return _mm256_load_ps(p); }
+    static void store(float* p, V v) { _mm256_store_ps(p, v); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+    static V min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static V lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static V ge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static V select(V mask, V a) { return _mm256_and_ps(mask, a); }
+    static V pow2(V fx) {
+        __m256i n = _mm256_add_epi32(_mm256_castps_si256(fx),
+                                     _mm256_set1_epi32(127));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(n, 23));
+    }
+};
+
+}  // namespace
+
+bool profileBatchAVX2(const ProfileConstants& c, const double* r, double* out,
+                      size_t count) {
+    profileBatch<AVX2d>(c, r, out, count);
+    return true;
+}
+bool profileBatchAVX2(const ProfileConstants& c, const float* r, float* out,
+                      size_t count) {
+    profileBatch<AVX2f>(c, r, out, count);
+    return true;
+}
+#else
+bool profileBatchAVX2(const ProfileConstants&, const double*, double*,
+                      size_t) {
+    return false;
+}
+bool profileBatchAVX2(const ProfileConstants&, const float*, float*, size_t) {
+    return false;
+}
+#endif
+
+}  // namespace pbd
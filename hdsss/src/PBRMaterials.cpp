@@ -3,6 +3,7 @@
 #include "constants.hpp"
 #include "loo/Material.hpp"
 
+#include <cstddef>
 #include <memory>
 #include <string>
 
@@ -15,6 +16,9 @@ using namespace std;
 using namespace glm;
 using namespace loo;
 
+// std140 offset of rdProfileLayer in the PBRMetallicMaterial block
+static_assert(offsetof(ShaderPBRMetallicMaterial, rdProfileLayer) == 48);
+
 void PBRMetallicMaterial::bind(const ShaderProgram& sp) {
     PBRMetallicMaterial::uniformBuffer->updateData(&m_shadermaterial);
     sp.setTexture(SHADER_BINDING_PORT_MR_BASECOLOR,
@@ -39,12 +43,8 @@ shared_ptr<PBRMetallicMaterial> PBRMetallicMaterial::getDefault() {
 
 shared_ptr<PBRMetallicMaterial> PBRMetallicMaterial::getDefaultSubsurface() {
     if (!defaultSubsurfaceMaterial) {
-        const auto& bssrdf = PBRMetallicMaterial::bssrdf;
-        const vec3 defaultSigmaT = bssrdf.sigma_t,
-                   defaultSigmaS = bssrdf.albedo * defaultSigmaT,
-                   defaultSigmaA = defaultSigmaT - defaultSigmaS;
         defaultSubsurfaceMaterial = make_shared<PBRMetallicMaterial>(
-            vec3(1.0), 0.0, 1.0, defaultSigmaT, defaultSigmaA, 0.05);
+            createDefaultSubsurfaceShaderMaterial());
     }
     return defaultSubsurfaceMaterial;
 }
@@ -56,20 +56,38 @@ unique_ptr<UniformBuffer> PBRMetallicMaterial::uniformBuffer = nullptr;
 PBRMetallicMaterial::BSSRDFConfig PBRMetallicMaterial::bssrdf = {vec3(4.0),
                                                                  vec3(0, 1, 0)};
 
-std::shared_ptr<PBRMetallicMaterial> convertPBRMetallicMaterialFromBaseMaterial(
-    const loo::BaseMaterial& baseMaterial) {
-    const auto& pbrMetallic = baseMaterial.mrWorkFlow;
+ShaderPBRMetallicMaterial createSubsurfaceShaderMaterial(vec3 sigmaT,
+                                                         vec3 albedo) {
+    const vec3 sigmaS = albedo * sigmaT, sigmaA = sigmaT - sigmaS;
+    return ShaderPBRMetallicMaterial(vec3(1.0), 0.0, 1.0, sigmaT, sigmaA,
+                                     0.05);
+}
+
+ShaderPBRMetallicMaterial createDefaultSubsurfaceShaderMaterial() {
+    const auto& bssrdf = PBRMetallicMaterial::bssrdf;
+    return createSubsurfaceShaderMaterial(bssrdf.sigma_t, bssrdf.albedo);
+}
+
+ShaderPBRMetallicMaterial createShaderPBRMetallicMaterial(
+    const loo::MetallicRoughnessWorkFlow& pbrMetallic) {
     const auto& bssrdf = PBRMetallicMaterial::bssrdf;
     const vec3 defaultSigmaT = bssrdf.sigma_t,
                defaultSigmaS = bssrdf.albedo * defaultSigmaT,
                defaultSigmaA = defaultSigmaT - defaultSigmaS;
-    auto metallicMaterial = std::make_shared<PBRMetallicMaterial>(
+    return ShaderPBRMetallicMaterial(
         pbrMetallic.baseColor, pbrMetallic.metallic, pbrMetallic.transmission,
         // TODO: use measured data, currently using the marble data
         length(pbrMetallic.sigma_t) == 0 ? pbrMetallic.sigma_t : defaultSigmaT,
         length(pbrMetallic.sigma_a) == 0 ? pbrMetallic.sigma_a : defaultSigmaA,
         // pbrMetallic.sigma_t, pbrMetallic.sigma_a,
         pbrMetallic.roughness);
+}
+
+std::shared_ptr<PBRMetallicMaterial> convertPBRMetallicMaterialFromBaseMaterial(
+    const loo::BaseMaterial& baseMaterial) {
+    const auto& pbrMetallic = baseMaterial.mrWorkFlow;
+    auto metallicMaterial = std::make_shared<PBRMetallicMaterial>(
+        createShaderPBRMetallicMaterial(pbrMetallic));
     metallicMaterial->baseColorTex = pbrMetallic.baseColorTex;
     metallicMaterial->normalTex = baseMaterial.normalTex;
     metallicMaterial->metallicTex = pbrMetallic.metallicTex;
@@ -0,0 +1,141 @@
+#include "RdProfileAtlas.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <loo/Parallel.hpp>
+#include "constants.hpp"
+using namespace std;
+using namespace glm;
+using namespace loo;
+
+// log ratio of the coefficients, so thin and dense media compare alike
+static double profileDistance(const BSSRDFParams& a, const BSSRDFParams& b) {
+    auto logRatio = [](const dvec3& x, const dvec3& y) {
+        dvec3 d = log(max(x, dvec3(1e-6))) - log(max(y, dvec3(1e-6)));
+        return dot(d, d);
+    };
+    dvec3 albedo = a.albedo - b.albedo;
+    return logRatio(a.sigmaT, b.sigmaT) + logRatio(a.sigmaA, b.sigmaA) +
+           dot(albedo, albedo) + (a.eta - b.eta) * (a.eta - b.eta);
+}
+
+int assignRdProfileLayer(vector<BSSRDFParams>& profiles,
+                         const BSSRDFParams& params) {
+    auto it = find(profiles.begin(), profiles.end(), params);
+    if (it != profiles.end())
+        return it - profiles.begin();
+    if (profiles.size() < RD_PROFILE_MAX_LAYERS) {
+        profiles.push_back(params);
+        return profiles.size() - 1;
+    }
+    int nearest = 0;
+    for (size_t i = 1; i < profiles.size(); i++) {
+        if (profileDistance(params, profiles[i]) <
+            profileDistance(params, profiles[nearest]))
+            nearest = i;
+    }
+    LOG(ERROR) << "More than " << RD_PROFILE_MAX_LAYERS
+               << " subsurface parameter sets, a material shares the Rd "
+                  "profile of layer "
+               << nearest;
+    return nearest;
+}
+
+void RdProfileAtlas::build(const vector<BSSRDFTabulator>& tables) {
+    CHECK(!tables.empty());
+    CHECK_LE(tables.size(), RD_PROFILE_MAX_LAYERS);
+    const auto& options = tables[0].options;
+    ShaderRdProfileAtlas shaderAtlas{};
+    for (size_t i = 0; i < tables.size(); i++) {
+        CHECK(tables[i].options == options)
+            << "Rd profile atlas layers must share their table options";
+        shaderAtlas.extents[i] =
+            vec4(tables[i].maxDistance, tables[i].maxArea, 0, 0);
+    }
+    shaderAtlas.distanceWarp = GLint(options.distanceWarp);
+
+    m_layers = tables.size();
+    const int N = options.tableSize;
+    // a table has no more terms than rows
+    BSSRDFEncodingOptions encoding = m_encoding;
+    encoding.rank = std::min(encoding.rank, N);
+    m_texture = make_unique<Texture2DArray>();
+    m_texture->init();
+    vector<BSSRDFEncodingError> errors(m_layers);
+    if (encoding.encoding == BSSRDFTableEncoding::LowRank) {
+        const int rank = encoding.rank;
+        // distance curves in rows [0, rank), area curves in [rank, 2 rank)
+        vector<vector<vec3>> curves(m_layers);
+        loo::parallelFor(m_layers, [&](size_t i) {
+            auto lowRank = BSSRDFLowRankTable::factorize(tables[i], rank);
+            curves[i] = lowRank.distanceCurves;
+            curves[i].insert(curves[i].end(), lowRank.areaCurves.begin(),
+                             lowRank.areaCurves.end());
+            errors[i] = measureEncodingError(tables[i], lowRank.decode());
+        });
+        m_texture->setupStorage(N, 2 * rank, m_layers, GL_RGB32F, 1);
+        for (int i = 0; i < m_layers; i++) {
+            m_texture->setupLayer(i, curves[i].data(), GL_RGB, GL_FLOAT);
+        }
+        shaderAtlas.lowRank = rank;
+    } else if (encoding.encoding == BSSRDFTableEncoding::Analytic) {
+        vector<BSSRDFAnalyticProfile> profiles(m_layers);
+        // one table per worker, the profile of a single one is quickly
+        // sampled
+        loo::parallelFor(m_layers, [&](size_t i) {
+            profiles[i] = BSSRDFAnalyticProfile::fit(tables[i], 1);
+            errors[i] = profiles[i].measureError(tables[i]);
+        });
+        for (int i = 0; i < m_layers; i++) {
+            for (int j = 0; j < 2; j++) {
+                shaderAtlas.analyticTerms[4 * i + 2 * j] =
+                    vec4(vec3(profiles[i].weights[j]), 0);
+                shaderAtlas.analyticTerms[4 * i + 2 * j + 1] =
+                    vec4(vec3(profiles[i].rates[j]), 0);
+            }
+        }
+        // keeps the sampler of the shaders complete, it is never read
+        const vector<vec3> placeholder(m_layers, vec3(0.0f));
+        m_texture->setupStorage(1, 1, m_layers, GL_RGB32F, 1);
+        for (int i = 0; i < m_layers; i++) {
+            m_texture->setupLayer(i, &placeholder[i], GL_RGB, GL_FLOAT);
+        }
+        shaderAtlas.analytic = 1;
+    } else {
+        GLenum internalFormat = GL_RGB32F;
+        if (encoding.encoding == BSSRDFTableEncoding::Half)
+            internalFormat = GL_RGB16F;
+        else if (encoding.encoding == BSSRDFTableEncoding::SharedExponent)
+            internalFormat = GL_RGB9_E5;
+        m_texture->setupStorage(N, N, m_layers, internalFormat, 1);
+        // the driver converts the float tables, decodeTable() mirrors it
+        for (int i = 0; i < m_layers; i++) {
+            m_texture->setupLayer(i, tables[i].getTableData(), GL_RGB,
+                                  GL_FLOAT);
+        }
+        if (encoding.encoding != BSSRDFTableEncoding::Float32) {
+            loo::parallelFor(m_layers, [&](size_t i) {
+                errors[i] = measureEncodingError(tables[i], encoding);
+            });
+        }
+    }
+    m_texture->setSizeFilter(GL_LINEAR, GL_LINEAR);
+    m_texture->setWrapFilter(GL_CLAMP_TO_EDGE);
+
+    m_uniformbuffer = make_unique<UniformBuffer>(
+        SHADER_BINDING_PORT_RD_PROFILE_ATLAS, sizeof(ShaderRdProfileAtlas),
+        &shaderAtlas);
+    m_memorysize = encodedTableSize(N, encoding) * m_layers;
+    LOG(INFO) << "Rd profile atlas: " << m_layers << " layers of " << N << "x"
+              << N << " encoded as " << encodingName(encoding.encoding)
+              << ", " << m_memorysize / 1024.0 << " KB";
+    if (encoding.encoding == BSSRDFTableEncoding::Float32)
+        return;
+    for (int i = 0; i < m_layers; i++) {
+        LOG(INFO) << "Rd profile layer " << i
+                  << " max error: " << errors[i].maxError
+                  << " rms error: " << errors[i].rmsError
+                  << " mean relative error: " << errors[i].meanRelativeError;
+    }
+}
@@ -0,0 +1,124 @@
+#include "SeparableSSS.hpp"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <loo/Application.hpp>
+#include <loo/Parallel.hpp>
+#include <loo/Quad.hpp>
+#include <loo/glError.hpp>
+#include "constants.hpp"
+#include "shaders/separablesss.frag.hpp"
+#include "shaders/separablesss.vert.hpp"
+using namespace std;
+using namespace glm;
+using namespace loo;
+
+static unique_ptr<Texture2D> createBlurTexture() {
+    auto texture = make_unique<Texture2D>();
+    texture->init();
+    texture->setupStorage(Application::getContext()->getWidth(),
+                          Application::getContext()->getHeight(), GL_RGB32F,
+                          1);
+    texture->setSizeFilter(GL_LINEAR, GL_LINEAR);
+    texture->setWrapFilter(GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+SeparableSSS::SeparableSSS()
+    : m_blurshader{Shader(SEPARABLESSS_VERT, ShaderType::Vertex),
+                   Shader(SEPARABLESSS_FRAG, ShaderType::Fragment)} {}
+
+void SeparableSSS::init() {
+    m_blurfb.init();
+    m_horizontaltex = createBlurTexture();
+    m_laddertex[0] = createBlurTexture();
+    m_laddertex[1] = createBlurTexture();
+    m_resulttex = createBlurTexture();
+    panicPossibleGLError();
+}
+
+void SeparableSSS::setProfiles(const vector<BSSRDFTabulator>& tables) {
+    CHECK(!tables.empty());
+    CHECK_LE(tables.size(), RD_PROFILE_MAX_LAYERS);
+    const int terms =
+        std::clamp(options.terms, 1, BSSRDF_GAUSSIAN_TERMS_MAX);
+    m_fits.resize(tables.size());
+    // one table per worker, the profile of a single one is quickly sampled
+    loo::parallelFor(tables.size(), [&](size_t i) {
+        m_fits[i] = BSSRDFGaussianFit::fit(tables[i], terms, 1);
+    });
+    ShaderSeparableSSSProfiles shaderProfiles{};
+    for (size_t i = 0; i < m_fits.size(); i++) {
+        const auto& fit = m_fits[i];
+        for (int k = 0; k < terms; k++) {
+            shaderProfiles.terms[i * BSSRDF_GAUSSIAN_TERMS_MAX + k] =
+                vec4(vec3(fit.weights[k]), float(fit.variances[k]));
+        }
+        LOG(INFO) << "Rd profile layer " << i << " fitted by " << terms
+                  << " gaussians, max error: " << fit.error.maxError
+                  << " rms error: " << fit.error.rmsError
+                  << " energy error: " << fit.error.energyError;
+    }
+    shaderProfiles.termCount = terms;
+    m_uniformbuffer = make_unique<UniformBuffer>(
+        SHADER_BINDING_PORT_SEPARABLE_SSS_PROFILES,
+        sizeof(ShaderSeparableSSSProfiles), &shaderProfiles);
+}
+
+void SeparableSSS::blurPass(const Camera& camera,
+                            const Texture2D& GBufferPosition,
+                            const Texture2D& GBufferNormal,
+                            const Texture2D& GBuffer3,
+                            const Texture2D& GBuffer5,
+                            const Texture2D& transmittedIrradiance) {
+    m_blurfb.bind();
+    m_blurfb.attachTexture(*m_resulttex, GL_COLOR_ATTACHMENT1, 0);
+    m_blurfb.enableAttachments({GL_COLOR_ATTACHMENT1});
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (m_fits.empty()) {
+        m_blurfb.unbind();
+        return;
+    }
+    glDisable(GL_DEPTH_TEST);
+
+    m_blurshader.use();
+    m_blurshader.setUniform("cameraPos", camera.getPosition());
+    m_blurshader.setUniform("cameraFront", camera.front);
+    float height = Application::getContext()->getHeight();
+    m_blurshader.setUniform("pixelScale",
+                            0.5f * height / tan(0.5f * camera.m_fov));
+    m_blurshader.setUniform("depthFalloff", options.depthFalloff);
+    m_blurshader.setTexture(0, GBufferPosition);
+    m_blurshader.setTexture(1, GBufferNormal);
+    m_blurshader.setTexture(2, GBuffer3);
+    m_blurshader.setTexture(3, GBuffer5);
+
+    const int terms = m_fits[0].terms();
+    for (int k = 0; k < terms; k++) {
+        const Texture2D& source =
+            k == 0 ? transmittedIrradiance : *m_laddertex[(k - 1) & 1];
+        m_blurshader.setUniform("term", k);
+
+        m_blurshader.setUniform("axisX", true);
+        m_blurshader.setTexture(4, source);
+        m_blurfb.attachTexture(*m_horizontaltex, GL_COLOR_ATTACHMENT0, 0);
+        m_blurfb.enableAttachments({GL_COLOR_ATTACHMENT0});
+        Quad::globalQuad().draw();
+
+        // the ladder is overwritten, the weighted term is added to the sum
+        m_blurshader.setUniform("axisX", false);
+        m_blurshader.setTexture(4, *m_horizontaltex);
+        m_blurfb.attachTexture(*m_laddertex[k & 1], GL_COLOR_ATTACHMENT0, 0);
+        m_blurfb.enableAttachments(
+            {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1});
+        glEnablei(GL_BLEND, 1);
+        glBlendFunci(1, GL_ONE, GL_ONE);
+        Quad::globalQuad().draw();
+        glDisablei(GL_BLEND, 1);
+    }
+    logPossibleGLError();
+    glEnable(GL_DEPTH_TEST);
+    m_blurfb.unbind();
+}
@@ -1,6 +1,14 @@
 #include "BSSRDF.hpp"
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "TestTables.hpp"
 using namespace std;
 using namespace glm;
 
@@ -47,4 +55,308 @@ TEST(PBDProfileTest, LargeSigmaT) {
         EXPECT_NEAR(value.g / expectedValues[i], 1.0, FLOAT_PERCENT_ERROR)
             << "r = " << rs[i];
     }
-}
\ No newline at end of file
+}
+// every SIMD level the host supports, plus the scalar fallback
+static vector<SIMDLevel> supportedSIMDLevels() {
+    vector<SIMDLevel> levels{SIMDLevel::Scalar};
+    if (bestSIMDLevel() != SIMDLevel::Scalar) {
+        levels.push_back(SIMDLevel::SSE2);
+    }
+    if (bestSIMDLevel() == SIMDLevel::AVX2) {
+        levels.push_back(SIMDLevel::AVX2);
+    }
+    return levels;
+}
+
+TEST(PBDProfileTest, BatchLargeSigmaT) {
+    dvec3 sigma_t = dvec3(40);
+    dvec3 sigma_a = sigma_t - sigma_t * dvec3(0, 1, 0);
+    const double rs[]{0.001, 0.01, 0.1, 1.0};
+    const float rsf[]{0.001, 0.01, 0.1, 1.0};
+    const double expectedValues[]{
+        2.9391e+02,
+        7.0614e+01,
+        4.4611e+00,
+        7.3577e-04,
+    };
+    for (SIMDLevel level : supportedSIMDLevels()) {
+        dvec3 values[4];
+        vec3 valuesf[4];
+        PBDProfileBatch(sigma_a, sigma_t, 1.5, rs, values, 4, level);
+        PBDProfileBatch(vec3(sigma_a), vec3(sigma_t), 1.5f, rsf, valuesf, 4,
+                        level);
+        for (int i = 0; i < 4; i++) {
+            EXPECT_NEAR(values[i].g / expectedValues[i], 1.0,
+                        FLOAT_PERCENT_ERROR)
+                << "level " << int(level) << ", r = " << rs[i];
+            EXPECT_NEAR(valuesf[i].g / expectedValues[i], 1.0,
+                        FLOAT_PERCENT_ERROR)
+                << "level " << int(level) << ", r = " << rs[i];
+        }
+    }
+}
+
+TEST(PBDProfileTest, BatchMatchesScalar) {
+    dvec3 sigma_a = dvec3(0.0021, 0.0041, 0.0071) * 10.0;
+    dvec3 sigma_t = sigma_a + dvec3(2.19, 2.62, 2.00) * 10.0;
+    // odd count so the vector tail is exercised
+    constexpr size_t COUNT = 1027;
+    vector<double> rs(COUNT);
+    vector<float> rsf(COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        rs[i] = 2.0 * i / (COUNT - 1);
+        rsf[i] = float(rs[i]);
+    }
+    vector<dvec3> reference(COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        reference[i] = PBDProfile(sigma_a, sigma_t, 1.3, rs[i]);
+    }
+    for (SIMDLevel level : supportedSIMDLevels()) {
+        vector<dvec3> values(COUNT);
+        vector<vec3> valuesf(COUNT);
+        PBDProfileBatch(sigma_a, sigma_t, 1.3, rs.data(), values.data(),
+                        COUNT, level);
+        PBDProfileBatch(vec3(sigma_a), vec3(sigma_t), 1.3f, rsf.data(),
+                        valuesf.data(), COUNT, level);
+        for (size_t i = 0; i < COUNT; i++) {
+            for (int c = 0; c < 3; c++) {
+                EXPECT_NEAR(values[i][c] / reference[i][c], 1.0, 1e-12)
+                    << "level " << int(level) << ", r = " << rs[i];
+                EXPECT_NEAR(valuesf[i][c] / reference[i][c], 1.0, 1e-4)
+                    << "level " << int(level) << ", r = " << rs[i];
+            }
+        }
+    }
+}
+TEST(PBDProfileTest, AdaptiveConverges) {
+    dvec3 sigma_t = dvec3(2.0, 4.0, 40.0);
+    dvec3 albedo = dvec3(0.9, 0.6, 0.3);
+    dvec3 sigma_a = sigma_t - sigma_t * albedo;
+    for (double r : {1e-4, 1e-3, 1e-2, 0.1, 0.3, 1.0, 3.0}) {
+        int samples = 0, referenceSamples = 0;
+        dvec3 value = PBDProfileAdaptive(sigma_a, sigma_t, 1.5, r,
+                                         BSSRDF_PROFILE_TOLERANCE, &samples);
+        dvec3 reference = PBDProfileAdaptive(sigma_a, sigma_t, 1.5, r, 1e-10,
+                                             &referenceSamples);
+        EXPECT_GT(samples, 0);
+        EXPECT_GT(referenceSamples, samples) << "r = " << r;
+        for (int i = 0; i < 3; i++) {
+            EXPECT_NEAR(value[i] / reference[i], 1.0,
+                        BSSRDF_PROFILE_TOLERANCE)
+                << "r = " << r << " channel " << i;
+        }
+    }
+    // away from r = 0 and the tail the fixed samples are accurate too
+    dvec3 fixed = PBDProfile(sigma_a, sigma_t, 1.5, 0.3);
+    dvec3 adaptive = PBDProfileAdaptive(sigma_a, sigma_t, 1.5, 0.3);
+    EXPECT_NEAR(fixed.r / adaptive.r, 1.0, 1e-2);
+    EXPECT_NEAR(fixed.g / adaptive.g, 1.0, 1e-2);
+}
+
+TEST(TabulatorTest, ThreadCountInvariant) {
+    // timings belong in HDSSSbench, a small table is enough to check that
+    // the work split over the threads adds up to the same table
+    BSSRDFTabulateOptions options;
+    options.tableSize = 64;
+    BSSRDFTabulator reference = tabulatedTestTable(options.tableSize);
+    for (unsigned int n : {1u, 2u, 3u}) {
+        BSSRDFTabulator tabulator(options);
+        tabulator.tabulate(testTableParams(), n);
+        EXPECT_EQ(tabulator.maxDistance, reference.maxDistance);
+        EXPECT_EQ(tabulator.maxArea, reference.maxArea);
+        EXPECT_EQ(memcmp(tabulator.getTableData(), reference.getTableData(),
+                         options.tableSize * options.tableSize * sizeof(vec3)),
+                  0)
+            << "threads = " << n;
+    }
+}
+
+TEST(TabulatorTest, BandQuadratureMatchesMarch) {
+    BSSRDFParams params;
+    params.sigmaT = dvec3(2.0, 4.0, 8.0);
+    params.albedo = dvec3(0.9, 0.6, 0.3);
+    params.sigmaA = params.sigmaT - params.sigmaT * params.albedo;
+    BSSRDFTabulateOptions options;
+    options.tableSize = 256;
+    options.integration = BSSRDFIntegration::March;
+    BSSRDFTabulator march(options);
+    march.tabulate(params);
+    options.integration = BSSRDFIntegration::BandQuadrature;
+    BSSRDFTabulator band(options);
+    band.tabulate(params);
+    EXPECT_EQ(band.maxDistance, march.maxDistance);
+    EXPECT_EQ(band.maxArea, march.maxArea);
+
+    const int cells = options.tableSize * options.tableSize;
+    const vec3 *marchTable = march.getTableData(),
+               *bandTable = band.getTableData();
+    float maxValue = 0;
+    for (int i = 0; i < cells; i++) {
+        maxValue = std::max({maxValue, marchTable[i].r, marchTable[i].g,
+                             marchTable[i].b});
+    }
+    double relativeSum = 0, relativeMax = 0;
+    int counted = 0;
+    for (int i = 0; i < cells; i++) {
+        for (int c = 0; c < 3; c++) {
+            if (marchTable[i][c] < 1e-4 * maxValue)
+                continue;
+            double relative = std::abs(bandTable[i][c] - marchTable[i][c]) /
+                              marchTable[i][c];
+            relativeSum += relative;
+            relativeMax = std::max(relativeMax, relative);
+            counted++;
+        }
+    }
+    cout << "mean relative difference: " << relativeSum / counted
+         << " max: " << relativeMax << endl;
+    EXPECT_LT(relativeSum / counted, BSSRDF_BAND_QUADRATURE_TOLERANCE);
+    EXPECT_LT(relativeMax, 0.25);
+    // rows below the profile spacing fall back to the March
+    EXPECT_EQ(memcmp(bandTable, marchTable, sizeof(vec3) * options.tableSize),
+              0);
+}
+
+TEST(TabulatorTest, BinaryRoundTrip) {
+    BSSRDFParams params;
+    params.sigmaT = dvec3(0.5, 1.0, 2.0);
+    params.albedo = dvec3(0.9, 0.6, 0.3);
+    params.sigmaA = params.sigmaT - params.sigmaT * params.albedo;
+    BSSRDFTabulator reference;
+    reference.tabulate(params);
+    const size_t tableBytes =
+        BSSRDF_TABLE_SIZE * BSSRDF_TABLE_SIZE * sizeof(vec3);
+
+    auto binPath = filesystem::temp_directory_path() / "hdsss_roundtrip.bin";
+    ASSERT_TRUE(reference.save(binPath.string()));
+    {
+        BSSRDFTabulator loaded;
+        ASSERT_TRUE(loaded.read(binPath.string()));
+        EXPECT_EQ(loaded.options, reference.options);
+        EXPECT_EQ(loaded.maxDistance, reference.maxDistance);
+        EXPECT_EQ(loaded.maxArea, reference.maxArea);
+        EXPECT_EQ(loaded.params.sigmaA, params.sigmaA);
+        EXPECT_EQ(loaded.params.sigmaT, params.sigmaT);
+        EXPECT_EQ(loaded.params.albedo, params.albedo);
+        EXPECT_EQ(loaded.params.eta, params.eta);
+        EXPECT_EQ(memcmp(loaded.getTableData(), reference.getTableData(),
+                         tableBytes),
+                  0);
+    }
+
+    // a flipped payload byte must be caught by the checksum
+    {
+        fstream fs(binPath, ios::in | ios::out | ios::binary);
+        fs.seekp(-1, ios::end);
+        fs.put('\x7f');
+    }
+    BSSRDFTabulator corrupted;
+    EXPECT_FALSE(corrupted.read(binPath.string()));
+    filesystem::remove(binPath);
+
+    // legacy text tables are still imported
+    auto txtPath = filesystem::temp_directory_path() / "hdsss_roundtrip.txt";
+    {
+        ofstream ofs(txtPath);
+        ofs << setprecision(9) << reference.maxDistance << " "
+            << reference.maxArea << endl;
+        const vec3* data = reference.getTableData();
+        for (int i = 0; i < BSSRDF_TABLE_SIZE * BSSRDF_TABLE_SIZE; i++) {
+            ofs << data[i].r << " " << data[i].g << " " << data[i].b << " ";
+        }
+    }
+    BSSRDFTabulator imported;
+    ASSERT_TRUE(imported.read(txtPath.string()));
+    EXPECT_EQ(memcmp(imported.getTableData(), reference.getTableData(),
+                     tableBytes),
+              0);
+    // filed under the options of the text format, which are not the default
+    // ones, so the viewer only imports them when it runs with those
+    EXPECT_TRUE(imported.options ==
+                BSSRDFTabulator::textTableOptions(BSSRDFTabulateOptions{}));
+    EXPECT_FALSE(imported.options == BSSRDFTabulateOptions{});
+    filesystem::remove(txtPath);
+}
+
+TEST(TabulatorTest, WarpedDistanceAxis) {
+    for (auto warp : {BSSRDFAxisWarp::Linear, BSSRDFAxisWarp::Sqrt,
+                      BSSRDFAxisWarp::Log}) {
+        EXPECT_NEAR(warpDistance(warp, 0.0), 0.0, 1e-12);
+        EXPECT_NEAR(warpDistance(warp, 1.0), 1.0, 1e-12);
+        for (double u = 0.0; u <= 1.0; u += 0.125) {
+            EXPECT_NEAR(unwarpDistance(warp, warpDistance(warp, u)), u, 1e-12);
+        }
+    }
+
+    auto reference = tabulatedTestTable(BSSRDF_TABLE_SIZE);
+    BSSRDFTabulateOptions options;
+    options.tableSize = 128;
+    options.distanceWarp = BSSRDFAxisWarp::Log;
+    auto warped = tabulatedTestTable(128, options);
+    EXPECT_EQ(warped.maxDistance, reference.maxDistance);
+
+    // small area rows carry the sharp center of the profile, log spaced
+    // columns resolve it better than 128 linear ones(about 5e-3)
+    double maxError = 0.0;
+    for (int y = 1; y <= 4; y++) {
+        double area = reference.maxArea * y / 128;
+        vec3 peak = reference.lookup(0.0, area);
+        for (double r = 1e-3; r < 1.0; r *= 1.05) {
+            double distance = r * reference.maxDistance;
+            vec3 error = abs(warped.lookup(distance, area) -
+                             reference.lookup(distance, area)) /
+                         peak;
+            maxError = std::max(
+                {maxError, double(error.r), double(error.g), double(error.b)});
+        }
+    }
+    EXPECT_LT(maxError, 3e-3);
+
+    auto path = filesystem::temp_directory_path() / "hdsss_warped.bin";
+    ASSERT_TRUE(warped.save(path.string()));
+    BSSRDFTabulator loaded;
+    ASSERT_TRUE(loaded.read(path.string()));
+    EXPECT_EQ(loaded.options, options);
+    EXPECT_EQ(loaded.lookup(0.1, 0.1), warped.lookup(0.1, 0.1));
+    filesystem::remove(path);
+}
+
+TEST(TabulatorTest, ResampledCoarseTable) {
+    BSSRDFTabulateOptions options;
+    options.tableSize = 256;
+    auto full = tabulatedTestTable(options.tableSize);
+
+    // resampling to the own size reproduces every cell
+    auto same = full.resampled(options.tableSize);
+    EXPECT_EQ(same.options, full.options);
+    for (int i = 0; i < options.tableSize * options.tableSize; i++) {
+        vec3 error = abs(same.getTableData()[i] - full.getTableData()[i]);
+        ASSERT_LE(std::max({error.r, error.g, error.b}),
+                  1e-5f * length(full.getTableData()[i]) + 1e-12f);
+    }
+
+    // the stand-in the viewer shows while the full table is tabulated
+    auto coarse = tabulatedTestTable(64);
+    auto upsampled = coarse.resampled(full.options.tableSize);
+    EXPECT_EQ(upsampled.options, full.options);
+    EXPECT_EQ(upsampled.maxDistance, full.maxDistance);
+    EXPECT_EQ(upsampled.maxArea, full.maxArea);
+    double maxError = 0.0;
+    const int N = full.options.tableSize;
+    for (int y = N / 8; y < N; y++) {
+        float peak = 0.0f;
+        for (int x = 0; x < N; x++) {
+            vec3 v = full.getTableData()[y * N + x];
+            peak = std::max({peak, v.r, v.g, v.b});
+        }
+        for (int x = 0; x < N; x++) {
+            vec3 error = abs(upsampled.getTableData()[y * N + x] -
+                             full.getTableData()[y * N + x]) /
+                         peak;
+            maxError = std::max(
+                {maxError, double(error.r), double(error.g), double(error.b)});
+        }
+    }
+    // a few percent of the row peak(about 4.5e-2) on the steep center
+    EXPECT_LT(maxError, 6e-2);
+}
@@ -0,0 +1,151 @@
+#include "BSSRDFCache.hpp"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <loo/Hash.hpp>
+#include <string>
+using namespace std;
+using namespace glm;
+namespace fs = std::filesystem;
+
+TEST(SHA256Test, KnownDigests) {
+    loo::SHA256 empty;
+    EXPECT_EQ(loo::SHA256::toHex(empty.finalize()),
+              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    loo::SHA256 abc;
+    abc.update("abc", 3);
+    EXPECT_EQ(loo::SHA256::toHex(abc.finalize()),
+              "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    // two blocks after padding
+    string message = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    loo::SHA256 split;
+    split.update(message.data(), 10);
+    split.update(message.data() + 10, message.size() - 10);
+    EXPECT_EQ(loo::SHA256::toHex(split.finalize()),
+              "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+class BSSRDFCacheTest : public testing::Test {
+   protected:
+    fs::path directory = fs::temp_directory_path() / "hdsss_cache_test";
+    void SetUp() override { fs::remove_all(directory); }
+    void TearDown() override { fs::remove_all(directory); }
+
+    static BSSRDFParams makeParams(double sigmaT) {
+        BSSRDFParams params;
+        params.sigmaT = dvec3(sigmaT);
+        params.albedo = dvec3(0.5);
+        params.sigmaA = params.sigmaT - params.sigmaT * params.albedo;
+        return params;
+    }
+    // entries are only written and read back here, tabulating is not needed
+    static BSSRDFTabulator makeTable(const BSSRDFParams& params) {
+        BSSRDFTabulator tabulator;
+        tabulator.params = params;
+        tabulator.maxDistance = params.sigmaT.x;
+        tabulator.maxArea = params.sigmaT.y;
+        return tabulator;
+    }
+};
+
+TEST_F(BSSRDFCacheTest, KeyCoversEveryInput) {
+    auto params = makeParams(1.0);
+    string key = BSSRDFCache::key(params, {});
+    EXPECT_EQ(key.size(), 64u);
+    EXPECT_EQ(key, BSSRDFCache::key(makeParams(1.0), {}));
+    auto other = params;
+    other.eta = 1.3;
+    EXPECT_NE(BSSRDFCache::key(other, {}), key);
+    other = params;
+    other.sigmaA.b += 1e-12;
+    EXPECT_NE(BSSRDFCache::key(other, {}), key);
+    other = params;
+    other.albedo.r = 0.25;
+    EXPECT_NE(BSSRDFCache::key(other, {}), key);
+    BSSRDFTabulateOptions options;
+    options.tableSize = 256;
+    EXPECT_NE(BSSRDFCache::key(params, options), key);
+    options = {};
+    options.integration = BSSRDFIntegration::March;
+    EXPECT_NE(BSSRDFCache::key(params, options), key);
+    options = {};
+    options.distanceWarp = BSSRDFAxisWarp::Log;
+    EXPECT_NE(BSSRDFCache::key(params, options), key);
+    options = {};
+    options.profileQuadrature = BSSRDFProfileQuadrature::Fixed;
+    EXPECT_NE(BSSRDFCache::key(params, options), key);
+}
+
+TEST_F(BSSRDFCacheTest, StoreAndLoad) {
+    BSSRDFCache cache(directory);
+    auto params = makeParams(2.0);
+    BSSRDFTabulator tabulator;
+    EXPECT_FALSE(cache.load(params, tabulator));
+    ASSERT_TRUE(cache.store(makeTable(params)));
+    ASSERT_TRUE(cache.load(params, tabulator));
+    EXPECT_EQ(tabulator.maxDistance, 2.0);
+    EXPECT_EQ(tabulator.params.sigmaA, params.sigmaA);
+    // no temp file survives a successful store
+    int files = 0;
+    for (auto& file : fs::directory_iterator(directory)) {
+        EXPECT_EQ(file.path().extension(), ".bin");
+        files++;
+    }
+    EXPECT_EQ(files, 1);
+
+    // an entry whose header disagrees with its key is treated as a miss
+    fs::copy_file(cache.entryPath(params, {}),
+                  cache.entryPath(makeParams(3.0), {}));
+    EXPECT_FALSE(cache.load(makeParams(3.0), tabulator));
+}
+
+TEST_F(BSSRDFCacheTest, EvictsLeastRecentlyUsed) {
+    auto first = makeParams(1.0), second = makeParams(2.0),
+         third = makeParams(3.0);
+    BSSRDFCache unbounded(directory);
+    ASSERT_TRUE(unbounded.store(makeTable(first)));
+    ASSERT_TRUE(unbounded.store(makeTable(second)));
+    uintmax_t entrySize = fs::file_size(unbounded.entryPath(first, {}));
+    // make the first entry the most recently used one
+    auto now = fs::file_time_type::clock::now();
+    fs::last_write_time(unbounded.entryPath(first, {}),
+                        now - chrono::minutes(1));
+    fs::last_write_time(unbounded.entryPath(second, {}),
+                        now - chrono::minutes(2));
+    BSSRDFTabulator tabulator;
+    ASSERT_TRUE(unbounded.load(first, tabulator));
+
+    BSSRDFCache cache(directory, entrySize * 2);
+    ASSERT_TRUE(cache.store(makeTable(third)));
+    EXPECT_TRUE(fs::exists(cache.entryPath(first, {})));
+    EXPECT_FALSE(fs::exists(cache.entryPath(second, {})));
+    EXPECT_TRUE(fs::exists(cache.entryPath(third, {})));
+}
+
+TEST_F(BSSRDFCacheTest, FetchBatch) {
+    BSSRDFCache cache(directory);
+    BSSRDFTabulateOptions options;
+    options.tableSize = 64;
+    vector<BSSRDFParams> params{makeParams(2.0), makeParams(4.0),
+                                makeParams(8.0)};
+    // the first table is a hit, the others are tabulated in one batch
+    auto stored = makeTable(params[0]);
+    stored.options = options;
+    ASSERT_TRUE(cache.store(stored));
+    auto tables = cache.fetch(params, options, 2);
+    ASSERT_EQ(tables.size(), params.size());
+    EXPECT_EQ(tables[0].maxDistance, stored.maxDistance);
+    for (size_t i = 0; i < params.size(); i++) {
+        EXPECT_EQ(tables[i].params, params[i]);
+        EXPECT_EQ(tables[i].options, options);
+        EXPECT_TRUE(fs::exists(cache.entryPath(params[i], options)));
+    }
+    // tabulated in the batch exactly like on their own
+    BSSRDFTabulator single(options);
+    single.tabulate(params[2], 1);
+    EXPECT_EQ(tables[2].maxDistance, single.maxDistance);
+    EXPECT_EQ(memcmp(tables[2].getTableData(), single.getTableData(),
+                     64 * 64 * sizeof(vec3)),
+              0);
+}
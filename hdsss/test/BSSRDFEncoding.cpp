@@ -0,0 +1,68 @@
+#include "BSSRDFEncoding.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "TestTables.hpp"
+using namespace std;
+using namespace glm;
+
+TEST(EncodingTest, HalfAndSharedExponent) {
+    auto table = tabulatedTestTable(128);
+    auto half = measureEncodingError(table, {BSSRDFTableEncoding::Half});
+    // 11 significant bits
+    EXPECT_LT(half.maxError, 1e-3);
+    EXPECT_LT(half.meanRelativeError, 1e-3);
+    auto shared =
+        measureEncodingError(table, {BSSRDFTableEncoding::SharedExponent});
+    // 9 bits shared by the three channels
+    EXPECT_LT(shared.maxError, 2e-2);
+    EXPECT_LT(shared.meanRelativeError, 1e-2);
+    EXPECT_GT(shared.meanRelativeError, half.meanRelativeError);
+
+    auto exact = measureEncodingError(table, {BSSRDFTableEncoding::Float32});
+    EXPECT_EQ(exact.maxError, 0.0);
+    EXPECT_EQ(encodedTableSize(512, {BSSRDFTableEncoding::Float32}),
+              512 * 512 * 12);
+    EXPECT_EQ(encodedTableSize(512, {BSSRDFTableEncoding::SharedExponent}),
+              512 * 512 * 4);
+}
+
+TEST(EncodingTest, LowRankConverges) {
+    auto table = tabulatedTestTable(128);
+    const int N = table.options.tableSize;
+    double previous = 1.0;
+    for (int rank : {1, 2, 4, 8, 16}) {
+        auto lowRank = BSSRDFLowRankTable::factorize(table, rank);
+        ASSERT_EQ(lowRank.distanceCurves.size(), size_t(rank) * N);
+        ASSERT_EQ(lowRank.areaCurves.size(), size_t(rank) * N);
+        auto error = measureEncodingError(table, lowRank.decode());
+        // the truncated SVD only gets better with every term
+        EXPECT_LE(error.rmsError, previous * 1.0001) << "rank " << rank;
+        previous = error.rmsError;
+        if (rank == 8) {
+            EXPECT_LT(error.maxError, 1e-3);
+            EXPECT_LT(error.meanRelativeError, 2e-2);
+        }
+    }
+    // rank 16 is measured at about 2e-6
+    EXPECT_LT(previous, 1e-5);
+
+    // the area curves are orthonormal per channel
+    auto lowRank = BSSRDFLowRankTable::factorize(table, 4);
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                double dot = 0.0;
+                for (int y = 0; y < N; y++) {
+                    dot += double(lowRank.areaCurves[i * N + y][c]) *
+                           lowRank.areaCurves[j * N + y][c];
+                }
+                EXPECT_NEAR(dot, i == j ? 1.0 : 0.0, 1e-5);
+            }
+        }
+    }
+    // the largest rank is down to float noise
+    auto largest = BSSRDFLowRankTable::factorize(table, BSSRDF_LOW_RANK_MAX);
+    EXPECT_LT(measureEncodingError(table, largest.decode()).maxError, 1e-5);
+}
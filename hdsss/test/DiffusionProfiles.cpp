@@ -0,0 +1,95 @@
+#include "DiffusionProfiles.hpp"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "BSSRDF.hpp"
+#include "PBDProfileKernel.hpp"
+using namespace std;
+using namespace glm;
+
+// The float instantiations run the exact expressions of
+// shaders/include/diffusion.glsl in single precision, so comparing them with
+// the double ones bounds what the shaders lose to float arithmetic
+constexpr double SHADER_ERROR = 1e-5;
+
+TEST(DiffusionProfilesTest, FresnelMomentsMatchShader) {
+    for (double eta = 0.8; eta <= 1.6; eta += 0.05) {
+        EXPECT_DOUBLE_EQ(diffusion::QC1x2(eta), QC1x2(eta));
+        EXPECT_DOUBLE_EQ(diffusion::QC2x3(eta), QC2x3(eta));
+        EXPECT_NEAR(diffusion::CPhi(float(eta)), diffusion::CPhi(eta),
+                    SHADER_ERROR);
+        // the eta > 1 fit of QC2x3 cancels terms of order 1e3
+        EXPECT_NEAR(diffusion::CE(float(eta)), diffusion::CE(eta), 1e-4);
+    }
+    // 1 / 4 (1 - 2 C1) at eta = 1.3
+    EXPECT_NEAR(diffusion::CPhi(1.3), 0.25 * (1 - 0.445294669089997),
+                SHADER_ERROR);
+}
+
+TEST(DiffusionProfilesTest, FresnelTransmittanceMatchesShader) {
+    for (double eta : {1.3, 1.5}) {
+        // normal incidence reduces to 1 - ((eta - 1) / (eta + 1))^2
+        double R0 = (eta - 1) * (eta - 1) / ((eta + 1) * (eta + 1));
+        EXPECT_NEAR(diffusion::fresnelTransmittance(1.0, eta), 1 - R0, 1e-12);
+        for (int i = 0; i <= 64; i++) {
+            double cosTheta = i / 64.0;
+            double expected = diffusion::fresnelTransmittance(cosTheta, eta);
+            EXPECT_GE(expected, 0.0);
+            EXPECT_LE(expected, 1.0);
+            EXPECT_NEAR(
+                diffusion::fresnelTransmittance(float(cosTheta), float(eta)),
+                expected, SHADER_ERROR)
+                << "eta " << eta << ", cos " << cosTheta;
+        }
+    }
+}
+
+TEST(DiffusionProfilesTest, DipoleMatchesShader) {
+    // skin parameters in mm^-1
+    dvec3 sigmaSPrime(0.74, 0.88, 1.01), sigmaA(0.032, 0.17, 0.48);
+    for (int i = 0; i <= 64; i++) {
+        double r = 1e-3 * pow(1e4, i / 64.0);
+        dvec3 expected =
+            diffusion::dipoleRadiantExitance(r * r, sigmaSPrime, sigmaA, 1.5);
+        vec3 value = diffusion::dipoleRadiantExitance(
+            float(r * r), vec3(sigmaSPrime), vec3(sigmaA), 1.5f);
+        for (int c = 0; c < 3; c++) {
+            ASSERT_GT(expected[c], 0.0);
+            EXPECT_NEAR(value[c] / expected[c], 1.0, 1e-4)
+                << "r = " << r << ", channel " << c;
+        }
+    }
+}
+
+TEST(DiffusionProfilesTest, PBDResponseMatchesShader) {
+    auto c = pbd::profileConstants(dvec3(0.021, 0.041, 0.071),
+                                   dvec3(21.9, 26.2, 20.1), 1.3);
+    for (int ch = 0; ch < 3; ch++) {
+        for (int i = 0; i <= 32; i++) {
+            double r = 1e-4 * pow(1e4, i / 32.0);
+            for (int j = 0; j <= 32; j++) {
+                // down to the depths where 1 - exp(-x) would cancel in float
+                double t = 1e-6 * pow(1e6, j / 32.0);
+                double expected = diffusion::pbdResponse(
+                    r * r, t, c.sigmaT[ch], c.sigmaTr[ch], c.alpha[ch],
+                    c.Dg[ch], c.zb[ch], c.Cphi, c.CE);
+                float value = diffusion::pbdResponse(
+                    float(r * r), float(t), float(c.sigmaT[ch]),
+                    float(c.sigmaTr[ch]), float(c.alpha[ch]), float(c.Dg[ch]),
+                    float(c.zb[ch]), float(c.Cphi), float(c.CE));
+                if (expected < 1e-30)
+                    continue;
+                EXPECT_NEAR(value / expected, 1.0, 1e-3)
+                    << "r = " << r << ", t = " << t << ", channel " << ch;
+            }
+        }
+    }
+}
+
+TEST(DiffusionProfilesTest, SeriesMatchesExp) {
+    // both branches of the shader version meet at the threshold
+    for (double x : {1e-8, 1e-5, 9.99e-4, 1e-3, 1e-2}) {
+        EXPECT_NEAR(diffusion::oneMinusExp(float(x)) / -expm1(-x), 1.0, 1e-4);
+    }
+    EXPECT_NEAR(diffusion::oneMinusExp(1e-3) / -expm1(-1e-3), 1.0, 1e-12);
+}
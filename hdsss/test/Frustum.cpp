@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <loo/Frustum.hpp>
+using namespace std;
+using namespace glm;
+using namespace loo;
+
+namespace {
+BoundingBox boxAt(const vec3& center, float halfSize) {
+    return {center - vec3(halfSize), center + vec3(halfSize)};
+}
+}  // namespace
+
+TEST(FrustumTest, TransformedBoxEnclosesTheCorners) {
+    BoundingBox box{vec3(-1.0f, -2.0f, 0.0f), vec3(1.0f, 2.0f, 1.0f)};
+    mat4 transform = translate(mat4(1.0f), vec3(10.0f, 0.0f, 0.0f));
+    transform = rotate(transform, radians(90.0f), vec3(0, 0, 1));
+    auto moved = box.transformed(transform);
+    EXPECT_NEAR(moved.min.x, 8.0f, 1e-5f);
+    EXPECT_NEAR(moved.max.x, 12.0f, 1e-5f);
+    EXPECT_NEAR(moved.min.y, -1.0f, 1e-5f);
+    EXPECT_NEAR(moved.max.y, 1.0f, 1e-5f);
+    EXPECT_NEAR(moved.min.z, 0.0f, 1e-5f);
+    EXPECT_NEAR(moved.max.z, 1.0f, 1e-5f);
+    // rotated by 45 degrees the box grows to hold the corners
+    auto rotated = box.transformed(rotate(mat4(1.0f), radians(45.0f),
+                                          vec3(0, 0, 1)));
+    EXPECT_NEAR(rotated.max.x, 1.5f * sqrt(2.0f), 1e-5f);
+}
+
+TEST(FrustumTest, CullsAgainstACamera) {
+    mat4 view = lookAt(vec3(0, 0, 5), vec3(0), vec3(0, 1, 0));
+    mat4 projection = perspective(radians(60.0f), 1.0f, 0.1f, 100.0f);
+    auto frustum = Frustum::fromMatrix(projection * view);
+    EXPECT_TRUE(frustum.intersects(boxAt(vec3(0), 1.0f)));
+    // behind the camera, beyond the far plane and off to the sides
+    EXPECT_FALSE(frustum.intersects(boxAt(vec3(0, 0, 8), 1.0f)));
+    EXPECT_FALSE(frustum.intersects(boxAt(vec3(0, 0, -200), 1.0f)));
+    EXPECT_FALSE(frustum.intersects(boxAt(vec3(-20, 0, 0), 1.0f)));
+    EXPECT_FALSE(frustum.intersects(boxAt(vec3(0, 20, 0), 1.0f)));
+    // partly inside
+    EXPECT_TRUE(frustum.intersects(boxAt(vec3(0, 0, 5), 1.0f)));
+    EXPECT_TRUE(frustum.intersects(boxAt(vec3(3.5f, 0, 0), 1.0f)));
+}
+
+TEST(FrustumTest, InflatedKeepsBoxesWithinTheMargin) {
+    mat4 light = ortho(-1.5f, 1.5f, -1.5f, 1.5f, -1.5f, 1.5f) *
+                 lookAt(vec3(0), vec3(-1, 0, 0), vec3(0, 1, 0));
+    auto frustum = Frustum::fromMatrix(light);
+    // half a unit past the top plane of the box
+    auto box = boxAt(vec3(0, 2.5f, 0), 0.5f);
+    EXPECT_FALSE(frustum.intersects(box));
+    EXPECT_FALSE(frustum.inflated(0.4f).intersects(box));
+    EXPECT_TRUE(frustum.inflated(0.6f).intersects(box));
+    EXPECT_TRUE(frustum.intersects(boxAt(vec3(1.0f, 0, 1.0f), 0.1f)));
+}
+
+TEST(FrustumTest, EyeOfTheProjection) {
+    mat4 view = lookAt(vec3(1, 2, 5), vec3(0), vec3(0, 1, 0));
+    auto frustum = Frustum::fromMatrix(
+        perspective(radians(60.0f), 1.0f, 0.1f, 100.0f) * view);
+    EXPECT_NEAR(frustum.eye.x, 1.0f, 1e-3f);
+    EXPECT_NEAR(frustum.eye.y, 2.0f, 1e-3f);
+    EXPECT_NEAR(frustum.eye.z, 5.0f, 1e-3f);
+    EXPECT_EQ(frustum.eye.w, 1.0f);
+    // orthographic, the direction the light looks into
+    auto light = Frustum::fromMatrix(
+        ortho(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f) *
+        lookAt(vec3(0), vec3(-1, 0, 0), vec3(0, 1, 0)));
+    EXPECT_NEAR(light.eye.x, -1.0f, 1e-5f);
+    EXPECT_NEAR(light.eye.y, 0.0f, 1e-5f);
+    EXPECT_NEAR(light.eye.z, 0.0f, 1e-5f);
+    EXPECT_EQ(light.eye.w, 0.0f);
+}
+
+TEST(FrustumTest, SpheresAndConesInObjectSpace) {
+    mat4 view = lookAt(vec3(0, 0, 5), vec3(0), vec3(0, 1, 0));
+    auto frustum = Frustum::fromMatrix(
+        perspective(radians(60.0f), 1.0f, 0.1f, 100.0f) * view);
+    EXPECT_TRUE(frustum.intersects(vec3(0), 1.0f));
+    EXPECT_FALSE(frustum.intersects(vec3(0, 0, 8), 1.0f));
+    EXPECT_TRUE(frustum.intersects(vec3(0, 0, 8), 4.0f));
+
+    // the object moved 10 to the left and scaled up twice
+    mat4 model = scale(translate(mat4(1.0f), vec3(-10, 0, 0)), vec3(2.0f));
+    auto object = frustum.toObjectSpace(model);
+    EXPECT_FALSE(object.intersects(vec3(0), 1.0f));
+    EXPECT_TRUE(object.intersects(vec3(5, 0, 0), 0.5f));
+    // 1 behind the camera, 1.1 from the near plane in world space
+    EXPECT_FALSE(object.intersects(vec3(5, 0, 3), 0.5f));
+    EXPECT_TRUE(object.intersects(vec3(5, 0, 3), 0.6f));
+    EXPECT_NEAR(object.eye.x, 5.0f, 1e-3f);
+    EXPECT_NEAR(object.eye.z, 2.5f, 1e-3f);
+
+    // a cluster facing -z is seen from behind by the camera at +z, one
+    // facing +z is not. meshoptimizer gives clusters with normals spread
+    // too wide a zero axis and a cutoff of 1
+    vec3 apex(0);
+    EXPECT_TRUE(frustum.backfacing(apex, vec3(0, 0, -1), 0.5f));
+    EXPECT_FALSE(frustum.backfacing(apex, vec3(0, 0, 1), 0.5f));
+    EXPECT_FALSE(frustum.backfacing(apex, vec3(0), 1.0f));
+    auto light = Frustum::fromMatrix(
+        ortho(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f) *
+        lookAt(vec3(0), vec3(-1, 0, 0), vec3(0, 1, 0)));
+    EXPECT_TRUE(light.backfacing(vec3(0, 5, 0), vec3(-1, 0, 0), 0.5f));
+    EXPECT_FALSE(light.backfacing(vec3(0, 5, 0), vec3(1, 0, 0), 0.5f));
+}
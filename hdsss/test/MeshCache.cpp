@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <loo/MeshCache.hpp>
+#include <memory>
+#include <vector>
+using namespace std;
+using namespace glm;
+using namespace loo;
+namespace fs = std::filesystem;
+
+class MeshCacheTest : public testing::Test {
+   protected:
+    fs::path directory = fs::temp_directory_path() / "hdsss_mesh_cache_test";
+    fs::path model = directory / "model.obj";
+    fs::path entryPath = directory / "entry.loomesh";
+    void SetUp() override {
+        fs::remove_all(directory);
+        fs::create_directories(directory);
+        ofstream(model) << "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+    }
+    void TearDown() override { fs::remove_all(directory); }
+
+    // vertexCount vertices and triangles of consecutive ones
+    static shared_ptr<Mesh> makeMesh(int vertexCount, const string& name) {
+        vector<Vertex> vertices(vertexCount);
+        vector<unsigned int> indices;
+        for (int i = 0; i < vertexCount; i++) {
+            vertices[i] = Vertex{};
+            vertices[i].position = vec3(i, 2 * i, 3 * i);
+            vertices[i].texCoord = vec2(i, -i);
+        }
+        for (int i = 0; i + 2 < vertexCount; i++)
+            indices.insert(indices.end(), {unsigned(i), unsigned(i + 1),
+                                           unsigned(i + 2)});
+        return make_shared<Mesh>(std::move(vertices), std::move(indices),
+                                 nullptr, name,
+                                 translate(mat4(1.0f), vec3(vertexCount)));
+    }
+};
+
+TEST_F(MeshCacheTest, KeyCoversEveryInput) {
+    const unsigned int flags = 0x8;
+    string key = meshCacheKey(model.string(), flags, mat4(1.0f), {});
+    EXPECT_EQ(key.size(), 64u);
+    EXPECT_EQ(key, meshCacheKey(model.string(), flags, mat4(1.0f), {}));
+    EXPECT_NE(meshCacheKey(model.string(), flags | 0x1, mat4(1.0f), {}),
+              key);
+    EXPECT_NE(meshCacheKey(model.string(), flags, mat4(2.0f), {}), key);
+    MeshOptimizeOptions options;
+    options.overdrawThreshold = 0.0f;
+    EXPECT_NE(meshCacheKey(model.string(), flags, mat4(1.0f), options), key);
+    ofstream(model, ios::app) << "f 3 2 1\n";
+    EXPECT_NE(meshCacheKey(model.string(), flags, mat4(1.0f), {}), key);
+    EXPECT_EQ(meshCacheKey((directory / "missing.obj").string(), flags,
+                           mat4(1.0f), {}),
+              "");
+}
+
+TEST_F(MeshCacheTest, RoundTripMapsTheArrays) {
+    vector<shared_ptr<Mesh>> meshes{makeMesh(5, "first"), makeMesh(0, ""),
+                                    makeMesh(9, "third")};
+    meshes[2]->lods = {{0, 15, 0.0f}, {15, 6, 0.125f}};
+    Meshlet meshlet;
+    meshlet.indexOffset = 6;
+    meshlet.indexCount = 9;
+    meshlet.center = vec3(1, 2, 3);
+    meshlet.radius = 4.0f;
+    meshlet.coneAxis = vec3(0, 1, 0);
+    meshlet.coneCutoff = 0.5f;
+    meshes[2]->meshlets = {{0, 6}, meshlet};
+    meshes[0]->instances = {mat4(1.0f),
+                            translate(mat4(1.0f), vec3(0.0f, 2.0f, 0.0f))};
+    vector<BaseMaterialDescription> materials(2);
+    materials[1].mrWorkFlow.metallic = 0.25f;
+    materials[1].texturePaths[int(BaseMaterialTexture::Normal)] =
+        "textures/normal.png";
+    string key(64, 'a');
+    ASSERT_TRUE(saveMeshCache(entryPath, key, materials, meshes, {1, 0, 1}));
+
+    MeshCacheEntry entry;
+    ASSERT_TRUE(loadMeshCache(entryPath, key, entry));
+    ASSERT_EQ(entry.materials.size(), 2u);
+    EXPECT_EQ(entry.materials[1].mrWorkFlow.metallic, 0.25f);
+    EXPECT_EQ(entry.materials[1].texturePaths[int(BaseMaterialTexture::Normal)],
+              "textures/normal.png");
+    EXPECT_EQ(entry.materials[0].texturePaths[int(BaseMaterialTexture::Normal)],
+              "");
+    ASSERT_EQ(entry.meshes.size(), meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const auto& record = entry.meshes[i];
+        EXPECT_EQ(record.name, meshes[i]->name);
+        EXPECT_EQ(record.material, i == 1 ? 0u : 1u);
+        EXPECT_EQ(record.transform, meshes[i]->objectMatrix);
+        ASSERT_EQ(record.vertexCount, meshes[i]->vertices.size());
+        ASSERT_EQ(record.indexCount, meshes[i]->indices.size());
+        EXPECT_EQ(memcmp(record.vertices, meshes[i]->vertices.data(),
+                         record.vertexCount * sizeof(Vertex)),
+                  0);
+        EXPECT_EQ(memcmp(record.indices, meshes[i]->indices.data(),
+                         record.indexCount * sizeof(unsigned int)),
+                  0);
+        ASSERT_EQ(record.lods.size(), meshes[i]->lods.size());
+        for (size_t lod = 0; lod < record.lods.size(); lod++) {
+            EXPECT_EQ(record.lods[lod].indexOffset,
+                      meshes[i]->lods[lod].indexOffset);
+            EXPECT_EQ(record.lods[lod].indexCount,
+                      meshes[i]->lods[lod].indexCount);
+            EXPECT_EQ(record.lods[lod].error, meshes[i]->lods[lod].error);
+        }
+        ASSERT_EQ(record.meshlets.size(), meshes[i]->meshlets.size());
+        for (size_t k = 0; k < record.meshlets.size(); k++) {
+            const auto &stored = record.meshlets[k],
+                       &original = meshes[i]->meshlets[k];
+            EXPECT_EQ(stored.indexOffset, original.indexOffset);
+            EXPECT_EQ(stored.indexCount, original.indexCount);
+            EXPECT_EQ(stored.center, original.center);
+            EXPECT_EQ(stored.radius, original.radius);
+            EXPECT_EQ(stored.coneAxis, original.coneAxis);
+            EXPECT_EQ(stored.coneCutoff, original.coneCutoff);
+        }
+        EXPECT_EQ(record.instances, meshes[i]->instances);
+        // used in place, the arrays must lie inside the mapping
+        auto begin = entry.mapping->data(),
+             end = entry.mapping->data() + entry.mapping->size();
+        if (record.vertexCount) {
+            EXPECT_GE((const unsigned char*)record.vertices, begin);
+            EXPECT_LE((const unsigned char*)(record.vertices +
+                                             record.vertexCount),
+                      end);
+        }
+    }
+    // a mesh built on the entry reads the mapped arrays
+    const auto& third = entry.meshes[2];
+    Mesh mapped(entry.mapping, third.vertices, third.vertexCount,
+                third.indices, third.indexCount, nullptr, third.name,
+                third.transform);
+    EXPECT_TRUE(mapped.isMapped());
+    EXPECT_TRUE(mapped.vertices.empty());
+    EXPECT_EQ(mapped.countVertex(), 9u);
+    EXPECT_EQ(mapped.countTriangles(), 7u);
+    EXPECT_EQ(mapped.getVertexData()[4].position, vec3(4, 8, 12));
+}
+
+TEST_F(MeshCacheTest, RejectsForeignAndDamagedEntries) {
+    vector<shared_ptr<Mesh>> meshes{makeMesh(6, "mesh")};
+    vector<BaseMaterialDescription> materials(1);
+    string key(64, 'a');
+    ASSERT_TRUE(saveMeshCache(entryPath, key, materials, meshes, {0}));
+    MeshCacheEntry entry;
+    EXPECT_FALSE(loadMeshCache(entryPath, string(64, 'b'), entry));
+    EXPECT_FALSE(loadMeshCache(directory / "missing.loomesh", key, entry));
+
+    // a flipped byte in the metadata
+    auto damaged = directory / "damaged.loomesh";
+    fs::copy_file(entryPath, damaged);
+    {
+        fstream file(damaged, ios::in | ios::out | ios::binary);
+        file.seekp(130);
+        file.put('\x7f');
+    }
+    EXPECT_FALSE(loadMeshCache(damaged, key, entry));
+    // arrays cut short
+    fs::resize_file(entryPath, fs::file_size(entryPath) - 4);
+    EXPECT_FALSE(loadMeshCache(entryPath, key, entry));
+    EXPECT_TRUE(entry.meshes.empty());
+    // a level of detail past the indices
+    meshes[0]->lods = {{0, 12, 0.0f}, {9, 6, 0.5f}};
+    ASSERT_TRUE(saveMeshCache(entryPath, key, materials, meshes, {0}));
+    EXPECT_FALSE(loadMeshCache(entryPath, key, entry));
+    // or a meshlet
+    meshes[0]->lods.clear();
+    meshes[0]->meshlets = {{0, 9}, {9, 6}};
+    ASSERT_TRUE(saveMeshCache(entryPath, key, materials, meshes, {0}));
+    EXPECT_FALSE(loadMeshCache(entryPath, key, entry));
+    meshes[0]->meshlets.pop_back();
+    ASSERT_TRUE(saveMeshCache(entryPath, key, materials, meshes, {0}));
+    EXPECT_TRUE(loadMeshCache(entryPath, key, entry));
+    // an index past the vertices
+    meshes[0]->indices[4] = 6;
+    ASSERT_TRUE(saveMeshCache(entryPath, key, materials, meshes, {0}));
+    EXPECT_FALSE(loadMeshCache(entryPath, key, entry));
+}
+
+TEST_F(MeshCacheTest, StaleOnceADependencyChanges) {
+    // what an import of model.obj opens: the model itself, its material
+    // library twice and a buffer in a subdirectory
+    fs::create_directories(directory / "buffers");
+    auto library = directory / "model.mtl";
+    auto buffer = directory / "buffers" / "a.bin";
+    ofstream(library) << "newmtl skin\nKd 0.8 0.5 0.4\n";
+    ofstream(buffer) << "geometry";
+    auto dependencies = hashMeshCacheDependencies(
+        {model.string(), library.string(), (directory / "./model.mtl").string(),
+         buffer.string()},
+        model);
+    ASSERT_EQ(dependencies.size(), 2u);
+    EXPECT_EQ(dependencies[0].path, "model.mtl");
+    EXPECT_EQ(dependencies[1].path, "buffers/a.bin");
+
+    string key(64, 'd');
+    ASSERT_TRUE(saveMeshCache(entryPath, key, {BaseMaterialDescription{}},
+                              {makeMesh(3, "mesh")}, {0}, dependencies));
+    MeshCacheEntry entry;
+    ASSERT_TRUE(loadMeshCache(entryPath, key, entry));
+    ASSERT_EQ(entry.dependencies.size(), 2u);
+    EXPECT_EQ(entry.dependencies[1].path, "buffers/a.bin");
+    EXPECT_EQ(entry.dependencies[1].digest, dependencies[1].digest);
+    EXPECT_TRUE(checkMeshCacheDependencies(entry, model));
+    // the key only covers the model file
+    ofstream(library, ios::app) << "Ks 0.1 0.1 0.1\n";
+    EXPECT_FALSE(checkMeshCacheDependencies(entry, model));
+    ofstream(library) << "newmtl skin\nKd 0.8 0.5 0.4\n";
+    EXPECT_TRUE(checkMeshCacheDependencies(entry, model));
+    fs::remove(buffer);
+    EXPECT_FALSE(checkMeshCacheDependencies(entry, model));
+}
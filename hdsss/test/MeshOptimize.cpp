@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <glm/gtc/matrix_transform.hpp>
+#include <loo/Mesh.hpp>
+#include <tuple>
+#include <vector>
+using namespace std;
+using namespace glm;
+using namespace loo;
+
+namespace {
+// n x n quads split into triangles, every corner its own vertex like the
+// assimp import before welding
+Mesh unweldedGrid(int n) {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    auto corner = [&](int x, int y) {
+        Vertex vertex{};
+        vertex.position = vec3(x, y, 0);
+        vertex.normal = vec3(0, 0, 1);
+        vertex.texCoord = vec2(x, y) / float(n);
+        indices.push_back(vertices.size());
+        vertices.push_back(vertex);
+    };
+    const int quad[6][2]{{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}};
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            for (const auto& offset : quad)
+                corner(x + offset[0], y + offset[1]);
+        }
+    }
+    return Mesh(std::move(vertices), std::move(indices), nullptr, "grid",
+                mat4(1.0f));
+}
+
+// triangles of the full level by their corner positions, rotated to start
+// at the smallest corner so the winding is kept but the first corner does
+// not matter
+vector<array<vec3, 3>> triangles(const Mesh& mesh) {
+    auto less = [](const vec3& a, const vec3& b) {
+        return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    };
+    vector<array<vec3, 3>> result;
+    auto full = mesh.getLod(0);
+    for (size_t i = full.indexOffset; i < full.indexOffset + full.indexCount;
+         i += 3) {
+        array<vec3, 3> triangle;
+        for (int k = 0; k < 3; k++)
+            triangle[k] = mesh.vertices[mesh.indices[i + k]].position;
+        auto first = std::min_element(triangle.begin(), triangle.end(), less);
+        std::rotate(triangle.begin(), first, triangle.end());
+        result.push_back(triangle);
+    }
+    std::sort(result.begin(), result.end(), [&](const auto& a, const auto& b) {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(),
+                                            b.end(), less);
+    });
+    return result;
+}
+}  // namespace
+
+TEST(MeshOptimizeTest, WeldsAndKeepsTriangles) {
+    const int n = 32;
+    auto mesh = unweldedGrid(n);
+    auto reference = triangles(mesh);
+    auto before = analyzeMeshCache(mesh);
+    optimizeMesh(mesh, MeshOptimizeOptions{});
+    EXPECT_EQ(mesh.countVertex(), size_t((n + 1) * (n + 1)));
+    EXPECT_EQ(triangles(mesh), reference);
+    for (auto index : mesh.indices)
+        EXPECT_LT(index, mesh.vertices.size());
+    auto after = analyzeMeshCache(mesh);
+    // every corner is transformed before welding
+    EXPECT_FLOAT_EQ(before.acmr, 3.0f);
+    EXPECT_LT(after.acmr, 1.0f);
+    EXPECT_LT(after.atvr, 1.6f);
+}
+
+TEST(MeshOptimizeTest, StagesCanBeDisabled) {
+    auto mesh = unweldedGrid(4);
+    auto vertices = mesh.vertices;
+    auto indices = mesh.indices;
+    optimizeMesh(mesh, MeshOptimizeOptions{false, false, 0.0f, false, 0});
+    EXPECT_EQ(mesh.vertices, vertices);
+    EXPECT_EQ(mesh.indices, indices);
+    EXPECT_TRUE(mesh.lods.empty());
+}
+
+TEST(MeshOptimizeTest, LodChainOfAPlane) {
+    auto mesh = unweldedGrid(32);
+    MeshOptimizeOptions options;
+    optimizeMesh(mesh, options);
+    ASSERT_EQ(mesh.countLod(), options.lodLevels + 1);
+    EXPECT_EQ(mesh.lods[0].indexOffset, 0u);
+    EXPECT_EQ(mesh.lods[0].indexCount, 32u * 32u * 6u);
+    EXPECT_EQ(mesh.lods[0].error, 0.0f);
+    for (size_t i = 1; i < mesh.lods.size(); i++) {
+        const auto &lod = mesh.lods[i], &previous = mesh.lods[i - 1];
+        EXPECT_EQ(lod.indexOffset, previous.indexOffset + previous.indexCount);
+        EXPECT_EQ(lod.indexCount % 3, 0u);
+        EXPECT_LE(lod.indexCount, previous.indexCount * 9 / 10);
+        EXPECT_LE(lod.error, options.lodMaxError);
+    }
+    const auto& last = mesh.lods.back();
+    EXPECT_EQ(mesh.indices.size(), last.indexOffset + last.indexCount);
+    for (auto index : mesh.indices)
+        EXPECT_LT(index, mesh.vertices.size());
+}
+
+TEST(MeshOptimizeTest, NoLodBeyondTheErrorBound) {
+    // a rough height field, every collapse shows
+    auto mesh = unweldedGrid(16);
+    for (auto& vertex : mesh.vertices) {
+        auto p = vertex.position;
+        vertex.position.z =
+            fract(sin(p.x * 12.9898f + p.y * 78.233f) * 43758.5453f);
+    }
+    MeshOptimizeOptions options;
+    options.lodMaxError = 1e-5f;
+    optimizeMesh(mesh, options);
+    EXPECT_TRUE(mesh.lods.empty());
+    EXPECT_EQ(mesh.countLod(), 1u);
+    EXPECT_EQ(mesh.countTriangles(), 16u * 16u * 2u);
+    EXPECT_EQ(mesh.indices.size(), 16u * 16u * 6u);
+}
+
+TEST(MeshOptimizeTest, SelectsLodByProjectedError) {
+    vector<unsigned int> indices(51);
+    Mesh mesh({}, std::move(indices), nullptr, "lods", mat4(1.0f));
+    EXPECT_EQ(mesh.countLod(), 1u);
+    EXPECT_EQ(mesh.getLod(0).indexCount, 51u);
+    EXPECT_EQ(mesh.selectLod(1.0f), 0);
+
+    mesh.lods = {{0, 30, 0.0f}, {30, 15, 0.01f}, {45, 6, 0.05f}};
+    // the full mesh until the first projection
+    EXPECT_EQ(mesh.selectLod(1e-3f), 0);
+    mesh.updateLod(0.05f);
+    // projected errors of 5e-4 and 2.5e-3
+    EXPECT_EQ(mesh.selectLod(0.0f), 0);
+    EXPECT_EQ(mesh.selectLod(1e-3f), 1);
+    EXPECT_EQ(mesh.selectLod(4e-3f), 2);
+    EXPECT_EQ(mesh.countTriangles(1), 5u);
+    // out of range levels clamp to the chain
+    EXPECT_EQ(mesh.countTriangles(7), 2u);
+    EXPECT_EQ(mesh.getLod(-1).indexCount, 30u);
+}
+
+TEST(MeshOptimizeTest, MeshletsCoverTheFullLevel) {
+    const int n = 32;
+    auto mesh = unweldedGrid(n);
+    auto reference = triangles(mesh);
+    MeshOptimizeOptions options;
+    options.meshlets = true;
+    optimizeMesh(mesh, options);
+    EXPECT_EQ(triangles(mesh), reference);
+    ASSERT_GE(mesh.meshlets.size(), size_t(n * n * 2 / 124));
+    uint32_t offset = 0;
+    for (const auto& meshlet : mesh.meshlets) {
+        EXPECT_EQ(meshlet.indexOffset, offset);
+        EXPECT_EQ(meshlet.indexCount % 3, 0u);
+        EXPECT_LE(meshlet.indexCount, 124u * 3u);
+        // every corner inside the bounding sphere, every normal is +z
+        for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+            auto p = mesh.vertices[mesh.indices[offset + i]].position;
+            EXPECT_LE(distance(p, meshlet.center), meshlet.radius * 1.001f);
+        }
+        EXPECT_GT(meshlet.coneAxis.z, 0.99f);
+        offset += meshlet.indexCount;
+    }
+    EXPECT_EQ(offset, mesh.getLod(0).indexCount);
+}
+
+TEST(MeshOptimizeTest, CullsMeshletsIntoMergedRanges) {
+    Mesh mesh({}, vector<unsigned int>(36), nullptr, "meshlets", mat4(1.0f));
+    // four clusters along x facing +z, the third one facing -z
+    for (int i = 0; i < 4; i++) {
+        Meshlet meshlet;
+        meshlet.indexOffset = 9 * i;
+        meshlet.indexCount = 9;
+        meshlet.center = meshlet.coneApex = vec3(4 * i, 0, 0);
+        meshlet.radius = 1.0f;
+        meshlet.coneAxis = vec3(0, 0, i == 2 ? -1 : 1);
+        meshlet.coneCutoff = 0.5f;
+        mesh.meshlets.push_back(meshlet);
+    }
+    // sees x in about [-1, 9] at z = 0
+    Frustum frustum = Frustum::fromMatrix(
+        ortho(-1.0f, 9.0f, -1.0f, 1.0f, 0.1f, 100.0f) *
+        lookAt(vec3(0, 0, 10), vec3(0), vec3(0, 1, 0)));
+    vector<IndexRange> ranges;
+    EXPECT_EQ(mesh.cullMeshlets(frustum, false, ranges), 3u);
+    ASSERT_EQ(ranges.size(), 1u);
+    EXPECT_EQ(ranges[0].indexOffset, 0u);
+    EXPECT_EQ(ranges[0].indexCount, 27u);
+
+    ranges = {{100, 3}};
+    EXPECT_EQ(mesh.cullMeshlets(frustum, true, ranges), 2u);
+    ASSERT_EQ(ranges.size(), 2u);
+    EXPECT_EQ(ranges[0].indexOffset, 100u);
+    EXPECT_EQ(ranges[1].indexOffset, 0u);
+    EXPECT_EQ(ranges[1].indexCount, 18u);
+}
+
+TEST(MeshOptimizeTest, InstancesFollowTheObjectMatrix) {
+    mat4 object = translate(mat4(1.0f), vec3(0, 0, 5));
+    Mesh mesh({}, vector<unsigned int>(6), nullptr, "instanced", object);
+    EXPECT_EQ(mesh.countInstances(), 1u);
+    EXPECT_EQ(mesh.getInstanceMatrix(0), object);
+    EXPECT_EQ(mesh.countTriangles(), 2u);
+
+    mesh.instances = {translate(mat4(1.0f), vec3(1, 0, 0)),
+                      scale(mat4(1.0f), vec3(2.0f))};
+    EXPECT_EQ(mesh.countInstances(), 2u);
+    // the instance first, then the object matrix
+    EXPECT_EQ(vec3(mesh.getInstanceMatrix(0) * vec4(0, 0, 0, 1)),
+              vec3(1, 0, 5));
+    EXPECT_EQ(vec3(mesh.getInstanceMatrix(1) * vec4(1, 1, 1, 1)),
+              vec3(2, 2, 7));
+}
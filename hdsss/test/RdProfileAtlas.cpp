@@ -0,0 +1,54 @@
+#include "RdProfileAtlas.hpp"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "PBRMaterials.hpp"
+using namespace std;
+using namespace glm;
+
+namespace {
+BSSRDFParams profile(double sigmaT, double albedo) {
+    BSSRDFParams params;
+    params.sigmaT = dvec3(sigmaT);
+    params.albedo = dvec3(albedo);
+    params.sigmaA = params.sigmaT * (1.0 - params.albedo);
+    return params;
+}
+}  // namespace
+
+TEST(RdProfileAtlasTest, EqualParametersShareALayer) {
+    vector<BSSRDFParams> profiles;
+    EXPECT_EQ(assignRdProfileLayer(profiles, profile(1.0, 0.5)), 0);
+    EXPECT_EQ(assignRdProfileLayer(profiles, profile(2.0, 0.5)), 1);
+    EXPECT_EQ(assignRdProfileLayer(profiles, profile(1.0, 0.5)), 0);
+    EXPECT_EQ(profiles.size(), 2u);
+}
+
+TEST(RdProfileAtlasTest, ExcessProfilesShareTheClosestLayer) {
+    vector<BSSRDFParams> profiles;
+    // sigma_t of 1, 2, 4, ... doubling every layer
+    for (int i = 0; i < RD_PROFILE_MAX_LAYERS; i++) {
+        EXPECT_EQ(assignRdProfileLayer(profiles, profile(exp2(i), 0.5)), i);
+    }
+    // a valid scene past the limit keeps loading
+    EXPECT_EQ(assignRdProfileLayer(profiles, profile(exp2(10.2), 0.5)), 10);
+    EXPECT_EQ(assignRdProfileLayer(profiles, profile(exp2(3.9), 0.52)), 4);
+    EXPECT_EQ(assignRdProfileLayer(profiles, profile(1e-9, 0.5)), 0);
+    EXPECT_EQ(profiles.size(), size_t(RD_PROFILE_MAX_LAYERS));
+    // the existing ones still find their own layer
+    EXPECT_EQ(assignRdProfileLayer(profiles, profile(exp2(7), 0.5)), 7);
+}
+
+TEST(RdProfileAtlasTest, SecondMaterialReadsItsOwnLayer) {
+    vector<BSSRDFParams> profiles;
+    ShaderPBRMetallicMaterial skin(vec3(1), 0, 1, vec3(1), vec3(0.5), 0.5);
+    ShaderPBRMetallicMaterial marble(vec3(1), 0, 1, vec3(2), vec3(1), 0.5);
+    skin.rdProfileLayer = assignRdProfileLayer(profiles, profile(1.0, 0.5));
+    marble.rdProfileLayer = assignRdProfileLayer(profiles, profile(2.0, 0.5));
+    EXPECT_NE(skin.rdProfileLayer, marble.rdProfileLayer);
+    // the G-buffer pass reads the layer at its std140 offset
+    int layer = -1;
+    memcpy(&layer, reinterpret_cast<const char*>(&marble) + 48, sizeof(int));
+    EXPECT_EQ(layer, 1);
+}
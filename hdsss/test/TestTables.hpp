@@ -0,0 +1,25 @@
+#ifndef HDSSS_TEST_TEST_TABLES_HPP
+#define HDSSS_TEST_TEST_TABLES_HPP
+#include "BSSRDF.hpp"
+
+// the medium the table tests share, sigma_t of 4 with a different albedo
+// per channel
+inline BSSRDFParams testTableParams() {
+    BSSRDFParams params;
+    params.sigmaT = glm::dvec3(4.0);
+    params.albedo = glm::dvec3(0.3, 0.9, 0.6);
+    params.sigmaA = params.sigmaT - params.sigmaT * params.albedo;
+    return params;
+}
+
+// testTableParams() tabulated with size x size cells and otherwise the
+// given options
+inline BSSRDFTabulator tabulatedTestTable(int size,
+                                          BSSRDFTabulateOptions options = {}) {
+    options.tableSize = size;
+    BSSRDFTabulator table(options);
+    table.tabulate(testTableParams());
+    return table;
+}
+
+#endif /* HDSSS_TEST_TEST_TABLES_HPP */
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <loo/VertexFormat.hpp>
+#include <random>
+#include <vector>
+using namespace std;
+using namespace glm;
+using namespace loo;
+
+namespace {
+vec3 randomDirection(mt19937& rng) {
+    normal_distribution<float> gaussian;
+    vec3 v;
+    do {
+        v = vec3(gaussian(rng), gaussian(rng), gaussian(rng));
+    } while (length(v) < 1e-3f);
+    return normalize(v);
+}
+
+// in double, acos of a float cosine can't resolve the small angles
+float angleBetween(const vec3& a, const vec3& b) {
+    dvec3 u(a), v(b);
+    return atan2(length(cross(u, v)), dot(u, v));
+}
+
+// a vertex like the import leaves it, with an orthonormal tangent frame
+Vertex randomVertex(mt19937& rng) {
+    uniform_real_distribution<float> box(-3.0f, 5.0f), uv(-1.0f, 2.0f);
+    Vertex vertex{};
+    vertex.position = vec3(box(rng), 0.1f * box(rng), box(rng));
+    vertex.normal = randomDirection(rng);
+    vertex.tangent = randomDirection(rng);
+    vertex.bitangent = randomDirection(rng);
+    vertex.texCoord = vec2(uv(rng), uv(rng));
+    vertex.orthogonalizeTangent();
+    return vertex;
+}
+}  // namespace
+
+TEST(VertexFormatTest, OctahedralRoundTrip) {
+    mt19937 rng(7);
+    vector<vec3> directions{vec3(1, 0, 0),  vec3(-1, 0, 0), vec3(0, 1, 0),
+                            vec3(0, -1, 0), vec3(0, 0, 1),  vec3(0, 0, -1),
+                            normalize(vec3(1, -1, -1))};
+    for (int i = 0; i < 100000; i++)
+        directions.push_back(randomDirection(rng));
+    float maxError = 0.0f;
+    for (const auto& direction : directions) {
+        int16_t encoded[2];
+        encodeOctahedral(direction, encoded);
+        vec3 decoded = decodeOctahedral(encoded);
+        EXPECT_NEAR(length(decoded), 1.0f, 1e-5f);
+        maxError = std::max(maxError, angleBetween(decoded, direction));
+    }
+    // measured at 4.3e-5, a 16 bit cell spans about 1e-4 rad
+    EXPECT_LT(maxError, 5e-5f);
+    int16_t encoded[2];
+    encodeOctahedral(vec3(0.0f), encoded);
+    EXPECT_EQ(decodeOctahedral(encoded), vec3(0, 0, 1));
+}
+
+TEST(VertexFormatTest, PackedVertexErrorBounds) {
+    mt19937 rng(11);
+    vector<Vertex> vertices;
+    for (int i = 0; i < 20000; i++)
+        vertices.push_back(randomVertex(rng));
+    auto quantization =
+        computeVertexQuantization(vertices.data(), vertices.size());
+    auto packed = packVertices(vertices.data(), vertices.size(), quantization);
+    ASSERT_EQ(packed.size(), vertices.size());
+    // half a unorm16 step of the extent per axis, plus the float rounding
+    // of coordinates of up to 5
+    vec3 positionBound = quantization.positionExtent / 131070.0f + 1e-6f;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const auto& original = vertices[i];
+        Vertex decoded = unpackVertex(packed[i], quantization);
+        for (int c = 0; c < 3; c++) {
+            EXPECT_LE(abs(decoded.position[c] - original.position[c]),
+                      positionBound[c]);
+            // half floats keep 11 significant bits
+            EXPECT_LE(abs(decoded.texCoord[c % 2] - original.texCoord[c % 2]),
+                      std::max(abs(original.texCoord[c % 2]), 1e-3f) / 2048);
+        }
+        EXPECT_LT(angleBetween(decoded.normal, original.normal), 5e-5f);
+        EXPECT_LT(angleBetween(decoded.tangent, original.tangent), 5e-5f);
+        // rebuilt from the decoded frame with the stored handedness
+        EXPECT_LT(angleBetween(decoded.bitangent, original.bitangent), 2e-4f);
+    }
+}
+
+TEST(VertexFormatTest, DegenerateInputs) {
+    auto empty = computeVertexQuantization(nullptr, 0);
+    EXPECT_EQ(empty.positionExtent, vec3(1.0f));
+    // a flat quad without texture coordinates: no tangent frame and no
+    // extent along z
+    vector<Vertex> vertices(4);
+    for (int i = 0; i < 4; i++) {
+        vertices[i] = Vertex{};
+        vertices[i].position = vec3(i & 1, i >> 1, 2.5f);
+        vertices[i].normal = vec3(0, 0, 1);
+    }
+    auto quantization = computeVertexQuantization(vertices.data(), 4);
+    EXPECT_EQ(quantization.positionMin, vec3(0.0f, 0.0f, 2.5f));
+    EXPECT_EQ(quantization.positionExtent, vec3(1.0f));
+    for (const auto& vertex : vertices) {
+        Vertex decoded = unpackVertex(packVertex(vertex, quantization),
+                                      quantization);
+        EXPECT_EQ(decoded.position, vertex.position);
+        EXPECT_EQ(decoded.texCoord, vec2(0.0f));
+        EXPECT_LT(angleBetween(decoded.normal, vertex.normal), 5e-5f);
+        EXPECT_FALSE(std::isnan(decoded.bitangent.x));
+    }
+}
+
+TEST(VertexFormatTest, SplitStreamsHoldEveryAttribute) {
+    mt19937 rng(13);
+    vector<Vertex> vertices;
+    for (int i = 0; i < 257; i++)
+        vertices.push_back(randomVertex(rng));
+    auto quantization =
+        computeVertexQuantization(vertices.data(), vertices.size());
+    EXPECT_EQ(geometryStride(VertexFormat::Float), sizeof(GeometryVertex));
+    EXPECT_EQ(attributeStride(VertexFormat::Quantized),
+              sizeof(PackedAttributeVertex));
+
+    vector<GeometryVertex> geometry(vertices.size());
+    vector<AttributeVertex> attributes(vertices.size());
+    writeVertexStreams(vertices.data(), vertices.size(), VertexFormat::Float,
+                       quantization, geometry.data(), attributes.data());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        Vertex joined{geometry[i].position, geometry[i].normal,
+                      attributes[i].texCoord, attributes[i].tangent,
+                      attributes[i].bitangent};
+        EXPECT_EQ(joined, vertices[i]);
+    }
+
+    // the packed streams carry exactly the bits of PackedVertex
+    vector<PackedGeometryVertex> packedGeometry(vertices.size());
+    vector<PackedAttributeVertex> packedAttributes(vertices.size());
+    writeVertexStreams(vertices.data(), vertices.size(),
+                       VertexFormat::Quantized, quantization,
+                       packedGeometry.data(), packedAttributes.data());
+    auto packed = packVertices(vertices.data(), vertices.size(), quantization);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const auto& g = packedGeometry[i];
+        const auto& a = packedAttributes[i];
+        EXPECT_TRUE(equal(begin(g.position), end(g.position),
+                          packed[i].position));
+        EXPECT_TRUE(equal(begin(g.normal), end(g.normal), packed[i].normal));
+        EXPECT_TRUE(equal(begin(a.tangent), end(a.tangent),
+                          packed[i].tangent));
+        EXPECT_TRUE(equal(begin(a.texCoord), end(a.texCoord),
+                          packed[i].texCoord));
+    }
+}
@@ -0,0 +1,224 @@
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <argparse/argparse.hpp>
+#include <assimp/Importer.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <loo/Material.hpp>
+#include <loo/loo.hpp>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "BSSRDF.hpp"
+#include "BSSRDFAnalyticProfile.hpp"
+#include "BSSRDFEncoding.hpp"
+#include "BSSRDFCache.hpp"
+#include "BSSRDFGaussianFit.hpp"
+#include "Config.hpp"
+#include "PBRMaterials.hpp"
+
+// Fills the BSSRDF cache ahead of time so HDSSS starts without tabulating.
+// No GL context is created: materials are converted the same way
+// HDSSSApplication::convertMaterial() does, minus the textures, so the cache
+// keys match the ones the viewer will look up.
+
+using json = nlohmann::json;
+using namespace std;
+using namespace glm;
+
+static void addUnique(vector<BSSRDFParams>& profiles,
+                      const ShaderPBRMetallicMaterial& material) {
+    auto params = BSSRDFParams::fromShaderMaterial(material);
+    if (find(profiles.begin(), profiles.end(), params) == profiles.end())
+        profiles.push_back(params);
+}
+
+static bool collectModelProfiles(const string& filename,
+                                 vector<BSSRDFParams>& profiles) {
+    Assimp::Importer importer;
+    // same post processing as loo::createMeshFromFile
+    const auto scene = importer.ReadFile(
+        filename, aiProcess_Triangulate | aiProcess_FlipUVs |
+                      aiProcess_GenNormals | aiProcess_CalcTangentSpace);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+        !scene->mRootNode) {
+        LOG(ERROR) << "Assimp: " << importer.GetErrorString();
+        return false;
+    }
+    size_t before = profiles.size();
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        const aiMaterial* aMaterial =
+            scene->mMaterials[scene->mMeshes[i]->mMaterialIndex];
+        auto material = createShaderPBRMetallicMaterial(
+            loo::createMetallicRoughnessFactorsFromAssimp(aMaterial));
+        if (isSubsurface(material))
+            addUnique(profiles, material);
+    }
+    if (profiles.size() == before) {
+        LOG(WARNING) << filename
+                     << " has no subsurface material, the viewer will use "
+                        "the default subsurface material";
+        addUnique(profiles, createDefaultSubsurfaceShaderMaterial());
+    }
+    return true;
+}
+
+// [{"sigma_t": [r, g, b], "albedo": [r, g, b]}, ...], missing keys fall
+// back to the bssrdf section of the config
+static bool collectListProfiles(const string& filename,
+                                vector<BSSRDFParams>& profiles) {
+    ifstream ifs(filename);
+    if (ifs.fail()) {
+        LOG(ERROR) << "Failed to open materials list " << filename;
+        return false;
+    }
+    json list = json::parse(ifs);
+    if (!list.is_array()) {
+        LOG(ERROR) << filename << " is not a JSON array";
+        return false;
+    }
+    const auto& bssrdf = PBRMetallicMaterial::bssrdf;
+    for (const auto& entry : list) {
+        vec3 sigmaT = bssrdf.sigma_t, albedo = bssrdf.albedo;
+        if (entry.contains("sigma_t")) {
+            auto& v = entry["sigma_t"];
+            sigmaT = vec3(v[0], v[1], v[2]);
+        }
+        if (entry.contains("albedo")) {
+            auto& v = entry["albedo"];
+            albedo = vec3(v[0], v[1], v[2]);
+        }
+        addUnique(profiles, createSubsurfaceShaderMaterial(sigmaT, albedo));
+    }
+    return true;
+}
+
+// what every encoding RdProfileAtlas supports would cost in memory and
+// accuracy, without a GL context
+static void reportEncodings(const BSSRDFTabulator& table, int rank) {
+    cout << BSSRDFCache::key(table.params, table.options) << endl;
+    for (auto encoding :
+         {BSSRDFTableEncoding::Float32, BSSRDFTableEncoding::Half,
+          BSSRDFTableEncoding::SharedExponent, BSSRDFTableEncoding::LowRank,
+          BSSRDFTableEncoding::Analytic}) {
+        BSSRDFEncodingOptions options{encoding, rank};
+        BSSRDFEncodingError error;
+        cout << "  " << encodingName(encoding);
+        if (encoding == BSSRDFTableEncoding::LowRank)
+            cout << "(" << rank << ")";
+        if (encoding == BSSRDFTableEncoding::Analytic) {
+            // without the zero area row, see measureError()
+            auto profile = BSSRDFAnalyticProfile::fit(table);
+            error = profile.measureError(table);
+            cout << "(rates " << profile.rates[0].r << " " << profile.rates[0].g
+                 << " " << profile.rates[0].b << ", " << profile.rates[1].r
+                 << " " << profile.rates[1].g << " " << profile.rates[1].b
+                 << ")";
+        } else {
+            error = measureEncodingError(table, options);
+        }
+        size_t size = encodedTableSize(table.options.tableSize, options);
+        cout << ": " << size / 1024.0 << " KB, max error " << error.maxError
+             << ", rms error " << error.rmsError << ", mean relative error "
+             << error.meanRelativeError << endl;
+    }
+}
+
+// how well the separable SSS mode approximates the tabulated profile with
+// every number of gaussians it supports
+static void reportGaussianFits(const BSSRDFTabulator& table,
+                               unsigned int nThreads) {
+    cout << BSSRDFCache::key(table.params, table.options) << endl;
+    for (int terms = 1; terms <= BSSRDF_GAUSSIAN_TERMS_MAX; terms++) {
+        auto fit = BSSRDFGaussianFit::fit(table, terms, nThreads);
+        cout << "  " << terms << " gaussians: max error "
+             << fit.error.maxError << ", rms error " << fit.error.rmsError
+             << ", energy error " << fit.error.energyError << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    loo::initialize(argv[0]);
+
+    argparse::ArgumentParser program("HDSSStabulate");
+    program.add_argument("-c", "--config")
+        .help("JSON config file path, supplies the cache and table options");
+    program.add_argument("-m", "--model")
+        .help("Model file whose subsurface materials are tabulated");
+    program.add_argument("-l", "--list").help("JSON materials list path");
+    program.add_argument("-j", "--threads")
+        .default_value(0u)
+        .help("Worker threads, 0 uses every core")
+        .scan<'u', unsigned int>();
+    program.add_argument("-e", "--encoding-report")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Report the error of every GPU table encoding");
+    program.add_argument("-g", "--gaussian-report")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Report the error of the separable SSS gaussian fits");
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << endl;
+        std::cout << program;
+        exit(1);
+    }
+
+    HDSSSConfig config;
+    string modelPath, skyboxDir;
+    if (auto configPath = program.present<string>("-c")) {
+        config = parseJSONConfig(configPath->c_str(), modelPath, skyboxDir);
+    }
+    if (auto path = program.present<string>("-m")) {
+        modelPath = *path;
+    }
+    PBRMetallicMaterial::bssrdf.albedo = config.bssrdf.albedo;
+    PBRMetallicMaterial::bssrdf.sigma_t = config.bssrdf.sigma_t;
+
+    vector<BSSRDFParams> profiles;
+    if (modelPath.length() && !collectModelProfiles(modelPath, profiles))
+        return 1;
+    if (auto path = program.present<string>("-l")) {
+        if (!collectListProfiles(*path, profiles))
+            return 1;
+    }
+    if (profiles.empty()) {
+        std::cerr << "Nothing to tabulate, pass a model or a materials list"
+                  << endl;
+        std::cout << program;
+        return 1;
+    }
+
+    BSSRDFCache cache(config.cache.directory, config.cache.maxSizeMB << 20);
+    LOG(INFO) << "Filling " << cache.getDirectory().string() << " with "
+              << profiles.size() << " tables";
+    auto start = chrono::steady_clock::now();
+    auto tables = cache.fetch(profiles, config.bssrdf.table,
+                              program.get<unsigned int>("--threads"));
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() -
+                                            start);
+    for (const auto& table : tables) {
+        LOG(INFO) << BSSRDFCache::key(table.params, table.options)
+                  << " max area: " << table.maxArea
+                  << " max distance: " << table.maxDistance;
+    }
+    LOG(INFO) << "Done in " << elapsed.count() << "s";
+    if (program.get<bool>("--encoding-report")) {
+        for (const auto& table : tables) {
+            reportEncodings(table, config.bssrdf.encoding.rank);
+        }
+    }
+    if (program.get<bool>("--gaussian-report")) {
+        for (const auto& table : tables) {
+            reportGaussianFits(table, program.get<unsigned int>("--threads"));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+target("HDSSStabulate")
+    set_kind("binary")
+    add_deps("HDSSSlib")
+    set_languages("c11", "cxx17")
+    add_packages("argparse", "nlohmann_json")
+
+    add_files("*.cpp")
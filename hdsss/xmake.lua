@@ -51,15 +51,29 @@ rule("glsl2hpp")
     end)
 rule_end()
 
+add_requires("argparse 2.9", "nlohmann_json v3.11.2")
+
 target("HDSSSlib")
     set_kind("static")
     add_deps("loo", "spv2hpp")
+    -- Config.cpp parses the JSON config for both HDSSS and HDSSStabulate
+    add_packages("nlohmann_json", {public = true})
 
     add_includedirs("include", {public = true})
     set_languages("c11", "cxx17", {public = true})
     set_rules("glsl2hpp", {outputdir = "hdsss/include/shaders", defines = {"MATERIAL_PBR"}})
-    add_files("shaders/*.*", "src/*.cpp")
+    add_files("shaders/*.*", "src/*.cpp|*AVX2.cpp")
     remove_files("src/main.cpp")
+    -- AVX2 kernels are only entered after a CPUID check
+    if is_arch("x64", "x86_64") then
+        if is_plat("windows") then
+            add_files("src/*AVX2.cpp", {cxflags = "/arch:AVX2"})
+        else
+            add_files("src/*AVX2.cpp", {cxflags = "-mavx2"})
+        end
+    else
+        add_files("src/*AVX2.cpp")
+    end
     
 
     add_defines("_CRT_SECURE_NO_WARNINGS")
@@ -73,8 +87,6 @@ target("HDSSSlib")
     add_cxflags("/execution-charset:utf-8", "/source-charset:utf-8", {tools = {"clang_cl", "cl"}})
 target_end()
 
-add_requires("argparse 2.9", "nlohmann_json v3.11.2")
-
 target("HDSSS")
     set_kind("binary")
     add_deps("HDSSSlib")
@@ -82,4 +94,6 @@ target("HDSSS")
 
     add_files("src/main.cpp")
 
+includes("tools")
 includes("test")
+includes("bench")
@@ -0,0 +1,42 @@
+#ifndef LOO_LOO_FRUSTUM_HPP
+#define LOO_LOO_FRUSTUM_HPP
+#include <glm/glm.hpp>
+
+#include "predefs.hpp"
+
+namespace loo {
+
+struct LOO_EXPORT BoundingBox {
+    glm::vec3 min{0.0f}, max{0.0f};
+    glm::vec3 center() const { return 0.5f * (min + max); }
+    glm::vec3 extent() const { return 0.5f * (max - min); }
+    // the box around the transformed box
+    BoundingBox transformed(const glm::mat4& transform) const;
+};
+
+// six planes facing inwards, dot(plane.xyz, p) + plane.w >= 0 inside
+struct LOO_EXPORT Frustum {
+    glm::vec4 planes[6];
+    // homogeneous center of projection: the camera position with w = 1, or
+    // for an orthographic projection the view direction with w = 0
+    glm::vec4 eye{0.0f, 0.0f, 0.0f, 1.0f};
+
+    // the clip volume of a view projection matrix(GL depth range) in the
+    // space the matrix transforms from
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+    // every plane moved outwards by margin
+    Frustum inflated(float margin) const;
+    // the frustum in the object space of a model matrix
+    Frustum toObjectSpace(const glm::mat4& model) const;
+    // conservative, boxes close to the edges of the frustum may pass
+    bool intersects(const BoundingBox& box) const;
+    bool intersects(const glm::vec3& center, float radius) const;
+    // whether a cluster whose normals lie in the cone(apex, axis, cutoff as
+    // computed by meshoptimizer) faces away from the eye entirely
+    bool backfacing(const glm::vec3& coneApex, const glm::vec3& coneAxis,
+                    float coneCutoff) const;
+};
+
+}  // namespace loo
+
+#endif /* LOO_LOO_FRUSTUM_HPP */
@@ -0,0 +1,38 @@
+#ifndef LOO_LOO_GPU_TIMER_HPP
+#define LOO_LOO_GPU_TIMER_HPP
+#include <glad/glad.h>
+
+#include "predefs.hpp"
+
+namespace loo {
+
+// GPU time of a range of commands measured by GL_TIME_ELAPSED queries. The
+// queries of the last few frames are kept in a ring and only read once the
+// driver has their result, so timing never stalls the pipeline. Time
+// ranges must not nest, GL allows a single elapsed time query at once
+class LOO_EXPORT GPUTimer {
+   public:
+    static constexpr int QUERY_COUNT = 4;
+    GPUTimer() = default;
+    GPUTimer(const GPUTimer&) = delete;
+    GPUTimer& operator=(const GPUTimer&) = delete;
+    ~GPUTimer();
+
+    void begin();
+    void end();
+    // exponential moving average of the finished ranges in milliseconds, 0
+    // before the first one finished
+    double getElapsedMs() const { return m_elapsedms; }
+
+   private:
+    void collect();
+    GLuint m_queries[QUERY_COUNT]{};
+    // queries issued but not read back, the oldest at m_next - m_pending
+    int m_next{0}, m_pending{0};
+    double m_elapsedms{0.0};
+    bool m_measured{false};
+};
+
+}  // namespace loo
+
+#endif /* LOO_LOO_GPU_TIMER_HPP */
@@ -0,0 +1,40 @@
+#ifndef LOO_LOO_HASH_HPP
+#define LOO_LOO_HASH_HPP
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "predefs.hpp"
+
+namespace loo {
+
+// incremental SHA-256, for content addressed caches where std::hash is
+// too weak to be trusted as a key
+class LOO_EXPORT SHA256 {
+   public:
+    using Digest = std::array<uint8_t, 32>;
+    SHA256();
+    void update(const void* data, size_t size);
+    template <typename T>
+    void updateValue(const T& value) {
+        update(&value, sizeof(T));
+    }
+    Digest finalize();
+
+    static std::string toHex(const Digest& digest);
+
+   private:
+    void transform(const uint8_t* block);
+    uint32_t m_state[8];
+    uint8_t m_buffer[64];
+    uint64_t m_length{0};
+    size_t m_bufferSize{0};
+};
+
+// hex SHA-256 of a whole file, empty string if it cannot be read
+LOO_EXPORT std::string sha256File(const std::string& filename);
+
+}  // namespace loo
+
+#endif /* LOO_LOO_HASH_HPP */
@@ -0,0 +1,33 @@
+#ifndef LOO_LOO_MAPPED_FILE_HPP
+#define LOO_LOO_MAPPED_FILE_HPP
+#include <cstddef>
+#include <string>
+
+#include "predefs.hpp"
+
+namespace loo {
+
+// read-only memory mapping of a whole file, unmapped on destruction
+class LOO_EXPORT MappedFile {
+   public:
+    explicit MappedFile(const std::string& filename);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+   private:
+    const unsigned char* m_data{nullptr};
+    size_t m_size{0};
+#ifdef _WIN32
+    void* m_file{nullptr};
+    void* m_mapping{nullptr};
+#endif
+};
+
+}  // namespace loo
+
+#endif /* LOO_LOO_MAPPED_FILE_HPP */
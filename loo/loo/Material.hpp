@@ -8,6 +8,7 @@
 #include <filesystem>
 #include <glm/glm.hpp>
 #include <memory>
+#include <string>
 
 #include <assimp/types.h>
 #include <loo/Texture.hpp>
@@ -84,7 +85,43 @@ struct BaseMaterial : public Material {
     // metalness-roughness params
     MetallicRoughnessWorkFlow mrWorkFlow;
 };
+// texture slots of BaseMaterial and its metallic-roughness workflow
+enum class BaseMaterialTexture {
+    Diffuse,
+    Ambient,
+    Displacement,
+    Normal,
+    Specular,
+    Opacity,
+    Height,
+    BaseColor,
+    Occlusion,
+    Metallic,
+    Roughness,
+    Count
+};
+constexpr int BASE_MATERIAL_TEXTURE_COUNT = int(BaseMaterialTexture::Count);
+
+// everything a BaseMaterial is created from: the factors and the texture
+// paths relative to the model, empty for missing textures. Needs neither the
+// Assimp scene nor a GL context, so it can be stored in caches
+struct BaseMaterialDescription {
+    BlinnPhongWorkFlow bpWorkFlow{};
+    // factors only, the textures are left empty
+    MetallicRoughnessWorkFlow mrWorkFlow{};
+    std::string texturePaths[BASE_MATERIAL_TEXTURE_COUNT];
+};
+BaseMaterialDescription describeBaseMaterialFromAssimp(
+    const aiMaterial* aMaterial);
+// loads the textures of the description, needs a GL context
+std::shared_ptr<loo::BaseMaterial> createBaseMaterial(
+    const BaseMaterialDescription& description,
+    std::filesystem::path objParent);
 std::shared_ptr<loo::BaseMaterial> createBaseMaterialFromAssimp(
     const aiMaterial* aMaterial, std::filesystem::path objParent);
+// only the factors of the metallic-roughness workflow, no texture is loaded
+// so no GL context is needed
+MetallicRoughnessWorkFlow createMetallicRoughnessFactorsFromAssimp(
+    const aiMaterial* aMaterial);
 }  // namespace loo
 #endif /* LOO_LOO_MATERIAL_HPP */
@@ -1,61 +1,222 @@
 #ifndef LOO_LOO_MESH_HPP
 #define LOO_LOO_MESH_HPP
+#include <cstdint>
+#include <filesystem>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#include "Frustum.hpp"
+#include "MappedFile.hpp"
 #include "Material.hpp"
 #include "Shader.hpp"
 #include "Texture.hpp"
+#include "VertexFormat.hpp"
 #include "glm/ext/matrix_transform.hpp"
 #include "loo.hpp"
 #include "predefs.hpp"
 
 namespace loo {
 
-struct LOO_EXPORT Vertex {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texCoord;
-    glm::vec3 tangent;
-    glm::vec3 bitangent;
-    bool operator==(const Vertex& v) const;
-    // Re-orthogonalization tangents, modifies tangent and bitangent
-    void orthogonalizeTangent();
+// a level of detail inside the index buffer of a mesh
+struct MeshLod {
+    uint32_t indexOffset{0}, indexCount{0};
+    // simplification error relative to the extent of the mesh
+    float error{0.0f};
 };
 
+// consecutive indices submitted by one draw
+struct IndexRange {
+    uint32_t indexOffset{0}, indexCount{0};
+};
+
+// a cluster of the full level: a range of its indices and the bounds
+// meshoptimizer computes for culling, all in object space
+struct Meshlet {
+    uint32_t indexOffset{0}, indexCount{0};
+    glm::vec3 center{0.0f};
+    float radius{0.0f};
+    // every triangle faces away from an eye with
+    // dot(normalize(coneApex - eye), coneAxis) >= coneCutoff
+    glm::vec3 coneApex{0.0f}, coneAxis{0.0f};
+    float coneCutoff{1.0f};
+};
+
+struct Mesh;
+// uploads the meshes into one vertex and one index buffer, like prepare()
+// does for each of them, so they share their VAOs and can be drawn by one
+// multi-draw. The vertices of a mesh start at its getBaseVertex(), its
+// indices at getFirstIndex()
+LOO_EXPORT void prepareSharedBuffers(
+    const std::vector<std::shared_ptr<Mesh>>& meshes, VertexFormat format);
+
 struct LOO_EXPORT Mesh {
     std::vector<Vertex> vertices;
+    // every level of detail, one after another
     std::vector<unsigned int> indices;
+    // the levels from the full mesh to the coarsest one, empty for a mesh
+    // without a chain: its single level spans all indices
+    std::vector<MeshLod> lods;
+    // clusters covering the full level one after another, empty if none
+    // were built
+    std::vector<Meshlet> meshlets;
     std::shared_ptr<Material> material;
     std::string name;
     glm::mat4 objectMatrix;
+    // transforms of the copies of a mesh referenced by several nodes,
+    // applied after objectMatrix and drawn by instancing. Empty for a single
+    // copy
+    std::vector<glm::mat4> instances;
 
     Mesh(std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indicies,
          std::shared_ptr<Material> material, std::string name,
          const glm::mat4& transform)
-        : vertices(vertices),
-          indices(indicies),
+        : vertices(std::move(vertices)),
+          indices(std::move(indicies)),
           material(material),
           name(std::move(name)),
           objectMatrix(transform) {}
+    // vertices and indices inside a mapped mesh cache entry, which is kept
+    // mapped as long as the mesh. vertices and indices stay empty, the
+    // arrays are read through getVertexData() and getIndexData()
+    Mesh(std::shared_ptr<const MappedFile> mapping, const Vertex* vertexData,
+         size_t vertexCount, const unsigned int* indexData, size_t indexCount,
+         std::shared_ptr<Material> material, std::string name,
+         const glm::mat4& transform)
+        : material(material),
+          name(std::move(name)),
+          objectMatrix(transform),
+          m_mapping(std::move(mapping)),
+          m_mappedvertices(vertexData),
+          m_mappedindices(indexData),
+          m_mappedvertexcount(vertexCount),
+          m_mappedindexcount(indexCount) {}
 
-    GLuint vao, vbo, ebo;
-    void prepare();
+    // vao reads both vertex streams, geometryVao only position and normal
+    GLuint vao, geometryVao, vbo, ebo;
+    // splits the vertices into the geometry and attribute streams of the
+    // format, written straight from the vertices(or the mapping of a cache
+    // entry) into the GL buffer
+    void prepare(VertexFormat format = VertexFormat::Float);
     size_t countVertex() const;
-    size_t countTriangles(bool lod = true) const;
+    size_t countIndex() const;
+    size_t countLod() const;
+    MeshLod getLod(int lod) const;
+    size_t countTriangles(int lod = 0) const;
+    size_t countInstances() const {
+        return instances.empty() ? 1 : instances.size();
+    }
+    // objectMatrix of the copy
+    glm::mat4 getInstanceMatrix(size_t instance) const {
+        return instances.empty() ? objectMatrix
+                                 : objectMatrix * instances[instance];
+    }
+    const Vertex* getVertexData() const;
+    const unsigned int* getIndexData() const;
+    bool isMapped() const { return m_mapping != nullptr; }
+    VertexFormat getVertexFormat() const { return m_vertexformat; }
+    const VertexQuantization& getVertexQuantization() const {
+        return m_quantization;
+    }
+
+    // bounds of the vertices in object space, computed by prepare()
+    const BoundingBox& getBounds() const { return m_bounds; }
+    // where the mesh starts in the buffers shared with other meshes, 0 for
+    // buffers of its own
+    int32_t getBaseVertex() const { return m_basevertex; }
+    uint32_t getFirstIndex() const { return m_firstindex; }
 
+    // geometryOnly binds geometryVao, for shaders reading only locations 0
+    // and 1
     void draw(ShaderProgram& sp, GLenum drawMode = GL_FILL,
-              bool tessellation = false) const;
-    void updateLod(float screenProportion);
-    int getLod() const { return 0; }
+              bool tessellation = false, bool geometryOnly = false,
+              int lod = 0) const;
+    // draws only the ranges, in one glMultiDrawElements
+    void draw(ShaderProgram& sp, GLenum drawMode, bool tessellation,
+              bool geometryOnly, int lod,
+              const std::vector<IndexRange>& ranges) const;
+    // appends the ranges of the meshlets inside the frustum(in object space)
+    // to ranges, neighbouring ones merged. With coneCulling the meshlets
+    // facing away from the eye of the frustum are skipped as well. Returns
+    // the number of meshlets kept
+    size_t cullMeshlets(const Frustum& frustum, bool coneCulling,
+                        std::vector<IndexRange>& ranges) const;
+    // diameter of the projected bounding sphere over the viewport height
+    void updateLod(float screenProportion) {
+        m_screenproportion = screenProportion;
+    }
+    // the coarsest level whose error, projected like the bounding sphere,
+    // stays within screenError of the viewport height
+    int selectLod(float screenError) const;
 
    private:
+    friend void prepareSharedBuffers(
+        const std::vector<std::shared_ptr<Mesh>>& meshes, VertexFormat format);
+    // bounds and quantization for the format
+    void prepareBounds(VertexFormat format);
+
+    std::shared_ptr<const MappedFile> m_mapping{};
+    const Vertex* m_mappedvertices{nullptr};
+    const unsigned int* m_mappedindices{nullptr};
+    size_t m_mappedvertexcount{0}, m_mappedindexcount{0};
+    VertexFormat m_vertexformat{VertexFormat::Float};
+    VertexQuantization m_quantization{};
+    BoundingBox m_bounds{};
+    int32_t m_basevertex{0};
+    uint32_t m_firstindex{0};
+    // large until the first updateLod(), which draws the full mesh
+    float m_screenproportion{1e9f};
+};
+
+// load-time stages of optimizeMesh(), in the order they run
+struct LOO_EXPORT MeshOptimizeOptions {
+    // merges bitwise identical vertices, assimp emits one per face corner
+    bool weld{true};
+    // reorders the triangles for the post-transform vertex cache
+    bool vertexCache{true};
+    // reorders the triangles to reduce overdraw, letting the ACMR grow by
+    // at most this factor. 0 skips the stage
+    float overdrawThreshold{1.05f};
+    // reorders the vertices by first use, for the pre-transform cache
+    bool vertexFetch{true};
+    // simplified levels of detail appended to the index buffer, each with
+    // lodReduction of the triangles of the one before. The chain ends early
+    // once the error of a level would exceed lodMaxError(relative to the
+    // mesh extent) or it stops shrinking
+    unsigned int lodLevels{2};
+    float lodReduction{0.5f};
+    float lodMaxError{0.02f};
+    // splits the full level into meshlets for culling in Scene::draw(),
+    // runs before the lod stage
+    bool meshlets{false};
+};
+
+// post-transform vertex cache efficiency of a mesh: vertices transformed per
+// triangle(ACMR) and per vertex(ATVR) of the full level, for a 16 entry FIFO
+// cache
+struct LOO_EXPORT MeshCacheStatistics {
+    size_t verticesTransformed{0};
+    float acmr{0}, atvr{0};
 };
+LOO_EXPORT MeshCacheStatistics analyzeMeshCache(const Mesh& mesh);
+// runs the enabled stages on the vertices and indices in place, must be
+// called before prepare(). The triangles of the full mesh are kept, only
+// their order and the vertex order change, the lod stage appends the
+// simplified levels behind them
+LOO_EXPORT void optimizeMesh(Mesh& mesh, const MeshOptimizeOptions& options);
 
+// the meshes of the file in the depth first order of the first node that
+// references them, a mesh referenced by several nodes is converted once and
+// gets an instance per node. They are converted and optimized on up to
+// nThreads workers, 0 for defaultThreadCount(). With a cacheDirectory the
+// result is stored there as a .loomesh entry(see MeshCache.hpp) and mapped
+// instead of imported as long as neither the file nor the arguments change
 LOO_EXPORT std::vector<std::shared_ptr<Mesh>> createMeshFromFile(
     const std::string& filename,
-    const glm::mat4& sceneTransform = glm::identity<glm::mat4>());
+    const glm::mat4& sceneTransform = glm::identity<glm::mat4>(),
+    const MeshOptimizeOptions& optimizeOptions = {},
+    const std::filesystem::path& cacheDirectory = {},
+    unsigned int nThreads = 0);
 
 }  // namespace loo
 
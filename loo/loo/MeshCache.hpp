@@ -0,0 +1,89 @@
+#ifndef LOO_LOO_MESH_CACHE_HPP
+#define LOO_LOO_MESH_CACHE_HPP
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "Material.hpp"
+#include "Mesh.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+
+// bump on any change of the .loomesh layout, of Vertex or of what
+// createMeshFromFile() does to the imported meshes
+constexpr uint32_t MESH_CACHE_VERSION = 5;
+
+// one mesh of a .loomesh entry, the arrays point into the entry's mapping
+struct MeshCacheRecord {
+    std::string name;
+    // index into MeshCacheEntry::materials
+    uint32_t material{0};
+    glm::mat4 transform{1.0f};
+    const Vertex* vertices{nullptr};
+    size_t vertexCount{0};
+    const unsigned int* indices{nullptr};
+    size_t indexCount{0};
+    // ranges inside indices, see Mesh::lods
+    std::vector<MeshLod> lods;
+    // see Mesh::meshlets
+    std::vector<Meshlet> meshlets;
+    // see Mesh::instances
+    std::vector<glm::mat4> instances;
+};
+
+// a file the import read besides the model file(glTF buffers, OBJ material
+// libraries), which the key does not cover
+struct MeshCacheDependency {
+    // relative to the directory of the model file
+    std::string path;
+    // hex SHA-256 of the content at import
+    std::string digest;
+};
+
+// the processed meshes of a model file and the materials they reference
+struct MeshCacheEntry {
+    std::shared_ptr<const MappedFile> mapping{};
+    std::vector<BaseMaterialDescription> materials;
+    std::vector<MeshCacheRecord> meshes;
+    std::vector<MeshCacheDependency> dependencies;
+};
+
+// SHA-256 over the content of the model file and every input of the import:
+// the Assimp post processing flags, the scene transform and the optimize
+// stages. Empty if the file can't be read. The other files the import reads
+// are only known afterwards, they are stored as dependencies of the entry
+LOO_EXPORT std::string meshCacheKey(const std::string& filename,
+                                    unsigned int importFlags,
+                                    const glm::mat4& sceneTransform,
+                                    const MeshOptimizeOptions& options);
+
+// stores meshes[i] with materials[meshMaterials[i]]. The entry is written
+// under a temporary name and published by a rename, so processes sharing
+// the directory only ever map complete entries
+LOO_EXPORT bool saveMeshCache(
+    const std::filesystem::path& filename, const std::string& key,
+    const std::vector<BaseMaterialDescription>& materials,
+    const std::vector<std::shared_ptr<Mesh>>& meshes,
+    const std::vector<uint32_t>& meshMaterials,
+    const std::vector<MeshCacheDependency>& dependencies = {});
+// maps the entry, false if it is of another version or key or damaged. The
+// vertex and index arrays are not copied
+LOO_EXPORT bool loadMeshCache(const std::filesystem::path& filename,
+                              const std::string& key, MeshCacheEntry& entry);
+
+// the digests of the files an import opened, skipping the model file itself
+LOO_EXPORT std::vector<MeshCacheDependency> hashMeshCacheDependencies(
+    const std::vector<std::string>& files,
+    const std::filesystem::path& modelFile);
+// false once a dependency of the entry changed or is gone, the entry is
+// stale then
+LOO_EXPORT bool checkMeshCacheDependencies(
+    const MeshCacheEntry& entry, const std::filesystem::path& modelFile);
+
+}  // namespace loo
+
+#endif /* LOO_LOO_MESH_CACHE_HPP */
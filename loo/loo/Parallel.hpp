@@ -0,0 +1,23 @@
+#ifndef LOO_LOO_PARALLEL_HPP
+#define LOO_LOO_PARALLEL_HPP
+#include <cstddef>
+#include <functional>
+
+#include "predefs.hpp"
+
+namespace loo {
+
+// number of workers used when a caller passes nThreads = 0
+LOO_EXPORT unsigned int defaultThreadCount();
+
+// Run fn(i) for every i in [0, count) on up to nThreads workers(the calling
+// thread included). Indices are handed out one at a time, so as long as fn(i)
+// only writes to its own slot the result doesn't depend on the thread count.
+// The first exception thrown by fn is rethrown on the calling thread.
+LOO_EXPORT void parallelFor(size_t count,
+                            const std::function<void(size_t)>& fn,
+                            unsigned int nThreads = 0);
+
+}  // namespace loo
+
+#endif /* LOO_LOO_PARALLEL_HPP */
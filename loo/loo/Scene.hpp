@@ -15,37 +15,98 @@
 #include "predefs.hpp"
 
 namespace loo {
-constexpr int DRAW_FLAG_UPDATE_LOD = 0x1, DRAW_FLAG_TESSELLATION = 0x2;
+// DRAW_FLAG_LOD draws the level of detail Mesh::selectLod() picks for the
+// last updateLod(), without it the full meshes are drawn.
+// DRAW_FLAG_GEOMETRY_ONLY draws through Mesh::geometryVao, for passes whose
+// shaders only read position and normal.
+// DRAW_FLAG_CONE_CULLING also skips the meshlets facing away from the eye of
+// the frustum, only for passes that see the front faces alone
+constexpr int DRAW_FLAG_LOD = 0x1, DRAW_FLAG_TESSELLATION = 0x2,
+              DRAW_FLAG_GEOMETRY_ONLY = 0x4, DRAW_FLAG_CONE_CULLING = 0x8;
+// mesh instances and meshlets drawn and skipped by the frustum of a
+// Scene::draw()
+struct DrawStatistics {
+    size_t visible{0}, culled{0}, triangles{0};
+    size_t meshletsVisible{0}, meshletsCulled{0};
+    // GL draw commands issued, a multi-draw counts once
+    size_t drawCalls{0};
+};
+
+// shader storage binding of the DrawData array of indirect draws
+constexpr int DRAW_DATA_BINDING = 0;
+// what the shaders of an indirect draw read instead of the per mesh
+// uniforms, a std430 array indexed by gl_BaseInstance + gl_InstanceID
+struct DrawData {
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+    // the VertexQuantization of the mesh, w of the minimum is 1 for the
+    // quantized format and w of the extent the level of detail
+    glm::vec4 positionMin;
+    glm::vec4 positionExtent;
+};
+
 class LOO_EXPORT Scene {
     std::vector<std::shared_ptr<Mesh>> m_meshes;
     glm::mat4 m_modelmat{1.0};
-    GLuint m_queryid;
+    // fraction of the viewport height a level may deviate by
+    float m_lodscreenerror{1.0f / 1080.0f};
+    bool m_frustumculling{true};
+    bool m_sharedbuffers{false}, m_indirectdraw{false};
+    // per draw data and commands of indirect draws, refilled by every draw
+    mutable GLuint m_drawdatabuffer{0}, m_indirectbuffer{0};
 
    public:
     void scale(glm::vec3 ratio);
     void translate(glm::vec3 pos);
-    void prepare() const;
+    // sharedBuffers uploads all meshes into one vertex and one index buffer,
+    // see prepareSharedBuffers(), which indirect draws need
+    void prepare(VertexFormat format = VertexFormat::Float,
+                 bool sharedBuffers = true);
     glm::mat4 getModelMatrix() const;
     auto& getMeshes() const { return m_meshes; }
     auto getMeshes() { return m_meshes; }
 
     // +++++ debug use +++++
     size_t countMesh() const;
+    // distinct materials, what the indirect draws of a pass are grouped by
+    size_t countMaterial() const;
     size_t countTriangle() const;
     size_t countVertex() const;
     // +++++ debug use +++++
 
     void addMeshes(std::vector<std::shared_ptr<Mesh>>&& meshes);
 
-    void draw(ShaderProgram& sp,
-              std::function<void(const Scene&, const Mesh&)> beforeDraw,
-              GLenum drawMode = GL_FILL,
-              int drawFlags = DRAW_FLAG_UPDATE_LOD) const;
+    // projects the bounding sphere of every mesh instance for the level of
+    // detail of the mesh, once per frame with the camera matrices
+    void updateLod(const glm::mat4& view, const glm::mat4& projection) const;
+    void setLodScreenError(float screenError) {
+        m_lodscreenerror = screenError;
+    }
+    float getLodScreenError() const { return m_lodscreenerror; }
+    // off, draw() ignores the frustums it gets
+    void setFrustumCulling(bool enable) { m_frustumculling = enable; }
+    // on and prepared with shared buffers, draw() sorts the visible meshes
+    // by material and issues one glMultiDrawElementsIndirect per material,
+    // the visible instances of a mesh drawn by its commands. The shaders then
+    // read the DrawData of an instance instead of the per mesh uniforms and
+    // beforeDraw is not called
+    void setIndirectDraw(bool enable) { m_indirectdraw = enable; }
+
+    // lodBias scales the tolerated error by 2^lodBias, passes that can live
+    // with coarser geometry pass a positive one. With a frustum(in world
+    // space) the mesh instances whose bounds lie outside of it are skipped,
+    // of a mesh with a single visible instance only the meshlets inside it
+    // are drawn. beforeDraw gets the model matrix of every instance drawn
+    DrawStatistics draw(
+        ShaderProgram& sp,
+        std::function<void(const Scene&, const Mesh&, const glm::mat4&)>
+            beforeDraw,
+        GLenum drawMode = GL_FILL, int drawFlags = DRAW_FLAG_LOD,
+        float lodBias = 0.0f, const Frustum* frustum = nullptr) const;
 
-    void draw(ShaderProgram& sp, GLenum drawMode = GL_FILL,
-              int drawFlags = DRAW_FLAG_UPDATE_LOD) const;
-    Scene();
-    ~Scene();
+    DrawStatistics draw(ShaderProgram& sp, GLenum drawMode = GL_FILL,
+                        int drawFlags = DRAW_FLAG_LOD, float lodBias = 0.0f,
+                        const Frustum* frustum = nullptr) const;
 };
 
 LOO_EXPORT Scene createSceneFromFile(const std::string& filename);
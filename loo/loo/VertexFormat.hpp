@@ -0,0 +1,103 @@
+#ifndef LOO_LOO_VERTEX_FORMAT_HPP
+#define LOO_LOO_VERTEX_FORMAT_HPP
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "predefs.hpp"
+
+namespace loo {
+
+struct LOO_EXPORT Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+    glm::vec3 tangent;
+    glm::vec3 bitangent;
+    bool operator==(const Vertex& v) const;
+    // Re-orthogonalization tangents, modifies tangent and bitangent
+    void orthogonalizeTangent();
+};
+
+// vertex layouts Mesh::prepare() can upload
+enum class VertexFormat {
+    // Vertex as it is, 56 bytes
+    Float,
+    // PackedVertex, 20 bytes
+    Quantized
+};
+
+// bounds the quantized positions of a mesh are relative to
+struct VertexQuantization {
+    glm::vec3 positionMin{0.0f};
+    glm::vec3 positionExtent{1.0f};
+};
+
+// the position as unorm16 inside the mesh bounds with the sign of the
+// bitangent against cross(normal, tangent) as 0 or 1 in w, octahedral normal
+// and tangent as snorm16 and half float texture coordinates. The shaders
+// decode it in include/vertex.glsl of HDSSS, unpackVertex() mirrors them
+struct PackedVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+    int16_t tangent[2];
+    uint16_t texCoord[2];
+};
+static_assert(sizeof(PackedVertex) == 20);
+
+// snorm16 octahedral encoding of a direction. Of the 4 roundings the one
+// decoding closest to v is taken, zero vectors encode +z
+LOO_EXPORT void encodeOctahedral(const glm::vec3& v, int16_t encoded[2]);
+LOO_EXPORT glm::vec3 decodeOctahedral(const int16_t encoded[2]);
+
+// bounds of the positions, an empty axis gets a unit extent
+LOO_EXPORT VertexQuantization computeVertexQuantization(
+    const Vertex* vertices, size_t count);
+// the bitangent is not stored, it is rebuilt as the signed cross product of
+// normal and tangent like orthogonalizeTangent() leaves it
+LOO_EXPORT PackedVertex packVertex(const Vertex& vertex,
+                                   const VertexQuantization& quantization);
+LOO_EXPORT Vertex unpackVertex(const PackedVertex& packed,
+                               const VertexQuantization& quantization);
+LOO_EXPORT std::vector<PackedVertex> packVertices(
+    const Vertex* vertices, size_t count,
+    const VertexQuantization& quantization);
+
+// the two streams Mesh::prepare() uploads a vertex as. The geometry stream
+// holds what the depth, shadow and surfelize passes read: position and
+// normal, plus the bitangent sign that lives in the packed position. The
+// attribute stream holds the rest
+struct GeometryVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+struct AttributeVertex {
+    glm::vec2 texCoord;
+    glm::vec3 tangent;
+    glm::vec3 bitangent;
+};
+struct PackedGeometryVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+};
+struct PackedAttributeVertex {
+    int16_t tangent[2];
+    uint16_t texCoord[2];
+};
+static_assert(sizeof(GeometryVertex) == 24 && sizeof(AttributeVertex) == 32);
+static_assert(sizeof(PackedGeometryVertex) == 12 &&
+              sizeof(PackedAttributeVertex) == 8);
+
+LOO_EXPORT size_t geometryStride(VertexFormat format);
+LOO_EXPORT size_t attributeStride(VertexFormat format);
+// writes count vertices of the format to the two streams, e.g. straight into
+// a mapped GL buffer. The quantization is only used by the quantized format
+LOO_EXPORT void writeVertexStreams(const Vertex* vertices, size_t count,
+                                   VertexFormat format,
+                                   const VertexQuantization& quantization,
+                                   void* geometry, void* attributes);
+
+}  // namespace loo
+
+#endif /* LOO_LOO_VERTEX_FORMAT_HPP */
@@ -0,0 +1,88 @@
+#include "loo/Frustum.hpp"
+
+namespace loo {
+using namespace std;
+using namespace glm;
+
+BoundingBox BoundingBox::transformed(const mat4& transform) const {
+    vec3 c = vec3(transform * vec4(center(), 1.0f));
+    vec3 e = extent();
+    vec3 newExtent = abs(vec3(transform[0])) * e.x +
+                     abs(vec3(transform[1])) * e.y +
+                     abs(vec3(transform[2])) * e.z;
+    return {c - newExtent, c + newExtent};
+}
+
+static vec4 normalizeEye(const vec4& eye) {
+    if (std::abs(eye.w) > 1e-6f * length(vec3(eye)))
+        return vec4(vec3(eye) / eye.w, 1.0f);
+    return vec4(normalize(vec3(eye)), 0.0f);
+}
+
+Frustum Frustum::fromMatrix(const mat4& viewProjection) {
+    // Gribb and Hartmann, the planes are sums of the rows of the matrix
+    auto row = [&viewProjection](int i) {
+        return vec4(viewProjection[0][i], viewProjection[1][i],
+                    viewProjection[2][i], viewProjection[3][i]);
+    };
+    Frustum frustum;
+    frustum.planes[0] = row(3) + row(0);
+    frustum.planes[1] = row(3) - row(0);
+    frustum.planes[2] = row(3) + row(1);
+    frustum.planes[3] = row(3) - row(1);
+    frustum.planes[4] = row(3) + row(2);
+    frustum.planes[5] = row(3) - row(2);
+    for (auto& plane : frustum.planes) {
+        // normalized so w is a distance and inflated() can add to it
+        plane /= length(vec3(plane));
+    }
+    // the point every projection ray passes through, mapped to (0, 0, 1, 0)
+    frustum.eye = normalizeEye(inverse(viewProjection) * vec4(0, 0, 1, 0));
+    return frustum;
+}
+
+Frustum Frustum::inflated(float margin) const {
+    Frustum frustum = *this;
+    for (auto& plane : frustum.planes)
+        plane.w += margin;
+    return frustum;
+}
+
+Frustum Frustum::toObjectSpace(const mat4& model) const {
+    Frustum frustum;
+    // planes transform by the transpose of the point transform
+    mat4 planeTransform = transpose(model);
+    for (int i = 0; i < 6; i++) {
+        vec4 plane = planeTransform * planes[i];
+        frustum.planes[i] = plane / length(vec3(plane));
+    }
+    frustum.eye = normalizeEye(inverse(model) * eye);
+    return frustum;
+}
+
+bool Frustum::intersects(const vec3& center, float radius) const {
+    for (const auto& plane : planes) {
+        if (dot(vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::backfacing(const vec3& coneApex, const vec3& coneAxis,
+                         float coneCutoff) const {
+    vec3 view = eye.w != 0.0f ? normalize(coneApex - vec3(eye)) : vec3(eye);
+    return dot(view, coneAxis) >= coneCutoff;
+}
+
+bool Frustum::intersects(const BoundingBox& box) const {
+    vec3 c = box.center(), e = box.extent();
+    for (const auto& plane : planes) {
+        vec3 n(plane);
+        // the box is outside once its corner farthest along n is
+        if (dot(n, c) + plane.w < -dot(abs(n), e))
+            return false;
+    }
+    return true;
+}
+
+}  // namespace loo
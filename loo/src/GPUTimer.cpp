@@ -0,0 +1,50 @@
+#include "loo/GPUTimer.hpp"
+
+namespace loo {
+
+// weight of the newest range in the average
+constexpr double GPU_TIMER_SMOOTHING = 0.1;
+
+GPUTimer::~GPUTimer() {
+    if (m_queries[0] != 0)
+        glDeleteQueries(QUERY_COUNT, m_queries);
+}
+
+void GPUTimer::begin() {
+    if (m_queries[0] == 0)
+        glGenQueries(QUERY_COUNT, m_queries);
+    collect();
+    // every query is in flight, skip this range rather than wait
+    if (m_pending == QUERY_COUNT)
+        return;
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+}
+
+void GPUTimer::end() {
+    if (m_queries[0] == 0 || m_pending == QUERY_COUNT)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    m_next = (m_next + 1) % QUERY_COUNT;
+    m_pending++;
+}
+
+void GPUTimer::collect() {
+    while (m_pending > 0) {
+        GLuint query =
+            m_queries[(m_next - m_pending + QUERY_COUNT) % QUERY_COUNT];
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        double ms = elapsed * 1e-6;
+        m_elapsedms = m_measured ? m_elapsedms + GPU_TIMER_SMOOTHING *
+                                                     (ms - m_elapsedms)
+                                 : ms;
+        m_measured = true;
+        m_pending--;
+    }
+}
+
+}  // namespace loo
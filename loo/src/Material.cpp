@@ -23,24 +23,20 @@ static inline glm::vec3 aiColor3D2Glm(const aiColor3D& aColor) {
     return {aColor.r, aColor.g, aColor.b};
 }
 
-static shared_ptr<Texture2D> createMaterialTextures(
-    const aiMaterial* mat, aiTextureType type, fs::path objParent,
-    unsigned int options = TEXTURE_OPTION_MIPMAP |
-                           TEXTURE_OPTION_CONVERT_TO_LINEAR) {
-    vector<Texture2D> textures;
+static string getMaterialTexturePath(const aiMaterial* mat,
+                                     aiTextureType type) {
     if (mat->GetTextureCount(type)) {
         // TODO: support multilayer texture
         aiString str;
         mat->GetTexture(type, 0, &str);
-        return createTexture2DFromFile(
-            uniqueTexture, (objParent / str.C_Str()).string(), options);
+        return str.C_Str();
     } else {
-        return nullptr;
+        return {};
     }
 }
 
 static BlinnPhongWorkFlow createBlinnPhongWorkFlowFromAssimp(
-    const aiMaterial* aMaterial, fs::path objParent) {
+    const aiMaterial* aMaterial) {
     aiColor3D color(0, 0, 0);
     aMaterial->Get(AI_MATKEY_COLOR_AMBIENT, color);
     glm::vec3 ambient = aiColor3D2Glm(color);
@@ -60,8 +56,8 @@ static BlinnPhongWorkFlow createBlinnPhongWorkFlowFromAssimp(
                               shininess);
 }
 
-static MetallicRoughnessWorkFlow createMetallicRoughnessWorkFlowFromAssimp(
-    const aiMaterial* aMaterial, fs::path objParent) {
+MetallicRoughnessWorkFlow createMetallicRoughnessFactorsFromAssimp(
+    const aiMaterial* aMaterial) {
     aiColor3D color(0, 0, 0);
     aMaterial->Get(AI_MATKEY_BASE_COLOR, color);
     glm::vec3 baseColor = aiColor3D2Glm(color);
@@ -75,55 +71,78 @@ static MetallicRoughnessWorkFlow createMetallicRoughnessWorkFlowFromAssimp(
     aMaterial->Get(AI_MATKEY_VOLUME_ATTENUATION_COLOR, color);
     glm::vec3 sigma_a = aiColor3D2Glm(color);
     aMaterial->Get(AI_MATKEY_VOLUME_ATTENUATION_DISTANCE, mfp);
+    return MetallicRoughnessWorkFlow(baseColor, metallic, roughness,
+                                     transmission, glm::vec3(1 / mfp), sigma_a);
+}
 
-    auto baseColorTex =
-        createMaterialTextures(aMaterial, aiTextureType_BASE_COLOR, objParent);
-    auto occlusionTex = createMaterialTextures(
-        aMaterial, aiTextureType_AMBIENT_OCCLUSION, objParent);
-    auto metallicTex =
-        createMaterialTextures(aMaterial, aiTextureType_METALNESS, objParent);
-    auto roughnessTex = createMaterialTextures(
-        aMaterial, aiTextureType_DIFFUSE_ROUGHNESS, objParent);
-
-    auto workflow =
-        MetallicRoughnessWorkFlow(baseColor, metallic, roughness, transmission,
-                                  glm::vec3(1 / mfp), sigma_a);
-    workflow.baseColorTex = baseColorTex;
-    workflow.occlusionTex = occlusionTex;
-    workflow.metallicTex = metallicTex;
-    workflow.roughnessTex = roughnessTex;
-    return workflow;
+// Assimp texture type of every BaseMaterialTexture slot
+static const aiTextureType baseMaterialTextureTypes[] = {
+    aiTextureType_DIFFUSE,           aiTextureType_AMBIENT,
+    aiTextureType_DISPLACEMENT,      aiTextureType_NORMALS,
+    aiTextureType_SPECULAR,          aiTextureType_OPACITY,
+    aiTextureType_HEIGHT,            aiTextureType_BASE_COLOR,
+    aiTextureType_AMBIENT_OCCLUSION, aiTextureType_METALNESS,
+    aiTextureType_DIFFUSE_ROUGHNESS};
+static_assert(size(baseMaterialTextureTypes) == BASE_MATERIAL_TEXTURE_COUNT);
+
+BaseMaterialDescription describeBaseMaterialFromAssimp(
+    const aiMaterial* aMaterial) {
+    BaseMaterialDescription description;
+    description.bpWorkFlow = createBlinnPhongWorkFlowFromAssimp(aMaterial);
+    description.mrWorkFlow =
+        createMetallicRoughnessFactorsFromAssimp(aMaterial);
+    for (int i = 0; i < BASE_MATERIAL_TEXTURE_COUNT; i++) {
+        description.texturePaths[i] =
+            getMaterialTexturePath(aMaterial, baseMaterialTextureTypes[i]);
+    }
+    return description;
 }
 
-std::shared_ptr<BaseMaterial> createBaseMaterialFromAssimp(
-    const aiMaterial* aMaterial, fs::path objParent) {
-    auto blinnPhong = createBlinnPhongWorkFlowFromAssimp(aMaterial, objParent);
-    auto metallicRoughness =
-        createMetallicRoughnessWorkFlowFromAssimp(aMaterial, objParent);
-    auto material = make_shared<BaseMaterial>(blinnPhong, metallicRoughness);
+shared_ptr<BaseMaterial> createBaseMaterial(
+    const BaseMaterialDescription& description, fs::path objParent) {
+    auto texture = [&](BaseMaterialTexture slot,
+                       unsigned int options = TEXTURE_OPTION_MIPMAP |
+                                              TEXTURE_OPTION_CONVERT_TO_LINEAR)
+        -> shared_ptr<Texture2D> {
+        const auto& path = description.texturePaths[int(slot)];
+        if (path.empty())
+            return nullptr;
+        return createTexture2DFromFile(
+            uniqueTexture, (objParent / path).string(), options);
+    };
+    auto metallicRoughness = description.mrWorkFlow;
+    metallicRoughness.baseColorTex = texture(BaseMaterialTexture::BaseColor);
+    metallicRoughness.occlusionTex = texture(BaseMaterialTexture::Occlusion);
+    metallicRoughness.metallicTex = texture(BaseMaterialTexture::Metallic);
+    metallicRoughness.roughnessTex = texture(BaseMaterialTexture::Roughness);
+    auto material =
+        make_shared<BaseMaterial>(description.bpWorkFlow, metallicRoughness);
 
     // read common textures
-    material->ambientTex =
-        createMaterialTextures(aMaterial, aiTextureType_AMBIENT, objParent);
+    material->ambientTex = texture(BaseMaterialTexture::Ambient);
 
-    material->diffuseTex =
-        createMaterialTextures(aMaterial, aiTextureType_DIFFUSE, objParent);
+    material->diffuseTex = texture(BaseMaterialTexture::Diffuse);
 
-    material->specularTex =
-        createMaterialTextures(aMaterial, aiTextureType_SPECULAR, objParent);
+    material->specularTex = texture(BaseMaterialTexture::Specular);
 
-    material->displacementTex = createMaterialTextures(
-        aMaterial, aiTextureType_DISPLACEMENT, objParent, 0x0);
+    material->displacementTex =
+        texture(BaseMaterialTexture::Displacement, 0x0);
     // material->displacementTex->setSizeFilter(GL_NEAREST, GL_NEAREST);
     // obj file saves normal map as bump maps
     // FUCK YOU, wavefront obj
-    material->normalTex = createMaterialTextures(
-        aMaterial, aiTextureType_NORMALS, objParent, TEXTURE_OPTION_MIPMAP);
-    material->opacityTex = createMaterialTextures(
-        aMaterial, aiTextureType_OPACITY, objParent, TEXTURE_OPTION_MIPMAP);
-    material->heightTex = createMaterialTextures(
-        aMaterial, aiTextureType_HEIGHT, objParent, TEXTURE_OPTION_MIPMAP);
+    material->normalTex =
+        texture(BaseMaterialTexture::Normal, TEXTURE_OPTION_MIPMAP);
+    material->opacityTex =
+        texture(BaseMaterialTexture::Opacity, TEXTURE_OPTION_MIPMAP);
+    material->heightTex =
+        texture(BaseMaterialTexture::Height, TEXTURE_OPTION_MIPMAP);
 
     return material;
 }
+
+std::shared_ptr<BaseMaterial> createBaseMaterialFromAssimp(
+    const aiMaterial* aMaterial, fs::path objParent) {
+    return createBaseMaterial(describeBaseMaterialFromAssimp(aMaterial),
+                              objParent);
+}
 }  // namespace loo
\ No newline at end of file
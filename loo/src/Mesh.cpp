@@ -1,97 +1,477 @@
 #include "loo/Mesh.hpp"
 
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <glog/logging.h>
 #include <meshoptimizer.h>
 
+#include <algorithm>
 #include <assimp/Importer.hpp>
+#include <chrono>
 #include <filesystem>
 #include <memory>
+#include <sstream>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm/ext.hpp"
+#include "loo/MeshCache.hpp"
+#include "loo/Parallel.hpp"
 namespace loo {
 using namespace std;
 using namespace glm;
 namespace fs = std::filesystem;
 
-void Vertex::orthogonalizeTangent() {
-    tangent = normalize(tangent);
-    normal = normalize(normal);
-    tangent = normalize(tangent - dot(tangent, normal) * normal);
-    auto B = cross(normal, tangent);
-    if (dot(B, bitangent) < 0) {
-        // flip bitangent if necessary
-        // THIS IS IMPORTANT
-        B = -B;
+// offset of the attribute stream behind the geometry stream in the buffer
+constexpr size_t MESH_STREAM_ALIGNMENT = 256;
+
+// the geometry stream on locations 0 and 1, the bitangent sign of the
+// quantized format included
+static void setupGeometryStream(VertexFormat format) {
+    GLsizei stride = geometryStride(format);
+    if (format == VertexFormat::Quantized) {
+        glVertexAttribPointer(
+            0, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+            (GLvoid*)offsetof(PackedGeometryVertex, position));
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride,
+                              (GLvoid*)offsetof(PackedGeometryVertex, normal));
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                              (GLvoid*)offsetof(GeometryVertex, position));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                              (GLvoid*)offsetof(GeometryVertex, normal));
     }
-    bitangent = B;
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
 }
 
-void Mesh::prepare() {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+// locations 2 to 4 from the attribute stream at offset, the quantized
+// format has no bitangent, the shaders rebuild it
+static void setupAttributeStream(VertexFormat format, size_t offset) {
+    GLsizei stride = attributeStride(format);
+    auto at = [offset](size_t member) { return (GLvoid*)(offset + member); };
+    if (format == VertexFormat::Quantized) {
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+                              at(offsetof(PackedAttributeVertex, texCoord)));
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, stride,
+                              at(offsetof(PackedAttributeVertex, tangent)));
+        glEnableVertexAttribArray(2);
+        glEnableVertexAttribArray(3);
+        return;
+    }
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                          at(offsetof(AttributeVertex, texCoord)));
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride,
+                          at(offsetof(AttributeVertex, tangent)));
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride,
+                          at(offsetof(AttributeVertex, bitangent)));
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+    glEnableVertexAttribArray(4);
+}
 
-    glBindVertexArray(vao);
+void Mesh::prepareBounds(VertexFormat format) {
+    m_vertexformat = format;
+    if (countVertex() > 0) {
+        const Vertex* vertexData = getVertexData();
+        m_bounds.min = m_bounds.max = vertexData[0].position;
+        for (size_t i = 1; i < countVertex(); i++) {
+            m_bounds.min = glm::min(m_bounds.min, vertexData[i].position);
+            m_bounds.max = glm::max(m_bounds.max, vertexData[i].position);
+        }
+    }
+    if (format == VertexFormat::Quantized) {
+        m_quantization =
+            computeVertexQuantization(getVertexData(), countVertex());
+    }
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-                 vertices.data(), GL_STATIC_DRAW);
+static size_t alignStreamOffset(size_t offset) {
+    return (offset + MESH_STREAM_ALIGNMENT - 1) / MESH_STREAM_ALIGNMENT *
+           MESH_STREAM_ALIGNMENT;
+}
 
+// the two VAOs over a vertex buffer holding the geometry streams and at
+// attributeOffset the attribute streams
+static void setupVertexArrays(GLuint vao, GLuint geometryVao, GLuint ebo,
+                              VertexFormat format, size_t attributeOffset) {
+    glBindVertexArray(vao);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-                 indices.data(), GL_STATIC_DRAW);
+    setupGeometryStream(format);
+    setupAttributeStream(format, attributeOffset);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(0);
+    // the passes that only need position and normal fetch the geometry
+    // stream alone
+    glBindVertexArray(geometryVao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    setupGeometryStream(format);
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)(offsetof(Vertex, normal)));
-    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+}
 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)offsetof(Vertex, texCoord));
-    glEnableVertexAttribArray(2);
+void Mesh::prepare(VertexFormat format) {
+    glGenVertexArrays(1, &vao);
+    glGenVertexArrays(1, &geometryVao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
 
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)(offsetof(Vertex, tangent)));
-    glEnableVertexAttribArray(3);
+    prepareBounds(format);
+    // both streams in one buffer, written straight into its mapping so
+    // neither the split nor the packed vertices need a copy on the CPU
+    size_t attributeOffset =
+        alignStreamOffset(countVertex() * geometryStride(format));
+    size_t bufferSize =
+        attributeOffset + countVertex() * attributeStride(format);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, bufferSize, nullptr, GL_STATIC_DRAW);
+    if (bufferSize > 0) {
+        auto mapped = static_cast<unsigned char*>(glMapBufferRange(
+            GL_ARRAY_BUFFER, 0, bufferSize,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        writeVertexStreams(getVertexData(), countVertex(), format,
+                           m_quantization, mapped, mapped + attributeOffset);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
 
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)offsetof(Vertex, bitangent));
-    glEnableVertexAttribArray(4);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, countIndex() * sizeof(unsigned int),
+                 getIndexData(), GL_STATIC_DRAW);
+    setupVertexArrays(vao, geometryVao, ebo, format, attributeOffset);
+    logPossibleGLError();
+}
 
-    glBindVertexArray(0);
+void prepareSharedBuffers(const vector<shared_ptr<Mesh>>& meshes,
+                          VertexFormat format) {
+    size_t vertexCount = 0, indexCount = 0;
+    for (const auto& mesh : meshes) {
+        mesh->prepareBounds(format);
+        mesh->m_basevertex = int32_t(vertexCount);
+        mesh->m_firstindex = uint32_t(indexCount);
+        vertexCount += mesh->countVertex();
+        indexCount += mesh->countIndex();
+    }
+    GLuint vao, geometryVao, vbo, ebo;
+    glGenVertexArrays(1, &vao);
+    glGenVertexArrays(1, &geometryVao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+
+    // the geometry streams of all meshes, then their attribute streams, so
+    // one base vertex addresses both
+    const size_t geometrySize = geometryStride(format),
+                 attributeSize = attributeStride(format);
+    size_t attributeOffset = alignStreamOffset(vertexCount * geometrySize);
+    size_t bufferSize = attributeOffset + vertexCount * attributeSize;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, bufferSize, nullptr, GL_STATIC_DRAW);
+    if (bufferSize > 0) {
+        auto mapped = static_cast<unsigned char*>(glMapBufferRange(
+            GL_ARRAY_BUFFER, 0, bufferSize,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        for (const auto& mesh : meshes) {
+            size_t base = mesh->m_basevertex;
+            writeVertexStreams(
+                mesh->getVertexData(), mesh->countVertex(), format,
+                mesh->m_quantization, mapped + base * geometrySize,
+                mapped + attributeOffset + base * attributeSize);
+        }
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int),
+                 nullptr, GL_STATIC_DRAW);
+    if (indexCount > 0) {
+        auto mapped = static_cast<unsigned int*>(glMapBufferRange(
+            GL_ELEMENT_ARRAY_BUFFER, 0, indexCount * sizeof(unsigned int),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        for (const auto& mesh : meshes) {
+            std::copy_n(mesh->getIndexData(), mesh->countIndex(),
+                        mapped + mesh->m_firstindex);
+        }
+        glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    }
+    setupVertexArrays(vao, geometryVao, ebo, format, attributeOffset);
+    for (const auto& mesh : meshes) {
+        mesh->vao = vao;
+        mesh->geometryVao = geometryVao;
+        mesh->vbo = vbo;
+        mesh->ebo = ebo;
+    }
+    logPossibleGLError();
 }
 
 size_t Mesh::countVertex() const {
-    return vertices.size();
+    return m_mapping ? m_mappedvertexcount : vertices.size();
+}
+size_t Mesh::countIndex() const {
+    return m_mapping ? m_mappedindexcount : indices.size();
+}
+size_t Mesh::countLod() const {
+    return lods.empty() ? 1 : lods.size();
+}
+MeshLod Mesh::getLod(int lod) const {
+    if (lods.empty())
+        return {0, uint32_t(countIndex()), 0.0f};
+    return lods[glm::clamp(lod, 0, int(lods.size()) - 1)];
+}
+size_t Mesh::countTriangles(int lod) const {
+    return getLod(lod).indexCount / 3;
 }
-size_t Mesh::countTriangles(bool lod) const {
-    return indices.size() / 3;
+const Vertex* Mesh::getVertexData() const {
+    return m_mapping ? m_mappedvertices : vertices.data();
+}
+const unsigned int* Mesh::getIndexData() const {
+    return m_mapping ? m_mappedindices : indices.data();
+}
+
+int Mesh::selectLod(float screenError) const {
+    // the errors grow along the chain
+    int selected = 0;
+    for (size_t i = 1; i < lods.size(); i++) {
+        if (lods[i].error * m_screenproportion > screenError)
+            break;
+        selected = i;
+    }
+    return selected;
 }
 
-void Mesh::draw(ShaderProgram& sp, GLenum drawMode, bool tessellation) const {
+void Mesh::draw(ShaderProgram& sp, GLenum drawMode, bool tessellation,
+                bool geometryOnly, int lod) const {
+    auto range = getLod(lod);
+    draw(sp, drawMode, tessellation, geometryOnly, lod,
+         {{range.indexOffset, range.indexCount}});
+}
+
+void Mesh::draw(ShaderProgram& sp, GLenum drawMode, bool tessellation,
+                bool geometryOnly, int lod,
+                const vector<IndexRange>& ranges) const {
+    if (ranges.empty())
+        return;
     glPolygonMode(GL_FRONT_AND_BACK, drawMode);
-    glBindVertexArray(vao);
+    glBindVertexArray(geometryOnly ? geometryVao : vao);
     // bind material uniforms
     material->bind(sp);
-    sp.setUniform("meshLod", false);
+    sp.setUniform("meshLod", lod);
+    sp.setUniform("vertexQuantized",
+                  int(m_vertexformat == VertexFormat::Quantized));
+    sp.setUniform("vertexPositionMin", m_quantization.positionMin);
+    sp.setUniform("vertexPositionExtent", m_quantization.positionExtent);
+    sp.setUniform("drawIndirect", 0);
     logPossibleGLError();
-    glDrawElements(tessellation ? GL_PATCHES : GL_TRIANGLES,
-                   static_cast<GLuint>(indices.size()), GL_UNSIGNED_INT,
-                   (void*)(0));
+    GLenum mode = tessellation ? GL_PATCHES : GL_TRIANGLES;
+    auto offset = [this](const IndexRange& range) {
+        return (const void*)((m_firstindex + range.indexOffset) *
+                             sizeof(unsigned int));
+    };
+    if (ranges.size() == 1) {
+        glDrawElementsBaseVertex(
+            mode, static_cast<GLsizei>(ranges[0].indexCount), GL_UNSIGNED_INT,
+            const_cast<void*>(offset(ranges[0])), m_basevertex);
+    } else {
+        vector<GLsizei> counts(ranges.size());
+        vector<const void*> offsets(ranges.size());
+        vector<GLint> baseVertices(ranges.size(), m_basevertex);
+        for (size_t i = 0; i < ranges.size(); i++) {
+            counts[i] = static_cast<GLsizei>(ranges[i].indexCount);
+            offsets[i] = offset(ranges[i]);
+        }
+        glMultiDrawElementsBaseVertex(
+            mode, counts.data(), GL_UNSIGNED_INT, offsets.data(),
+            static_cast<GLsizei>(ranges.size()), baseVertices.data());
+    }
 
     glBindVertexArray(0);
 }
 
-void Mesh::updateLod(float screenProportion) {}
+size_t Mesh::cullMeshlets(const Frustum& frustum, bool coneCulling,
+                          vector<IndexRange>& ranges) const {
+    size_t kept = 0;
+    size_t firstRange = ranges.size();
+    for (const auto& meshlet : meshlets) {
+        if (!frustum.intersects(meshlet.center, meshlet.radius) ||
+            (coneCulling && frustum.backfacing(meshlet.coneApex,
+                                               meshlet.coneAxis,
+                                               meshlet.coneCutoff)))
+            continue;
+        kept++;
+        // meshlets are stored in index order, survivors next to each other
+        // become one range
+        if (ranges.size() > firstRange &&
+            ranges.back().indexOffset + ranges.back().indexCount ==
+                meshlet.indexOffset) {
+            ranges.back().indexCount += meshlet.indexCount;
+        } else {
+            ranges.push_back({meshlet.indexOffset, meshlet.indexCount});
+        }
+    }
+    return kept;
+}
+
+// the usual post-transform cache size of desktop GPUs
+constexpr unsigned int MESH_CACHE_SIZE = 16;
+
+MeshCacheStatistics analyzeMeshCache(const Mesh& mesh) {
+    MeshCacheStatistics statistics;
+    auto full = mesh.getLod(0);
+    if (full.indexCount == 0)
+        return statistics;
+    auto result = meshopt_analyzeVertexCache(
+        mesh.getIndexData() + full.indexOffset, full.indexCount,
+        mesh.countVertex(), MESH_CACHE_SIZE, 0, 0);
+    statistics.verticesTransformed = result.vertices_transformed;
+    statistics.acmr = result.acmr;
+    statistics.atvr = result.atvr;
+    return statistics;
+}
+
+// the meshlet limits meshoptimizer recommends for NVIDIA hardware, the
+// triangle count a multiple of 4 as v0.18 requires
+constexpr size_t MESHLET_MAX_VERTICES = 64, MESHLET_MAX_TRIANGLES = 124;
+// how much the clustering favours tight normal cones over compact spheres
+constexpr float MESHLET_CONE_WEIGHT = 0.25f;
+
+// regroups the triangles by meshlet so each meshlet is a range of the index
+// buffer that can be drawn from the regular VAO
+static void buildMeshlets(Mesh& mesh) {
+    auto& vertices = mesh.vertices;
+    auto& indices = mesh.indices;
+    const size_t indexCount = indices.size();
+    size_t maxMeshlets = meshopt_buildMeshletsBound(
+        indexCount, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+    vector<meshopt_Meshlet> clusters(maxMeshlets);
+    vector<unsigned int> clusterVertices(maxMeshlets * MESHLET_MAX_VERTICES);
+    vector<unsigned char> clusterTriangles(maxMeshlets *
+                                           MESHLET_MAX_TRIANGLES * 3);
+    size_t clusterCount = meshopt_buildMeshlets(
+        clusters.data(), clusterVertices.data(), clusterTriangles.data(),
+        indices.data(), indexCount, &vertices[0].position.x, vertices.size(),
+        sizeof(Vertex), MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES,
+        MESHLET_CONE_WEIGHT);
+
+    vector<unsigned int> grouped;
+    grouped.reserve(indexCount);
+    mesh.meshlets.clear();
+    mesh.meshlets.reserve(clusterCount);
+    for (size_t i = 0; i < clusterCount; i++) {
+        const auto& cluster = clusters[i];
+        const unsigned int* local = &clusterVertices[cluster.vertex_offset];
+        const unsigned char* triangles =
+            &clusterTriangles[cluster.triangle_offset];
+        auto bounds = meshopt_computeMeshletBounds(
+            local, triangles, cluster.triangle_count, &vertices[0].position.x,
+            vertices.size(), sizeof(Vertex));
+        Meshlet meshlet;
+        meshlet.indexOffset = grouped.size();
+        meshlet.indexCount = cluster.triangle_count * 3;
+        meshlet.center = make_vec3(bounds.center);
+        meshlet.radius = bounds.radius;
+        meshlet.coneApex = make_vec3(bounds.cone_apex);
+        meshlet.coneAxis = make_vec3(bounds.cone_axis);
+        meshlet.coneCutoff = bounds.cone_cutoff;
+        mesh.meshlets.push_back(meshlet);
+        for (size_t k = 0; k < meshlet.indexCount; k++)
+            grouped.push_back(local[triangles[k]]);
+    }
+    CHECK_EQ(grouped.size(), indexCount);
+    indices = std::move(grouped);
+}
+
+// the simplified levels behind the full one. Every level is simplified from
+// the full mesh, so the errors don't accumulate along the chain
+static void appendMeshLods(Mesh& mesh, const MeshOptimizeOptions& options) {
+    auto& vertices = mesh.vertices;
+    auto& indices = mesh.indices;
+    const size_t indexCount = indices.size();
+    mesh.lods = {{0, uint32_t(indexCount), 0.0f}};
+    vector<unsigned int> simplified(indexCount);
+    float ratio = 1.0f;
+    for (unsigned int level = 1; level <= options.lodLevels; level++) {
+        ratio *= options.lodReduction;
+        size_t target = size_t(indexCount * ratio) / 3 * 3;
+        float error = 0.0f;
+        size_t count = meshopt_simplify(
+            simplified.data(), indices.data(), indexCount,
+            &vertices[0].position.x, vertices.size(), sizeof(Vertex), target,
+            options.lodMaxError, 0, &error);
+        // stuck at the error bound, a level that barely shrinks only costs
+        // index memory
+        size_t previousCount = mesh.lods.back().indexCount;
+        if (count == 0 || count > previousCount * 9 / 10)
+            break;
+        size_t offset = indices.size();
+        indices.resize(offset + count);
+        meshopt_optimizeVertexCache(indices.data() + offset, simplified.data(),
+                                    count, vertices.size());
+        mesh.lods.push_back({uint32_t(offset), uint32_t(count), error});
+    }
+    if (mesh.lods.size() == 1)
+        mesh.lods.clear();
+}
+
+void optimizeMesh(Mesh& mesh, const MeshOptimizeOptions& options) {
+    // cache entries are stored optimized
+    if (mesh.isMapped())
+        return;
+    if (!mesh.lods.empty() || !mesh.meshlets.empty()) {
+        LOG(WARNING) << "Mesh " << mesh.name
+                     << " already has levels of detail or meshlets, not "
+                        "optimized";
+        return;
+    }
+    auto& vertices = mesh.vertices;
+    auto& indices = mesh.indices;
+    if (indices.empty())
+        return;
+    if (indices.size() % 3 != 0) {
+        LOG(WARNING) << "Mesh " << mesh.name
+                     << " is not a triangle list, not optimized";
+        return;
+    }
+    const size_t indexCount = indices.size();
+    if (options.weld) {
+        vector<unsigned int> remap(vertices.size());
+        size_t vertexCount = meshopt_generateVertexRemap(
+            remap.data(), indices.data(), indexCount, vertices.data(),
+            vertices.size(), sizeof(Vertex));
+        vector<unsigned int> welded(indexCount);
+        meshopt_remapIndexBuffer(welded.data(), indices.data(), indexCount,
+                                 remap.data());
+        vector<Vertex> weldedVertices(vertexCount);
+        meshopt_remapVertexBuffer(weldedVertices.data(), vertices.data(),
+                                  vertices.size(), sizeof(Vertex),
+                                  remap.data());
+        indices = std::move(welded);
+        vertices = std::move(weldedVertices);
+    }
+    if (options.vertexCache) {
+        vector<unsigned int> reordered(indexCount);
+        meshopt_optimizeVertexCache(reordered.data(), indices.data(),
+                                    indexCount, vertices.size());
+        indices = std::move(reordered);
+    }
+    if (options.overdrawThreshold > 0) {
+        vector<unsigned int> reordered(indexCount);
+        meshopt_optimizeOverdraw(reordered.data(), indices.data(), indexCount,
+                                 &vertices[0].position.x, vertices.size(),
+                                 sizeof(Vertex), options.overdrawThreshold);
+        indices = std::move(reordered);
+    }
+    if (options.vertexFetch) {
+        vector<Vertex> reordered(vertices.size());
+        // unreferenced vertices are dropped
+        size_t vertexCount = meshopt_optimizeVertexFetch(
+            reordered.data(), indices.data(), indexCount, vertices.data(),
+            vertices.size(), sizeof(Vertex));
+        reordered.resize(vertexCount);
+        vertices = std::move(reordered);
+    }
+    if (options.meshlets)
+        buildMeshlets(mesh);
+    if (options.lodLevels > 0)
+        appendMeshLods(mesh, options);
+}
 
 using namespace Assimp;
 
@@ -118,16 +498,12 @@ static inline glm::mat4 convertMat4AssimpToGLM(const aiMatrix4x4& from) {
 }
 
 // https://learnopengl-cn.github.io/03%20Model%20Loading/03%20Model/
-static std::shared_ptr<Mesh> processAssimpMesh(
-    aiMesh* mesh, const aiScene* scene, fs::path objParent,
-    const glm::mat4& parentTransform) {
-    // data to fill
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture2D> textures;
-    unordered_map<Vertex, unsigned int> uniqueVertices;
-
+// vertices and indices of an aiMesh, touches no GL state so the meshes of a
+// file are converted in parallel
+static void convertAssimpMesh(const aiMesh* mesh, vector<Vertex>& vertices,
+                              vector<unsigned int>& indices) {
     // walk through each of the mesh's vertices
+    vertices.reserve(mesh->mNumVertices);
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
         Vertex vertex{};
         glm::vec3 vector;  // we declare a placeholder vector since assimp uses
@@ -180,67 +556,277 @@ static std::shared_ptr<Mesh> processAssimpMesh(
 
     // now wak through each of the mesh's faces (a face is a mesh its triangle)
     // and retrieve the corresponding vertex indices.
+    indices.reserve(size_t(mesh->mNumFaces) * 3);
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
         aiFace face = mesh->mFaces[i];
         // retrieve all indices of the face and store them in the indices vector
         for (unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);
     }
-    // process materials
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-    // we assume a convention for sampler names in the shaders. Each diffuse
-    // texture should be named as 'texture_diffuseN' where N is a sequential
-    // number ranging from 1 to MAX_SAMPLER_NUMBER. Same applies to other
-    // texture as the following list summarizes: diffuse: texture_diffuseN
-    // specular: texture_specularN
-    // normal: texture_normalN
-    auto mat = createBaseMaterialFromAssimp(material, objParent);
-
-    // return a mesh object created from the extracted mesh data
-    return make_shared<Mesh>(std::move(vertices), std::move(indices), mat,
-                             mesh->mName.C_Str(), parentTransform);
 }
 
-static void processAssimpNode(aiNode* node, const aiScene* scene,
-                              vector<shared_ptr<Mesh>>& meshes,
-                              fs::path objParent,
+// an aiMesh and the transforms of the nodes referencing it
+struct AssimpMeshInstances {
+    const aiMesh* mesh;
+    vector<glm::mat4> transforms;
+};
+
+// depth first like the former recursive conversion, which fixes the order of
+// the meshes of a file. slots maps the aiMesh indices to their entries in
+// instances, -1 until the first reference
+static void collectAssimpNode(const aiNode* node, const aiScene* scene,
+                              vector<AssimpMeshInstances>& instances,
+                              vector<int>& slots,
                               const glm::mat4& parentTransform) {
     auto nodeTransform = convertMat4AssimpToGLM(node->mTransformation);
     nodeTransform = parentTransform * nodeTransform;
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(
-            processAssimpMesh(mesh, scene, objParent, nodeTransform));
+        int& slot = slots[node->mMeshes[i]];
+        if (slot < 0) {
+            slot = int(instances.size());
+            instances.push_back({scene->mMeshes[node->mMeshes[i]], {}});
+        }
+        instances[slot].transforms.push_back(nodeTransform);
     }
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processAssimpNode(node->mChildren[i], scene, meshes, objParent,
+        collectAssimpNode(node->mChildren[i], scene, instances, slots,
                           nodeTransform);
     }
 }
 
-vector<shared_ptr<Mesh>> createMeshFromFile(const string& filename,
-                                            const glm::mat4& sceneTransform) {
-    Importer importer;
+// vertices and cache statistics summed over all meshes of a file
+struct MeshSetStatistics {
+    size_t vertices{0}, triangles{0}, verticesTransformed{0};
+    void add(const Mesh& mesh) {
+        vertices += mesh.countVertex();
+        triangles += mesh.countTriangles();
+        verticesTransformed += analyzeMeshCache(mesh).verticesTransformed;
+    }
+    void add(const MeshSetStatistics& other) {
+        vertices += other.vertices;
+        triangles += other.triangles;
+        verticesTransformed += other.verticesTransformed;
+    }
+    double acmr() const {
+        return triangles ? double(verticesTransformed) / triangles : 0.0;
+    }
+    double atvr() const {
+        return vertices ? double(verticesTransformed) / vertices : 0.0;
+    }
+};
+
+static double millisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start)
+        .count();
+}
+
+// the post processing every model gets, part of the mesh cache key
+constexpr unsigned int MESH_IMPORT_FLAGS =
+    aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals |
+    aiProcess_CalcTangentSpace;
+
+// the default file system that remembers what the importer opens, the
+// buffers of a glTF or the material library of an OBJ end up in the mesh
+// cache entry as its dependencies
+class RecordingIOSystem : public DefaultIOSystem {
+   public:
+    IOStream* Open(const char* file, const char* mode = "rb") override {
+        IOStream* stream = DefaultIOSystem::Open(file, mode);
+        if (stream)
+            m_opened.push_back(file);
+        return stream;
+    }
+    const vector<string>& getOpened() const { return m_opened; }
+
+   private:
+    vector<string> m_opened;
+};
+
+static vector<shared_ptr<Mesh>> createMeshFromCache(
+    const MeshCacheEntry& entry, const fs::path& fileParent) {
     vector<shared_ptr<Mesh>> meshes;
+    meshes.reserve(entry.meshes.size());
+    // one material per entry of the file, shared by the meshes using it
+    vector<shared_ptr<BaseMaterial>> materials(entry.materials.size());
+    for (const auto& record : entry.meshes) {
+        auto& material = materials[record.material];
+        if (!material)
+            material = createBaseMaterial(entry.materials[record.material],
+                                          fileParent);
+        meshes.push_back(make_shared<Mesh>(
+            entry.mapping, record.vertices, record.vertexCount, record.indices,
+            record.indexCount, material, record.name, record.transform));
+        meshes.back()->lods = record.lods;
+        meshes.back()->meshlets = record.meshlets;
+        meshes.back()->instances = record.instances;
+    }
+    return meshes;
+}
+
+vector<shared_ptr<Mesh>> createMeshFromFile(
+    const string& filename, const glm::mat4& sceneTransform,
+    const MeshOptimizeOptions& optimizeOptions,
+    const fs::path& cacheDirectory, unsigned int nThreads) {
     fs::path filePath(filename);
     fs::path fileParent = filePath.parent_path();
-    const auto scene = importer.ReadFile(
-        filename, aiProcess_Triangulate | aiProcess_FlipUVs |
-                      aiProcess_GenNormals | aiProcess_GenNormals |
-                      aiProcess_CalcTangentSpace);
+    fs::path cachePath;
+    string cacheKey;
+    if (!cacheDirectory.empty()) {
+        auto cacheStart = chrono::steady_clock::now();
+        cacheKey = meshCacheKey(filename, MESH_IMPORT_FLAGS, sceneTransform,
+                                optimizeOptions);
+        if (!cacheKey.empty())
+            cachePath = cacheDirectory / (cacheKey + ".loomesh");
+        MeshCacheEntry entry;
+        error_code ec;
+        if (!cachePath.empty() && fs::exists(cachePath, ec) &&
+            loadMeshCache(cachePath, cacheKey, entry)) {
+            // the entry is replaced by the import below
+            if (!checkMeshCacheDependencies(entry, filePath)) {
+                LOG(INFO) << "Files referenced by " << filename
+                          << " changed, mesh cache " << cachePath
+                          << " is stale";
+            } else {
+                auto meshes = createMeshFromCache(entry, fileParent);
+                LOG(INFO) << "Loaded " << meshes.size() << " meshes of "
+                          << filename << " from mesh cache " << cachePath
+                          << " in " << millisecondsSince(cacheStart) << " ms";
+                return meshes;
+            }
+        }
+    }
+
+    Importer importer;
+    // owned by the importer
+    auto ioSystem = new RecordingIOSystem;
+    importer.SetIOHandler(ioSystem);
+    auto importStart = chrono::steady_clock::now();
+    const auto scene = importer.ReadFile(filename, MESH_IMPORT_FLAGS);
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
         !scene->mRootNode) {
         LOG(ERROR) << "Assimp: " << importer.GetErrorString() << endl;
         return {};
     }
-    processAssimpNode(scene->mRootNode, scene, meshes, fileParent,
+    double importMs = millisecondsSince(importStart);
+
+    vector<AssimpMeshInstances> instances;
+    vector<int> slots(scene->mNumMeshes, -1);
+    collectAssimpNode(scene->mRootNode, scene, instances, slots,
                       sceneTransform);
-    return std::move(meshes);
-}
 
-bool Vertex::operator==(const Vertex& v) const {
-    return position == v.position && normal == v.normal &&
-           texCoord == v.texCoord && tangent == v.tangent &&
-           bitangent == v.bitangent;
+    // materials load their textures into GL, so they stay on this thread
+    auto materialStart = chrono::steady_clock::now();
+    vector<BaseMaterialDescription> descriptions(scene->mNumMaterials);
+    for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+        descriptions[i] = describeBaseMaterialFromAssimp(scene->mMaterials[i]);
+    }
+    // one material per aiMaterial, the meshes using it share it so indirect
+    // draws can group them
+    vector<shared_ptr<BaseMaterial>> sceneMaterials(scene->mNumMaterials);
+    vector<shared_ptr<BaseMaterial>> materials(instances.size());
+    vector<uint32_t> meshMaterials(instances.size());
+    for (size_t i = 0; i < instances.size(); i++) {
+        // we assume a convention for sampler names in the shaders. Each
+        // diffuse texture should be named as 'texture_diffuseN' where N is a
+        // sequential number ranging from 1 to MAX_SAMPLER_NUMBER. Same
+        // applies to other texture as the following list summarizes:
+        // diffuse: texture_diffuseN
+        // specular: texture_specularN
+        // normal: texture_normalN
+        meshMaterials[i] = instances[i].mesh->mMaterialIndex;
+        auto& material = sceneMaterials[meshMaterials[i]];
+        if (!material)
+            material =
+                createBaseMaterial(descriptions[meshMaterials[i]], fileParent);
+        materials[i] = material;
+    }
+    double materialMs = millisecondsSince(materialStart);
+
+    // every worker writes its own slots only, the meshes keep the order of
+    // the scene graph whatever the thread count
+    auto meshStart = chrono::steady_clock::now();
+    vector<shared_ptr<Mesh>> meshes(instances.size());
+    vector<MeshSetStatistics> before(instances.size()),
+        after(instances.size());
+    vector<double> convertMs(instances.size()), optimizeMs(instances.size());
+    parallelFor(
+        instances.size(),
+        [&](size_t i) {
+            auto convertStart = chrono::steady_clock::now();
+            vector<Vertex> vertices;
+            vector<unsigned int> indices;
+            convertAssimpMesh(instances[i].mesh, vertices, indices);
+            const auto& transforms = instances[i].transforms;
+            // a single copy keeps its transform in objectMatrix
+            meshes[i] = make_shared<Mesh>(
+                std::move(vertices), std::move(indices), materials[i],
+                instances[i].mesh->mName.C_Str(),
+                transforms.size() == 1 ? transforms[0] : glm::mat4(1.0f));
+            if (transforms.size() > 1)
+                meshes[i]->instances = transforms;
+            convertMs[i] = millisecondsSince(convertStart);
+
+            auto optimizeStart = chrono::steady_clock::now();
+            before[i].add(*meshes[i]);
+            optimizeMesh(*meshes[i], optimizeOptions);
+            after[i].add(*meshes[i]);
+            optimizeMs[i] = millisecondsSince(optimizeStart);
+        },
+        nThreads);
+    double meshMs = millisecondsSince(meshStart);
+
+    MeshSetStatistics totalBefore, totalAfter;
+    double totalConvertMs = 0, totalOptimizeMs = 0;
+    for (size_t i = 0; i < instances.size(); i++) {
+        totalBefore.add(before[i]);
+        totalAfter.add(after[i]);
+        totalConvertMs += convertMs[i];
+        totalOptimizeMs += optimizeMs[i];
+    }
+    size_t instanceCount = 0;
+    for (const auto& mesh : meshes)
+        instanceCount += mesh->countInstances();
+    LOG(INFO) << "Loaded " << meshes.size() << " meshes(" << instanceCount
+              << " instances) from " << filename << ": import " << importMs
+              << " ms, materials " << materialMs
+              << " ms, meshes " << meshMs << " ms on "
+              << (nThreads ? nThreads : defaultThreadCount())
+              << " threads(conversion " << totalConvertMs
+              << " ms, optimization " << totalOptimizeMs
+              << " ms summed over the workers)";
+    LOG(INFO) << "Mesh optimization, vertices: " << totalBefore.vertices
+              << " -> " << totalAfter.vertices
+              << ", ACMR: " << totalBefore.acmr() << " -> "
+              << totalAfter.acmr() << ", ATVR: " << totalBefore.atvr()
+              << " -> " << totalAfter.atvr();
+    size_t lodCount = 1;
+    for (const auto& mesh : meshes)
+        lodCount = std::max(lodCount, mesh->countLod());
+    if (lodCount > 1) {
+        // meshes with a shorter chain count with their coarsest level
+        ostringstream lodTriangles;
+        for (size_t lod = 0; lod < lodCount; lod++) {
+            size_t triangles = 0;
+            for (const auto& mesh : meshes)
+                triangles += mesh->countTriangles(lod);
+            lodTriangles << (lod ? " / " : "") << triangles;
+        }
+        LOG(INFO) << "Mesh levels of detail, triangles: "
+                  << lodTriangles.str();
+    }
+    size_t meshletCount = 0;
+    for (const auto& mesh : meshes)
+        meshletCount += mesh->meshlets.size();
+    if (meshletCount > 0)
+        LOG(INFO) << "Meshlets: " << meshletCount;
+    if (!cachePath.empty() &&
+        saveMeshCache(
+            cachePath, cacheKey, descriptions, meshes, meshMaterials,
+            hashMeshCacheDependencies(ioSystem->getOpened(), filePath))) {
+        LOG(INFO) << "Stored meshes of " << filename << " in mesh cache "
+                  << cachePath;
+    }
+    return meshes;
 }
+
 }  // namespace loo
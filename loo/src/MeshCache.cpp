@@ -0,0 +1,442 @@
+#include "loo/MeshCache.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <type_traits>
+
+#include "loo/Hash.hpp"
+
+namespace loo {
+using namespace std;
+using namespace glm;
+namespace fs = std::filesystem;
+
+// layout of a .loomesh entry: the header, the metadata of the materials and
+// meshes, then the vertex and index arrays, each aligned to
+// MESH_CACHE_ALIGNMENT so they can be used in place
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t materialCount;
+    uint32_t meshCount;
+    uint32_t padding;
+    uint64_t metadataSize;
+    // of the metadata only, the arrays are uploaded as they are mapped and
+    // entries are never modified in place
+    uint8_t metadataDigest[32];
+    char key[64];
+};
+constexpr char MESH_CACHE_MAGIC[4] = {'L', 'O', 'O', 'M'};
+constexpr size_t MESH_CACHE_ALIGNMENT = 16;
+
+static size_t alignCacheOffset(size_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+namespace {
+
+class MetadataWriter {
+   public:
+    template <typename T>
+    void write(const T& value) {
+        static_assert(is_trivially_copyable_v<T>);
+        auto bytes = reinterpret_cast<const unsigned char*>(&value);
+        m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+    }
+    void writeString(const string& value) {
+        write(uint32_t(value.size()));
+        m_data.insert(m_data.end(), value.begin(), value.end());
+    }
+    const vector<unsigned char>& data() const { return m_data; }
+
+   private:
+    vector<unsigned char> m_data;
+};
+
+// every read is bounds checked, a damaged entry fails instead of crashing
+class MetadataReader {
+   public:
+    MetadataReader(const unsigned char* data, size_t size)
+        : m_data(data), m_size(size) {}
+    template <typename T>
+    bool read(T& value) {
+        static_assert(is_trivially_copyable_v<T>);
+        if (m_size - m_offset < sizeof(T))
+            return false;
+        memcpy(&value, m_data + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return true;
+    }
+    bool readString(string& value) {
+        uint32_t length;
+        if (!read(length) || m_size - m_offset < length)
+            return false;
+        value.assign(reinterpret_cast<const char*>(m_data + m_offset),
+                     length);
+        m_offset += length;
+        return true;
+    }
+    bool atEnd() const { return m_offset == m_size; }
+
+   private:
+    const unsigned char* m_data;
+    size_t m_size, m_offset{0};
+};
+
+}  // namespace
+
+string meshCacheKey(const string& filename, unsigned int importFlags,
+                    const mat4& sceneTransform,
+                    const MeshOptimizeOptions& options) {
+    auto fileHash = sha256File(filename);
+    if (fileHash.empty())
+        return "";
+    SHA256 sha;
+    const char tag[] = "loo mesh cache";
+    sha.update(tag, sizeof(tag));
+    sha.updateValue(MESH_CACHE_VERSION);
+    sha.updateValue(uint32_t(sizeof(Vertex)));
+    sha.update(fileHash.data(), fileHash.size());
+    sha.updateValue(uint32_t(importFlags));
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++)
+            sha.updateValue(sceneTransform[i][j]);
+    }
+    sha.updateValue(uint8_t(options.weld));
+    sha.updateValue(uint8_t(options.vertexCache));
+    sha.updateValue(options.overdrawThreshold);
+    sha.updateValue(uint8_t(options.vertexFetch));
+    sha.updateValue(options.lodLevels);
+    sha.updateValue(options.lodReduction);
+    sha.updateValue(options.lodMaxError);
+    sha.updateValue(uint8_t(options.meshlets));
+    return SHA256::toHex(sha.finalize());
+}
+
+static void writeMaterial(MetadataWriter& writer,
+                          const BaseMaterialDescription& material) {
+    writer.write(material.bpWorkFlow);
+    const auto& mr = material.mrWorkFlow;
+    writer.write(mr.baseColor);
+    writer.write(mr.metallic);
+    writer.write(mr.roughness);
+    writer.write(mr.transmission);
+    writer.write(mr.sigma_t);
+    writer.write(mr.sigma_a);
+    for (const auto& path : material.texturePaths)
+        writer.writeString(path);
+}
+
+static bool readMaterial(MetadataReader& reader,
+                         BaseMaterialDescription& material) {
+    auto& mr = material.mrWorkFlow;
+    if (!reader.read(material.bpWorkFlow) || !reader.read(mr.baseColor) ||
+        !reader.read(mr.metallic) || !reader.read(mr.roughness) ||
+        !reader.read(mr.transmission) || !reader.read(mr.sigma_t) ||
+        !reader.read(mr.sigma_a))
+        return false;
+    for (auto& path : material.texturePaths) {
+        if (!reader.readString(path))
+            return false;
+    }
+    return true;
+}
+
+// levels of detail or meshlets, their ranges must lie inside the index
+// array of the mesh
+template <typename Range>
+static bool readRanges(MetadataReader& reader, uint64_t indexCount,
+                       vector<Range>& ranges) {
+    uint32_t count;
+    if (!reader.read(count))
+        return false;
+    ranges.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        Range range;
+        if (!reader.read(range) || range.indexOffset > indexCount ||
+            range.indexCount > indexCount - range.indexOffset)
+            return false;
+        ranges.push_back(range);
+    }
+    return true;
+}
+
+static bool readInstances(MetadataReader& reader, vector<mat4>& instances) {
+    uint32_t count;
+    if (!reader.read(count))
+        return false;
+    instances.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        mat4 instance;
+        if (!reader.read(instance))
+            return false;
+        instances.push_back(instance);
+    }
+    return true;
+}
+
+bool saveMeshCache(const fs::path& filename, const string& key,
+                   const vector<BaseMaterialDescription>& materials,
+                   const vector<shared_ptr<Mesh>>& meshes,
+                   const vector<uint32_t>& meshMaterials,
+                   const vector<MeshCacheDependency>& dependencies) {
+    CHECK_EQ(meshes.size(), meshMaterials.size());
+    CHECK_EQ(key.size(), sizeof(MeshCacheHeader::key));
+    // array offsets are relative to the aligned end of the metadata
+    MetadataWriter writer;
+    for (const auto& material : materials)
+        writeMaterial(writer, material);
+    size_t arrayOffset = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const auto& mesh = *meshes[i];
+        CHECK_LT(meshMaterials[i], materials.size());
+        writer.writeString(mesh.name);
+        writer.write(meshMaterials[i]);
+        writer.write(mesh.objectMatrix);
+        arrayOffset = alignCacheOffset(arrayOffset);
+        writer.write(uint64_t(arrayOffset));
+        writer.write(uint64_t(mesh.countVertex()));
+        arrayOffset += mesh.countVertex() * sizeof(Vertex);
+        arrayOffset = alignCacheOffset(arrayOffset);
+        writer.write(uint64_t(arrayOffset));
+        writer.write(uint64_t(mesh.countIndex()));
+        arrayOffset += mesh.countIndex() * sizeof(unsigned int);
+        writer.write(uint32_t(mesh.lods.size()));
+        for (const auto& lod : mesh.lods)
+            writer.write(lod);
+        writer.write(uint32_t(mesh.meshlets.size()));
+        for (const auto& meshlet : mesh.meshlets)
+            writer.write(meshlet);
+        writer.write(uint32_t(mesh.instances.size()));
+        for (const auto& instance : mesh.instances)
+            writer.write(instance);
+    }
+    writer.write(uint32_t(dependencies.size()));
+    for (const auto& dependency : dependencies) {
+        writer.writeString(dependency.path);
+        writer.writeString(dependency.digest);
+    }
+
+    MeshCacheHeader header{};
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.materialCount = materials.size();
+    header.meshCount = meshes.size();
+    header.metadataSize = writer.data().size();
+    SHA256 sha;
+    sha.update(writer.data().data(), writer.data().size());
+    auto digest = sha.finalize();
+    memcpy(header.metadataDigest, digest.data(), digest.size());
+    memcpy(header.key, key.data(), sizeof(header.key));
+
+    error_code ec;
+    fs::create_directories(filename.parent_path(), ec);
+    random_device rd;
+    uint64_t nonce = (uint64_t(rd()) << 32) | rd();
+    auto tmpPath = filename;
+    tmpPath += ".tmp" + to_string(nonce);
+    {
+        ofstream ofs(tmpPath, ios::binary);
+        const char zeros[MESH_CACHE_ALIGNMENT]{};
+        size_t written = 0;
+        auto write = [&](const void* data, size_t size) {
+            ofs.write(reinterpret_cast<const char*>(data), size);
+            written += size;
+        };
+        auto pad = [&](size_t begin) {
+            size_t aligned = begin + alignCacheOffset(written - begin);
+            write(zeros, aligned - written);
+        };
+        write(&header, sizeof(header));
+        write(writer.data().data(), writer.data().size());
+        const size_t arrayBegin = alignCacheOffset(written);
+        write(zeros, arrayBegin - written);
+        for (const auto& mesh : meshes) {
+            pad(arrayBegin);
+            write(mesh->getVertexData(), mesh->countVertex() * sizeof(Vertex));
+            pad(arrayBegin);
+            write(mesh->getIndexData(),
+                  mesh->countIndex() * sizeof(unsigned int));
+        }
+        ofs.close();
+        if (ofs.fail()) {
+            LOG(ERROR) << "Failed to write mesh cache entry " << tmpPath;
+            fs::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    fs::rename(tmpPath, filename, ec);
+    if (ec) {
+        // another process may hold the published entry open on Windows, its
+        // content is identical to ours unless it went stale, which only
+        // costs the next run another import
+        bool published = fs::exists(filename);
+        fs::remove(tmpPath, ec);
+        if (!published) {
+            LOG(ERROR) << "Failed to publish mesh cache entry " << filename;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadMeshCache(const fs::path& filename, const string& key,
+                   MeshCacheEntry& entry) {
+    auto mapping = make_shared<MappedFile>(filename.string());
+    if (!mapping->isOpen())
+        return false;
+    MeshCacheHeader header;
+    if (mapping->size() < sizeof(header)) {
+        LOG(WARNING) << filename << ": truncated mesh cache header";
+        return false;
+    }
+    memcpy(&header, mapping->data(), sizeof(header));
+    if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != MESH_CACHE_VERSION ||
+        header.vertexSize != sizeof(Vertex)) {
+        LOG(WARNING) << filename << ": unsupported mesh cache version "
+                     << header.version;
+        return false;
+    }
+    if (key.size() != sizeof(header.key) ||
+        memcmp(header.key, key.data(), sizeof(header.key)) != 0) {
+        LOG(WARNING) << filename << ": mesh cache entry does not match its key";
+        return false;
+    }
+    if (header.metadataSize > mapping->size() - sizeof(header)) {
+        LOG(WARNING) << filename << ": truncated mesh cache metadata";
+        return false;
+    }
+    const unsigned char* metadata = mapping->data() + sizeof(header);
+    SHA256 sha;
+    sha.update(metadata, header.metadataSize);
+    auto digest = sha.finalize();
+    if (memcmp(digest.data(), header.metadataDigest, digest.size()) != 0) {
+        LOG(WARNING) << filename << ": mesh cache metadata checksum mismatch";
+        return false;
+    }
+
+    const size_t arrayBegin =
+        alignCacheOffset(sizeof(header) + header.metadataSize);
+    const size_t arraySize =
+        mapping->size() >= arrayBegin ? mapping->size() - arrayBegin : 0;
+    // offset and size of an array, in bounds and aligned for the type
+    auto checkArray = [&](uint64_t offset, uint64_t count, size_t stride) {
+        return offset % MESH_CACHE_ALIGNMENT == 0 && offset <= arraySize &&
+               count <= (arraySize - offset) / stride;
+    };
+    MetadataReader reader(metadata, header.metadataSize);
+    MeshCacheEntry result;
+    result.materials.resize(header.materialCount);
+    for (auto& material : result.materials) {
+        if (!readMaterial(reader, material)) {
+            LOG(WARNING) << filename << ": damaged mesh cache materials";
+            return false;
+        }
+    }
+    result.meshes.resize(header.meshCount);
+    for (auto& mesh : result.meshes) {
+        uint64_t vertexOffset, vertexCount, indexOffset, indexCount;
+        if (!reader.readString(mesh.name) || !reader.read(mesh.material) ||
+            !reader.read(mesh.transform) || !reader.read(vertexOffset) ||
+            !reader.read(vertexCount) || !reader.read(indexOffset) ||
+            !reader.read(indexCount) ||
+            mesh.material >= header.materialCount ||
+            !checkArray(vertexOffset, vertexCount, sizeof(Vertex)) ||
+            !checkArray(indexOffset, indexCount, sizeof(unsigned int)) ||
+            !readRanges(reader, indexCount, mesh.lods) ||
+            !readRanges(reader, indexCount, mesh.meshlets) ||
+            !readInstances(reader, mesh.instances)) {
+            LOG(WARNING) << filename << ": damaged mesh cache record";
+            return false;
+        }
+        const unsigned char* arrays = mapping->data() + arrayBegin;
+        mesh.vertices = reinterpret_cast<const Vertex*>(arrays + vertexOffset);
+        mesh.vertexCount = vertexCount;
+        mesh.indices =
+            reinterpret_cast<const unsigned int*>(arrays + indexOffset);
+        mesh.indexCount = indexCount;
+        // the arrays are not digested, an index past the vertices would be
+        // drawn as is
+        if (std::any_of(mesh.indices, mesh.indices + indexCount,
+                        [&](unsigned int index) {
+                            return index >= vertexCount;
+                        })) {
+            LOG(WARNING) << filename << ": damaged mesh cache record";
+            return false;
+        }
+    }
+    uint32_t dependencyCount;
+    if (!reader.read(dependencyCount)) {
+        LOG(WARNING) << filename << ": damaged mesh cache dependencies";
+        return false;
+    }
+    for (uint32_t i = 0; i < dependencyCount; i++) {
+        MeshCacheDependency dependency;
+        if (!reader.readString(dependency.path) ||
+            !reader.readString(dependency.digest)) {
+            LOG(WARNING) << filename << ": damaged mesh cache dependencies";
+            return false;
+        }
+        result.dependencies.push_back(std::move(dependency));
+    }
+    if (!reader.atEnd()) {
+        LOG(WARNING) << filename << ": unexpected mesh cache metadata size";
+        return false;
+    }
+    result.mapping = std::move(mapping);
+    entry = std::move(result);
+    return true;
+}
+
+// the paths as the importer opened them, made comparable
+static fs::path normalizedPath(const fs::path& path) {
+    error_code ec;
+    auto absolute = fs::absolute(path, ec);
+    return (ec ? path : absolute).lexically_normal();
+}
+
+vector<MeshCacheDependency> hashMeshCacheDependencies(
+    const vector<string>& files, const fs::path& modelFile) {
+    auto model = normalizedPath(modelFile);
+    auto directory = model.parent_path();
+    vector<MeshCacheDependency> dependencies;
+    for (const auto& file : files) {
+        auto path = normalizedPath(file);
+        if (path == model)
+            continue;
+        auto relative = path.lexically_relative(directory);
+        if (relative.empty())
+            relative = path;
+        bool known = std::any_of(
+            dependencies.begin(), dependencies.end(),
+            [&](const auto& dependency) {
+                return dependency.path == relative.generic_string();
+            });
+        if (known)
+            continue;
+        auto digest = sha256File(path.string());
+        if (!digest.empty())
+            dependencies.push_back({relative.generic_string(), digest});
+    }
+    return dependencies;
+}
+
+bool checkMeshCacheDependencies(const MeshCacheEntry& entry,
+                                const fs::path& modelFile) {
+    auto directory = normalizedPath(modelFile).parent_path();
+    for (const auto& dependency : entry.dependencies) {
+        auto digest = sha256File((directory / dependency.path).string());
+        if (digest.empty() || digest != dependency.digest)
+            return false;
+    }
+    return true;
+}
+
+}  // namespace loo
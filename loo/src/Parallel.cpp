@@ -0,0 +1,55 @@
+#include "loo/Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace loo {
+using namespace std;
+
+unsigned int defaultThreadCount() {
+    return std::max(1u, thread::hardware_concurrency());
+}
+
+void parallelFor(size_t count, const function<void(size_t)>& fn,
+                 unsigned int nThreads) {
+    if (count == 0)
+        return;
+    if (nThreads == 0)
+        nThreads = defaultThreadCount();
+    nThreads = static_cast<unsigned int>(
+        std::min<size_t>(std::max(nThreads, 1u), count));
+
+    atomic<size_t> next{0};
+    exception_ptr error;
+    mutex errorMutex;
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                fn(i);
+            } catch (...) {
+                lock_guard<mutex> lock(errorMutex);
+                if (!error)
+                    error = current_exception();
+                // drain the remaining work so every worker quits early
+                next = count;
+            }
+        }
+    };
+    vector<thread> workers;
+    workers.reserve(nThreads - 1);
+    for (unsigned int i = 1; i < nThreads; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
+    }
+    if (error)
+        rethrow_exception(error);
+}
+
+}  // namespace loo
@@ -4,6 +4,8 @@
 #include <glog/logging.h>
 #include <meshoptimizer.h>
 
+#include <algorithm>
+#include <cmath>
 #include <filesystem>
 #include <glm/gtc/matrix_transform.hpp>
 #include <loo/glError.hpp>
@@ -42,6 +44,15 @@ size_t Scene::countMesh() const {
     return m_meshes.size();
 }
 
+size_t Scene::countMaterial() const {
+    vector<const Material*> materials;
+    for (const auto& mesh : m_meshes)
+        materials.push_back(mesh->material.get());
+    std::sort(materials.begin(), materials.end());
+    return std::unique(materials.begin(), materials.end()) -
+           materials.begin();
+}
+
 size_t Scene::countVertex() const {
     size_t cnt = 0;
     for (const auto& mesh : m_meshes) {
@@ -52,7 +63,7 @@ size_t Scene::countVertex() const {
 size_t Scene::countTriangle() const {
     size_t cnt = 0;
     for (const auto& mesh : m_meshes) {
-        cnt += mesh->countTriangles();
+        cnt += mesh->countTriangles() * mesh->countInstances();
     }
     return cnt;
 }
@@ -62,48 +73,228 @@ void Scene::addMeshes(vector<shared_ptr<Mesh>>&& meshes) {
 }
 
 // prepare the scene, move the mesh data into opengl side
-void Scene::prepare() const {
+void Scene::prepare(VertexFormat format, bool sharedBuffers) {
+    m_sharedbuffers = sharedBuffers;
+    if (sharedBuffers) {
+        prepareSharedBuffers(m_meshes, format);
+        return;
+    }
     for (const auto& mesh : m_meshes) {
-        mesh->prepare();
+        mesh->prepare(format);
     }
 }
 
-void Scene::draw(ShaderProgram& sp,
-                 std::function<void(const Scene&, const Mesh&)> beforeDraw,
-                 GLenum drawMode, int drawFlags) const {
-    GLint dims[4] = {0};
-    glGetIntegerv(GL_VIEWPORT, dims);
-    GLint fbSize = dims[2] * dims[3];
-    static int counter = 0;
+// mirrored by DrawData in hdsss/shaders/include/vertex.glsl
+static_assert(sizeof(DrawData) == 160, "DrawData must match its std430 layout");
+
+namespace {
+// layout of GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// a visible mesh of an indirect draw, its ranges and the model matrices of
+// its visible instances
+struct IndirectDraw {
+    const Mesh* mesh;
+    int lod;
+    size_t instanceBegin, instanceEnd;
+    size_t rangeBegin, rangeEnd;
+};
+}  // namespace
+
+static void uploadBuffer(GLenum target, GLuint& buffer, const void* data,
+                         size_t size) {
+    if (buffer == 0)
+        glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    // orphaned every time, the previous content may still be in flight
+    glBufferData(target, size, data, GL_STREAM_DRAW);
+}
+
+static size_t drawIndirect(ShaderProgram& sp, GLenum drawMode, int drawFlags,
+                           vector<IndirectDraw>& draws,
+                           const vector<mat4>& models,
+                           const vector<IndexRange>& ranges,
+                           GLuint& drawDataBuffer, GLuint& indirectBuffer) {
+    if (draws.empty())
+        return 0;
+    // stable, the draws of a material stay in scene order
+    std::stable_sort(draws.begin(), draws.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.mesh->material < b.mesh->material;
+                     });
+    vector<DrawData> drawData;
+    drawData.reserve(models.size());
+    vector<DrawElementsIndirectCommand> commands;
+    commands.reserve(ranges.size());
+    for (const auto& draw : draws) {
+        const auto& mesh = *draw.mesh;
+        const auto& quantization = mesh.getVertexQuantization();
+        bool quantized = mesh.getVertexFormat() == VertexFormat::Quantized;
+        // the instances of a command read consecutive DrawData
+        GLuint baseInstance = drawData.size();
+        GLuint instanceCount = draw.instanceEnd - draw.instanceBegin;
+        for (size_t i = draw.instanceBegin; i < draw.instanceEnd; i++) {
+            drawData.push_back(
+                {models[i], transpose(inverse(models[i])),
+                 vec4(quantization.positionMin, quantized ? 1.0f : 0.0f),
+                 vec4(quantization.positionExtent, float(draw.lod))});
+        }
+        for (size_t i = draw.rangeBegin; i < draw.rangeEnd; i++) {
+            commands.push_back({ranges[i].indexCount, instanceCount,
+                                mesh.getFirstIndex() + ranges[i].indexOffset,
+                                mesh.getBaseVertex(), baseInstance});
+        }
+    }
+    uploadBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer, drawData.data(),
+                 drawData.size() * sizeof(DrawData));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING,
+                     drawDataBuffer);
+    uploadBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer, commands.data(),
+                 commands.size() * sizeof(DrawElementsIndirectCommand));
+
+    // the meshes share their VAOs
+    const auto& first = *draws.front().mesh;
+    glPolygonMode(GL_FRONT_AND_BACK, drawMode);
+    glBindVertexArray(drawFlags & DRAW_FLAG_GEOMETRY_ONLY ? first.geometryVao
+                                                          : first.vao);
+    sp.setUniform("drawIndirect", 1);
+    GLenum mode =
+        drawFlags & DRAW_FLAG_TESSELLATION ? GL_PATCHES : GL_TRIANGLES;
+    size_t drawCalls = 0;
+    size_t command = 0;
+    for (size_t begin = 0; begin < draws.size();) {
+        const auto& material = draws[begin].mesh->material;
+        size_t end = begin, commandCount = 0;
+        for (; end < draws.size() && draws[end].mesh->material == material;
+             end++)
+            commandCount += draws[end].rangeEnd - draws[end].rangeBegin;
+        material->bind(sp);
+        logPossibleGLError();
+        glMultiDrawElementsIndirect(
+            mode, GL_UNSIGNED_INT,
+            (const void*)(command * sizeof(DrawElementsIndirectCommand)),
+            GLsizei(commandCount), 0);
+        drawCalls++;
+        command += commandCount;
+        begin = end;
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return drawCalls;
+}
+
+void Scene::updateLod(const mat4& view, const mat4& projection) const {
+    bool perspective = projection[3][3] == 0.0f;
     for (const auto& mesh : m_meshes) {
-        glBeginQuery(GL_SAMPLES_PASSED, m_queryid);
-        beforeDraw(*this, *mesh);
-        mesh->draw(sp, drawMode, drawFlags & DRAW_FLAG_TESSELLATION);
-        glEndQuery(GL_SAMPLES_PASSED);
-        if (drawFlags & DRAW_FLAG_UPDATE_LOD) {
-            if (counter % 30 == 0) {
-                GLuint fragmentsPassed = 0;
-                glGetQueryObjectuiv(m_queryid, GL_QUERY_RESULT,
-                                    &fragmentsPassed);
-                float meshScreenProportion = fragmentsPassed / (float)fbSize;
-                // DISABLE LOD
-                // mesh->updateLod(meshScreenProportion);
-                counter = 0;
+        const auto& bounds = mesh->getBounds();
+        vec3 center = bounds.center();
+        // the instances share one level, the closest one decides
+        float maxProportion = 0.0f;
+        for (size_t i = 0; i < mesh->countInstances(); i++) {
+            mat4 model = m_modelmat * mesh->getInstanceMatrix(i);
+            float scale =
+                std::max({length(vec3(model[0])), length(vec3(model[1])),
+                          length(vec3(model[2]))});
+            float radius = length(bounds.extent()) * scale;
+            // projection[1][1] maps half the viewport height to 1
+            float proportion = radius * projection[1][1];
+            if (perspective) {
+                float depth = -(view * model * vec4(center, 1.0f)).z;
+                // a camera inside the sphere gets the full mesh
+                proportion = depth > radius ? proportion / depth : 1e9f;
             }
-            counter++;
+            maxProportion = std::max(maxProportion, proportion);
         }
+        mesh->updateLod(maxProportion);
     }
 }
-void Scene::draw(ShaderProgram& sp, GLenum drawMode, int drawFlags) const {
-    draw(
-        sp, [](const Scene&, const Mesh&) {}, drawMode, drawFlags);
-}
 
-Scene::Scene() {
-    glGenQueries(1, &m_queryid);
+DrawStatistics Scene::draw(
+    ShaderProgram& sp,
+    std::function<void(const Scene&, const Mesh&, const mat4&)> beforeDraw,
+    GLenum drawMode, int drawFlags, float lodBias,
+    const Frustum* frustum) const {
+    float screenError = m_lodscreenerror * std::exp2(lodBias);
+    DrawStatistics statistics;
+    bool culling = frustum && m_frustumculling;
+    bool indirect = m_indirectdraw && m_sharedbuffers;
+    vector<IndexRange> ranges;
+    vector<mat4> models;
+    // the ranges and models of every visible mesh one after another
+    vector<IndexRange> indirectRanges;
+    vector<mat4> indirectModels;
+    vector<IndirectDraw> indirectDraws;
+    for (const auto& mesh : m_meshes) {
+        models.clear();
+        for (size_t i = 0; i < mesh->countInstances(); i++) {
+            mat4 model = m_modelmat * mesh->getInstanceMatrix(i);
+            if (culling &&
+                !frustum->intersects(mesh->getBounds().transformed(model))) {
+                statistics.culled++;
+                continue;
+            }
+            models.push_back(model);
+        }
+        if (models.empty())
+            continue;
+        int lod = drawFlags & DRAW_FLAG_LOD ? mesh->selectLod(screenError) : 0;
+        auto range = mesh->getLod(lod);
+        ranges.assign(1, {range.indexOffset, range.indexCount});
+        // the coarser levels have no meshlets, they are cheap anyway. The
+        // instances share their ranges, so only a single visible one culls
+        if (culling && lod == 0 && !mesh->meshlets.empty() &&
+            models.size() == 1) {
+            ranges.clear();
+            size_t kept = mesh->cullMeshlets(
+                frustum->toObjectSpace(models[0]),
+                drawFlags & DRAW_FLAG_CONE_CULLING, ranges);
+            statistics.meshletsVisible += kept;
+            statistics.meshletsCulled += mesh->meshlets.size() - kept;
+            if (ranges.empty()) {
+                statistics.culled++;
+                continue;
+            }
+        }
+        statistics.visible += models.size();
+        for (const auto& drawn : ranges)
+            statistics.triangles += drawn.indexCount / 3 * models.size();
+        if (indirect) {
+            indirectDraws.push_back({mesh.get(), lod, indirectModels.size(),
+                                     indirectModels.size() + models.size(),
+                                     indirectRanges.size(),
+                                     indirectRanges.size() + ranges.size()});
+            indirectModels.insert(indirectModels.end(), models.begin(),
+                                  models.end());
+            indirectRanges.insert(indirectRanges.end(), ranges.begin(),
+                                  ranges.end());
+            continue;
+        }
+        for (const auto& model : models) {
+            beforeDraw(*this, *mesh, model);
+            mesh->draw(sp, drawMode, drawFlags & DRAW_FLAG_TESSELLATION,
+                       drawFlags & DRAW_FLAG_GEOMETRY_ONLY, lod, ranges);
+            statistics.drawCalls++;
+        }
+    }
+    if (indirect) {
+        statistics.drawCalls = drawIndirect(
+            sp, drawMode, drawFlags, indirectDraws, indirectModels,
+            indirectRanges, m_drawdatabuffer, m_indirectbuffer);
+    }
+    return statistics;
 }
-Scene::~Scene() {
-    glDeleteQueries(1, &m_queryid);
+DrawStatistics Scene::draw(ShaderProgram& sp, GLenum drawMode, int drawFlags,
+                           float lodBias, const Frustum* frustum) const {
+    return draw(
+        sp, [](const Scene&, const Mesh&, const mat4&) {}, drawMode,
+        drawFlags, lodBias,
+        frustum);
 }
 
 Scene createSceneFromFile(const std::string& filename) {
@@ -0,0 +1,181 @@
+#include "loo/VertexFormat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+
+namespace loo {
+using namespace std;
+using namespace glm;
+
+bool Vertex::operator==(const Vertex& v) const {
+    return position == v.position && normal == v.normal &&
+           texCoord == v.texCoord && tangent == v.tangent &&
+           bitangent == v.bitangent;
+}
+
+void Vertex::orthogonalizeTangent() {
+    tangent = normalize(tangent);
+    normal = normalize(normal);
+    tangent = normalize(tangent - dot(tangent, normal) * normal);
+    auto B = cross(normal, tangent);
+    if (dot(B, bitangent) < 0) {
+        // flip bitangent if necessary
+        // THIS IS IMPORTANT
+        B = -B;
+    }
+    bitangent = B;
+}
+
+// the conversions GL applies to normalized integer attributes
+static float decodeSnorm16(int16_t value) {
+    return std::max(float(value) / 32767.0f, -1.0f);
+}
+static uint16_t encodeUnorm16(float value) {
+    return uint16_t(std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+static float signNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+void encodeOctahedral(const vec3& v, int16_t encoded[2]) {
+    float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    if (!(l1 > 0.0f)) {
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+    vec3 n = v / l1;
+    float ex = n.x, ey = n.y;
+    if (n.z < 0.0f) {
+        // fold the lower hemisphere over the diagonals
+        ex = (1.0f - std::abs(n.y)) * signNotZero(n.x);
+        ey = (1.0f - std::abs(n.x)) * signNotZero(n.y);
+    }
+    // compared in double and renormalized, the cosines of neighbouring cells
+    // differ below float precision and the length error of normalize()
+    dvec3 direction = normalize(dvec3(v));
+    float baseX = std::floor(ex * 32767.0f), baseY = std::floor(ey * 32767.0f);
+    double bestCos = -2.0;
+    for (int dy = 0; dy < 2; dy++) {
+        for (int dx = 0; dx < 2; dx++) {
+            int16_t candidate[2]{
+                int16_t(std::clamp(baseX + dx, -32767.0f, 32767.0f)),
+                int16_t(std::clamp(baseY + dy, -32767.0f, 32767.0f))};
+            double cosine =
+                dot(normalize(dvec3(decodeOctahedral(candidate))), direction);
+            if (cosine > bestCos) {
+                bestCos = cosine;
+                encoded[0] = candidate[0];
+                encoded[1] = candidate[1];
+            }
+        }
+    }
+}
+
+vec3 decodeOctahedral(const int16_t encoded[2]) {
+    float fx = decodeSnorm16(encoded[0]), fy = decodeSnorm16(encoded[1]);
+    vec3 n(fx, fy, 1.0f - std::abs(fx) - std::abs(fy));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+VertexQuantization computeVertexQuantization(const Vertex* vertices,
+                                             size_t count) {
+    VertexQuantization quantization;
+    if (count == 0)
+        return quantization;
+    vec3 lo = vertices[0].position, hi = vertices[0].position;
+    for (size_t i = 1; i < count; i++) {
+        lo = glm::min(lo, vertices[i].position);
+        hi = glm::max(hi, vertices[i].position);
+    }
+    quantization.positionMin = lo;
+    for (int c = 0; c < 3; c++) {
+        float extent = hi[c] - lo[c];
+        quantization.positionExtent[c] = extent > 0.0f ? extent : 1.0f;
+    }
+    return quantization;
+}
+
+PackedVertex packVertex(const Vertex& vertex,
+                        const VertexQuantization& quantization) {
+    PackedVertex packed;
+    vec3 position = (vertex.position - quantization.positionMin) /
+                    quantization.positionExtent;
+    for (int c = 0; c < 3; c++)
+        packed.position[c] = encodeUnorm16(position[c]);
+    bool flipped = dot(cross(vertex.normal, vertex.tangent),
+                       vertex.bitangent) < 0.0f;
+    packed.position[3] = flipped ? 0 : 65535;
+    encodeOctahedral(vertex.normal, packed.normal);
+    encodeOctahedral(vertex.tangent, packed.tangent);
+    packed.texCoord[0] = packHalf1x16(vertex.texCoord.x);
+    packed.texCoord[1] = packHalf1x16(vertex.texCoord.y);
+    return packed;
+}
+
+Vertex unpackVertex(const PackedVertex& packed,
+                    const VertexQuantization& quantization) {
+    Vertex vertex;
+    vec3 position(packed.position[0], packed.position[1], packed.position[2]);
+    vertex.position = quantization.positionMin +
+                      position / 65535.0f * quantization.positionExtent;
+    vertex.normal = decodeOctahedral(packed.normal);
+    vertex.tangent = decodeOctahedral(packed.tangent);
+    float sign = float(packed.position[3]) / 65535.0f * 2.0f - 1.0f;
+    vertex.bitangent = sign * cross(vertex.normal, vertex.tangent);
+    vertex.texCoord = vec2(unpackHalf1x16(packed.texCoord[0]),
+                           unpackHalf1x16(packed.texCoord[1]));
+    return vertex;
+}
+
+size_t geometryStride(VertexFormat format) {
+    return format == VertexFormat::Quantized ? sizeof(PackedGeometryVertex)
+                                             : sizeof(GeometryVertex);
+}
+
+size_t attributeStride(VertexFormat format) {
+    return format == VertexFormat::Quantized ? sizeof(PackedAttributeVertex)
+                                             : sizeof(AttributeVertex);
+}
+
+void writeVertexStreams(const Vertex* vertices, size_t count,
+                        VertexFormat format,
+                        const VertexQuantization& quantization,
+                        void* geometry, void* attributes) {
+    if (format == VertexFormat::Quantized) {
+        auto packedGeometry = static_cast<PackedGeometryVertex*>(geometry);
+        auto packedAttributes = static_cast<PackedAttributeVertex*>(attributes);
+        for (size_t i = 0; i < count; i++) {
+            auto packed = packVertex(vertices[i], quantization);
+            auto& g = packedGeometry[i];
+            auto& a = packedAttributes[i];
+            copy(begin(packed.position), end(packed.position), g.position);
+            copy(begin(packed.normal), end(packed.normal), g.normal);
+            copy(begin(packed.tangent), end(packed.tangent), a.tangent);
+            copy(begin(packed.texCoord), end(packed.texCoord), a.texCoord);
+        }
+        return;
+    }
+    auto floatGeometry = static_cast<GeometryVertex*>(geometry);
+    auto floatAttributes = static_cast<AttributeVertex*>(attributes);
+    for (size_t i = 0; i < count; i++) {
+        const auto& vertex = vertices[i];
+        floatGeometry[i] = {vertex.position, vertex.normal};
+        floatAttributes[i] = {vertex.texCoord, vertex.tangent,
+                              vertex.bitangent};
+    }
+}
+
+vector<PackedVertex> packVertices(const Vertex* vertices, size_t count,
+                                  const VertexQuantization& quantization) {
+    vector<PackedVertex> packed(count);
+    for (size_t i = 0; i < count; i++)
+        packed[i] = packVertex(vertices[i], quantization);
+    return packed;
+}
+
+}  // namespace loo
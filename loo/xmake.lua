@@ -44,6 +44,10 @@ target("loo")
 
     add_files("src/*.cpp")
     add_packages("glfw", "glm", "glog", "imgui", "assimp", "meshoptimizer", "stb", "glad", {public = true})
+    -- std::thread workers in Parallel.cpp
+    if is_plat("linux") then
+        add_syslinks("pthread", {public = true})
+    end
 
     -- glad
     if is_plat("macosx") then